@@ -16,13 +16,18 @@ INCLUDE_PATH=.\src
 OBJS=\
 	$(OUTDIR)\const.o\
 	$(OUTDIR)\bit_operation.o\
+	$(OUTDIR)\cpu_feature.o\
 	$(OUTDIR)\board.o\
 	$(OUTDIR)\game.o\
 	$(AI_OUTDIR)\eval.o\
 	$(AI_OUTDIR)\ai_const.o\
 	$(AI_OUTDIR)\nnet.o\
 	$(AI_OUTDIR)\regression.o\
+	$(AI_OUTDIR)\model_file.o\
 	$(SEARCH_OUTDIR)\random_util.o\
+	$(SEARCH_OUTDIR)\search_pool.o\
+	$(SEARCH_OUTDIR)\stability.o\
+	$(SEARCH_OUTDIR)\thread_util.o\
 	$(SEARCH_OUTDIR)\hash.o\
 	$(SEARCH_OUTDIR)\moves.o\
 	$(SEARCH_OUTDIR)\mpc_info.o\
@@ -34,7 +39,6 @@ OBJS=\
 
 	
 CFLAGS=\
-	/arch:AVX2\
 	/nologo\
 	/W3\
 	/WX\
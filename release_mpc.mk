@@ -18,9 +18,13 @@ INCLUDE_PATH=.\src
 LEARN_OBJS=\
 	$(OUTDIR)\const.o\
 	$(OUTDIR)\bit_operation.o\
+	$(OUTDIR)\cpu_feature.o\
 	$(OUTDIR)\game.o\
 	$(OUTDIR)\board.o\
 	$(SEARCH_OUTDIR)\random_util.o\
+	$(SEARCH_OUTDIR)\search_pool.o\
+	$(SEARCH_OUTDIR)\stability.o\
+	$(SEARCH_OUTDIR)\thread_util.o\
 	$(SEARCH_OUTDIR)\hash.o\
 	$(SEARCH_OUTDIR)\moves.o\
 	$(SEARCH_OUTDIR)\mpc_info.o\
@@ -32,13 +36,13 @@ LEARN_OBJS=\
 	$(AI_OUTDIR)\ai_const.o\
 	$(AI_OUTDIR)\nnet.o\
 	$(AI_OUTDIR)\regression.o\
+	$(AI_OUTDIR)\model_file.o\
 	$(LEARN_OUTDIR)\game_record.obj\
 	$(LEARN_OUTDIR)\mpc_playout.obj\
 
 	
 CFLAGS=\
 	/Ox\
-	/arch:AVX2\
 	/nologo\
 	/W3\
 	/c\
@@ -111,6 +111,8 @@
 #define FEAT_BOX10_8 45
 
 #define FEAT_NUM 46
+// SIMDでまとめて更新するためのパディング込みの特徴数
+#define FEAT_NUM_PADDED 48
 
 #define WIN_BONUS 0
 
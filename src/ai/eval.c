@@ -19,7 +19,11 @@
 #include "../bit_operation.h"
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#ifdef USE_INTRIN
+#include <intrin.h>
+#endif
 
 /**
  * テスト済み
@@ -137,6 +141,23 @@ static const PosToFeature Pos2Feat[] = {
     /*H8*/ {6, {{FEAT_DIAG8_2, POW3_7}, {FEAT_EDGEX_2, POW3_8}, {FEAT_EDGEX_3, POW3_1}, {FEAT_CORNR_3, POW3_0}, {FEAT_BOX10_4, POW3_0}, {FEAT_BOX10_5, POW3_0}}},
 };
 
+// 8特徴分のインデックス（全特徴をFEAT_NB_BLOCK個のブロックでまとめて更新する）
+// SIMD版はFEAT_NB_BLOCK == 6 として展開している
+#define FEAT_BLOCK_SIZE 8
+#define FEAT_NB_BLOCK (FEAT_NUM_PADDED / FEAT_BLOCK_SIZE)
+#ifdef USE_INTRIN
+typedef __m128i FeatBlock;
+#else
+typedef struct FeatBlock
+{
+    uint16_t idx[FEAT_BLOCK_SIZE];
+} FeatBlock;
+#endif
+
+// 各座標に石が置かれたとき（0(empty) -> 1(own)）の全特徴のインデックスの増分（Pos2Featから作成）
+static FeatBlock FeatDelta[64][FEAT_NB_BLOCK];
+static bool isFeatDeltaReady = false;
+
 // ALL 211,734
 /*
 extern const uint32_t FeatMaxIndex[46] = {
@@ -217,21 +238,81 @@ static const char regrFolder[] = "resources/regressor/best/"; //"resources/regre
 //static const char regrFolder[] = "resources/regressor/regrV3_393_Loss1528/";弱かった・・・
 //static const char regrFolder[] = "resources/regressor/regrAdAsc_115_Loss1471/";つよい！↑bestに導入！
 
+/**
+ * @brief マスごとの特徴インデックスの増分表を作成する
+ * 
+ * 一度だけ作成する（評価器の初期化・再読み込みの際に呼ぶ）
+ */
+static void FeatDeltaInit()
+{
+    uint16_t delta[FEAT_NUM_PADDED];
+    const PosToFeature *pos2f;
+
+    if (isFeatDeltaReady)
+        return;
+
+    for (int pos = 0; pos < 64; pos++)
+    {
+        memset(delta, 0, sizeof(delta));
+        pos2f = &(Pos2Feat[pos]);
+        for (int i = 0; i < pos2f->nbFeature; i++)
+        {
+            delta[pos2f->feature[i].feat] += pos2f->feature[i].idx;
+        }
+        memcpy(FeatDelta[pos], delta, sizeof(delta));
+    }
+    isFeatDeltaReady = true;
+}
+
 void EvalInit(Evaluator *eval)
 {
-#ifdef USE_NN
+    FeatDeltaInit();
+#ifdef USE_QNN
+    // 量子化したモデルファイルがあればマップし，なければfloatのモデルから変換する
+    eval->model = MapQNetModel(eval->qnet, modelFolder);
+    if (eval->model == NULL)
+    {
+        QNNet *qnet = (QNNet *)calloc(NB_PHASE, sizeof(QNNet));
+        LoadQNets(qnet, modelFolder);
+        for (int phase = 0; phase < NB_PHASE; phase++)
+        {
+            eval->qnet[phase] = &qnet[phase];
+        }
+    }
+#elif USE_NN
     eval->net = (NNet *)malloc(sizeof(NNet) * NB_PHASE);
     LoadNets(eval->net, modelFolder);
 #elif USE_REGRESSION
     eval->regr = (Regressor *)malloc(sizeof(Regressor) * NB_PHASE);
+#ifdef LEARN_MODE
     InitRegr(eval->regr);
     RegrLoad(eval->regr, regrFolder);
+#else
+    // モデルファイルがあればマップし，なければフェーズごとのファイルから読み込む
+    if (!RegrMapModel(eval->regr, regrFolder))
+    {
+        InitRegr(eval->regr);
+        RegrLoad(eval->regr, regrFolder);
+    }
+#endif
 #endif
+    EvalReload(eval, 0, 0, OWN);
 }
 
 void EvalDelete(Evaluator *eval)
 {
-#ifdef USE_NN
+#ifdef USE_QNN
+    if (eval->model != NULL)
+    {
+        ModelFileClose(eval->model);
+        free(eval->model);
+    }
+    else
+    {
+        free((QNNet *)eval->qnet[0]);
+    }
+#elif USE_NN
+    free(eval->net);
 #elif USE_REGRESSION
     DelRegr(eval->regr);
     free(eval->regr);
@@ -240,169 +321,339 @@ void EvalDelete(Evaluator *eval)
 
 void EvalClone(Evaluator *src, Evaluator *dst)
 {
-    dst->player = src->player;
-    for (int i = 0; i < FEAT_NUM; i++)
-    {
-        dst->FeatureStates[i] = src->FeatureStates[i];
-    }
+    EvalLoadState(dst, src->FeatureStates, src->player, EvalNbEmpty(src));
+#ifdef USE_REGRESSION
     RegrCopyWeight(src->regr, dst->regr);
+#endif
 }
 
-void EvalReload(Evaluator *eval, uint64_t own, uint64_t opp, uint8 player)
+/**
+ * @brief バイト列をチェックサムに加える(FNV-1a)
+ * 
+ * @param checksum 途中までのチェックサム
+ * @param data バイト列
+ * @param size バイト数
+ * @return uint32_t 更新したチェックサム
+ */
+static uint32_t ChecksumUpdate(uint32_t checksum, const void *data, size_t size)
 {
-    const PosToFeature *pos2f;
-    int nbFeat;
-
-    // 自分の手番
-    eval->player = player;
-    for (int ftype = 0; ftype < FEAT_NUM; ftype++)
+    const uint8 *bytes = (const uint8 *)data;
+    for (size_t i = 0; i < size; i++)
     {
-        eval->FeatureStates[ftype] = 0;
+        checksum ^= bytes[i];
+        checksum *= 16777619u;
     }
+    return checksum;
+}
 
-    // 自分の石がある位置について
-    for (uint8 pos = PosIndexFromBit(own); own; pos = NextIndex(&own))
+/**
+ * @brief 評価モデルの重みからチェックサムを計算
+ * 
+ * 評価モデルに依存するデータ（置換表キャッシュなど）の照合に使う
+ * 
+ * @param eval 評価オブジェクト
+ * @return uint32_t チェックサム
+ */
+uint32_t EvalModelChecksum(Evaluator *eval)
+{
+    uint32_t checksum = 2166136261u;
+#ifdef USE_QNN
+    for (int phase = 0; phase < NB_PHASE; phase++)
     {
-        pos2f = &(Pos2Feat[pos]);
-        nbFeat = pos2f->nbFeature;
-        // 関連するすべての特徴のインデックスを更新
-        for (int i = 0; i < nbFeat; i++)
-        {
-            // 0(empty) -> 1(own)
-            eval->FeatureStates[pos2f->feature[i].feat] += pos2f->feature[i].idx;
-        }
+        // 構造体のパディングは含めない
+        checksum = ChecksumUpdate(checksum, eval->qnet[phase]->c1, sizeof(eval->qnet[phase]->c1));
+        checksum = ChecksumUpdate(checksum, eval->qnet[phase]->bias1, sizeof(eval->qnet[phase]->bias1));
+        checksum = ChecksumUpdate(checksum, eval->qnet[phase]->c2, sizeof(eval->qnet[phase]->c2));
+        checksum = ChecksumUpdate(checksum, eval->qnet[phase]->bias2, sizeof(eval->qnet[phase]->bias2));
+        checksum = ChecksumUpdate(checksum, eval->qnet[phase]->c3, sizeof(eval->qnet[phase]->c3));
+        // bias3，scale1〜3
+        checksum = ChecksumUpdate(checksum, &eval->qnet[phase]->bias3, sizeof(float) * 4);
     }
-    // 相手の石がある位置について
-    for (uint8 pos = PosIndexFromBit(opp); opp; pos = NextIndex(&opp))
+#elif USE_NN
+    for (int phase = 0; phase < NB_PHASE; phase++)
     {
-        pos2f = &(Pos2Feat[pos]);
-        nbFeat = pos2f->nbFeature;
-        // 関連するすべての特徴のインデックスを更新
-        for (int i = 0; i < nbFeat; i++)
-        {
-            // 0(empty) -> 2(opp)
-            eval->FeatureStates[pos2f->feature[i].feat] += 2 * pos2f->feature[i].idx;
-        }
+        checksum = ChecksumUpdate(checksum, eval->net[phase].c1, sizeof(eval->net[phase].c1));
+        checksum = ChecksumUpdate(checksum, eval->net[phase].c2, sizeof(eval->net[phase].c2));
+        checksum = ChecksumUpdate(checksum, eval->net[phase].c3, sizeof(eval->net[phase].c3));
+    }
+#elif USE_REGRESSION
+    // 探索で使う推論用の重みから計算する（モデルファイルをマップしたときは学習用の重みがない）
+    for (int phase = 0; phase < NB_PHASE; phase++)
+    {
+        checksum = ChecksumUpdate(checksum, eval->regr[phase].predWeight, sizeof(int16_t) * 2 * PRED_WEIGHT_STRIDE);
     }
-    assert(own == 0 && opp == 0);
+#endif
+    return checksum;
 }
 
-void EvalUpdate(Evaluator *eval, uint8 pos, uint64_t flip)
+/**
+ * @brief 石のあるマスの増分を合計する
+ * 
+ * @param bits 石のあるマス
+ * @param sum 出力：増分の合計
+ */
+static inline void FeatDeltaSum(uint64_t bits, FeatBlock sum[FEAT_NB_BLOCK])
 {
-    const PosToFeature *pos2f = &(Pos2Feat[pos]);
-    int nbFeat = pos2f->nbFeature;
-    uint8 flipIdx;
-    if (eval->player == OWN)
+#ifdef USE_INTRIN
+    // 合計はレジスタに置いたまま足し込む
+    __m128i sum0 = _mm_setzero_si128(), sum1 = sum0, sum2 = sum0, sum3 = sum0, sum4 = sum0, sum5 = sum0;
+    const __m128i *delta;
+    for (uint8 pos = PosIndexFromBit(bits); bits; pos = NextIndex(&bits))
     {
-        // 着手箇所について
-        // 関連するすべての特徴のインデックスを更新
-        for (int i = 0; i < nbFeat; i++)
-        {
-            // 0(empty) -> 1(own)
-            eval->FeatureStates[pos2f->feature[i].feat] += pos2f->feature[i].idx;
-            assert(eval->FeatureStates[pos2f->feature[i].feat] < FTYPE_INDEX_MAX[FeatID2Type[pos2f->feature[i].feat]]);
-        }
-
-        // 反転箇所について
-        for (flipIdx = PosIndexFromBit(flip); flip; flipIdx = NextIndex(&flip))
-        {
-            pos2f = &(Pos2Feat[flipIdx]);
-            nbFeat = pos2f->nbFeature;
-            // 関連するすべての特徴のインデックスを更新
-            for (int i = 0; i < nbFeat; i++)
-            {
-                // 2(opp) -> 1(own)
-                eval->FeatureStates[pos2f->feature[i].feat] -= pos2f->feature[i].idx;
-                assert(eval->FeatureStates[pos2f->feature[i].feat] < FTYPE_INDEX_MAX[FeatID2Type[pos2f->feature[i].feat]]);
-            }
-        }
+        delta = FeatDelta[pos];
+        sum0 = _mm_add_epi16(sum0, delta[0]);
+        sum1 = _mm_add_epi16(sum1, delta[1]);
+        sum2 = _mm_add_epi16(sum2, delta[2]);
+        sum3 = _mm_add_epi16(sum3, delta[3]);
+        sum4 = _mm_add_epi16(sum4, delta[4]);
+        sum5 = _mm_add_epi16(sum5, delta[5]);
     }
-    else
+    sum[0] = sum0;
+    sum[1] = sum1;
+    sum[2] = sum2;
+    sum[3] = sum3;
+    sum[4] = sum4;
+    sum[5] = sum5;
+#else
+    uint16_t *dst = sum->idx;
+    const uint16_t *delta;
+    int i;
+    memset(sum, 0, sizeof(FeatBlock) * FEAT_NB_BLOCK);
+    for (uint8 pos = PosIndexFromBit(bits); bits; pos = NextIndex(&bits))
     {
-        // 着手箇所について
-        // 関連するすべての特徴のインデックスを戻す
-        for (int i = 0; i < nbFeat; i++)
+        delta = FeatDelta[pos]->idx;
+        for (i = 0; i < FEAT_NUM_PADDED; i++)
         {
-            // 0(empty) -> 2(opp)
-            eval->FeatureStates[pos2f->feature[i].feat] += 2 * pos2f->feature[i].idx;
-            assert(eval->FeatureStates[pos2f->feature[i].feat] < FTYPE_INDEX_MAX[FeatID2Type[pos2f->feature[i].feat]]);
+            dst[i] += delta[i];
         }
+    }
+#endif
+}
 
-        // 反転箇所について
-        for (flipIdx = PosIndexFromBit(flip); flip; flipIdx = NextIndex(&flip))
-        {
-            pos2f = &(Pos2Feat[flipIdx]);
-            nbFeat = pos2f->nbFeature;
-            // 関連するすべての特徴のインデックスを戻す
-            for (int i = 0; i < nbFeat; i++)
-            {
-                // 1(own) -> 2(opp)
-                eval->FeatureStates[pos2f->feature[i].feat] += pos2f->feature[i].idx;
-                assert(eval->FeatureStates[pos2f->feature[i].feat] < FTYPE_INDEX_MAX[FeatID2Type[pos2f->feature[i].feat]]);
-            }
-        }
+#ifdef USE_INTRIN
+/**
+ * @brief 8特徴分のインデックスに着手による変化を足して書き込む
+ * 
+ * @param dst 出力：着手後の特徴のインデックス
+ * @param src 着手前の特徴のインデックス
+ * @param placed 着手箇所の増分
+ * @param flipped 反転箇所の増分の合計
+ * @param own 自分の着手なら全bit 1
+ */
+static inline void FeatBlockApply(__m128i *dst, const __m128i *src, __m128i placed, __m128i flipped, __m128i own)
+{
+    // placed * (相手なら2) + flipped * (自分なら-1)
+    __m128i delta = _mm_add_epi16(placed, _mm_andnot_si128(own, placed));
+    delta = _mm_add_epi16(delta, _mm_sub_epi16(_mm_xor_si128(flipped, own), own));
+    _mm_storeu_si128(dst, _mm_add_epi16(_mm_loadu_si128(src), delta));
+}
+#endif
+
+/**
+ * @brief 着手による特徴のインデックスの変化を足して書き込む
+ * 
+ * 自分の着手：着手箇所 0(empty) -> 1(own)，反転箇所 2(opp) -> 1(own) なので placed - flipped
+ * 相手の着手：着手箇所 0(empty) -> 2(opp)，反転箇所 1(own) -> 2(opp) なので 2 * placed + flipped
+ * 手番による違いはマスクで切り替え，分岐せずに全特徴をまとめて更新する。
+ * （16bitの桁あふれは途中で起きても，最終的な値が範囲内なら正しい）
+ * 
+ * @param dst 出力：着手後の特徴のインデックス（srcと同じでもよい）
+ * @param src 着手前の特徴のインデックス
+ * @param placed 着手箇所の増分
+ * @param flipped 反転箇所の増分の合計
+ * @param player 着手した手番
+ */
+static inline void FeatStatesApply(unsigned short *dst, const unsigned short *src,
+                                   const FeatBlock placed[FEAT_NB_BLOCK], const FeatBlock flipped[FEAT_NB_BLOCK], uint8 player)
+{
+    // 0 or 0xffff
+    const uint16_t ownMask = (uint16_t)(player - 1);
+#ifdef USE_INTRIN
+    const __m128i own = _mm_set1_epi16((short)ownMask);
+    __m128i *d = (__m128i *)dst;
+    const __m128i *s = (const __m128i *)src;
+    FeatBlockApply(d + 0, s + 0, placed[0], flipped[0], own);
+    FeatBlockApply(d + 1, s + 1, placed[1], flipped[1], own);
+    FeatBlockApply(d + 2, s + 2, placed[2], flipped[2], own);
+    FeatBlockApply(d + 3, s + 3, placed[3], flipped[3], own);
+    FeatBlockApply(d + 4, s + 4, placed[4], flipped[4], own);
+    FeatBlockApply(d + 5, s + 5, placed[5], flipped[5], own);
+#else
+    const uint16_t *p = placed->idx;
+    const uint16_t *f = flipped->idx;
+    for (int i = 0; i < FEAT_NUM_PADDED; i++)
+    {
+        dst[i] = src[i] + (uint16_t)(p[i] + (p[i] & ~ownMask) + ((f[i] ^ ownMask) - ownMask));
     }
-    eval->player ^= 1;
+#endif
 }
 
-void EvalUndo(Evaluator *eval, uint8 pos, uint64_t flip)
+#ifndef NDEBUG
+/**
+ * @brief 特徴のインデックスがすべて範囲内か
+ * 
+ * @param eval 評価器
+ * @return bool 範囲内か
+ */
+static bool IsValidFeatureStates(const Evaluator *eval)
 {
-    const PosToFeature *pos2f = &(Pos2Feat[pos]);
-    int nbFeat = pos2f->nbFeature;
-    int i;
-    uint8 flipIdx;
+    for (int feat = 0; feat < FEAT_NUM; feat++)
+    {
+        if (eval->FeatureStates[feat] >= FTYPE_INDEX_MAX[FeatID2Type[feat]])
+            return false;
+    }
+    return true;
+}
+#endif
 
-    eval->player ^= 1;
-    if (eval->player == OWN)
+/**
+ * @brief 現在の局面の段（EvalReloadした局面が0）
+ * 
+ * @param eval 評価器
+ * @return int 段
+ */
+static inline int EvalLevel(const Evaluator *eval)
+{
+    return (int)((eval->FeatureStates - eval->stateStack[0]) / FEAT_NUM_PADDED);
+}
+
+/**
+ * @brief 現在の局面の空きマス数
+ * 
+ * @param eval 評価器
+ * @return uint8 空きマス数
+ */
+uint8 EvalNbEmpty(const Evaluator *eval)
+{
+    return (uint8)(eval->nbEmptyBase - EvalLevel(eval));
+}
+
+#ifdef USE_NN
+/**
+ * @brief 空きマス数に対応するネットワークの番号
+ * 
+ * EvalReloadは空きマスが60以上の局面でも呼ばれるので，最後のフェーズに丸める
+ * 
+ * @param nbEmpty 空きマス数
+ * @return int フェーズ
+ */
+static inline int NetPhase(uint8 nbEmpty)
+{
+    return MIN(PHASE(nbEmpty), NB_PHASE - 1);
+}
+
+/**
+ * @brief 現在の局面のアキュムレータを更新する
+ * 
+ * 1つ前の段と同じフェーズなら変化したパターンの分だけ更新し，
+ * フェーズが変わったとき（ネットワークが変わるとき）は計算し直す
+ * 
+ * @param eval 評価器
+ * @param isFromParent 1つ前の段から更新するか
+ */
+static void EvalAccumulate(Evaluator *eval, bool isFromParent)
+{
+    const int level = EvalLevel(eval);
+    const uint8 nbEmpty = EvalNbEmpty(eval);
+#ifdef USE_QNN
+    const QNNet *qnet = eval->qnet[NetPhase(nbEmpty)];
+
+    if (isFromParent && NetPhase(nbEmpty + 1) == NetPhase(nbEmpty))
     {
-        // 着手箇所について
-        // 関連するすべての特徴のインデックスを戻す
-        for (i = 0; i < nbFeat; i++)
-        {
-            // 1(own) -> 0(empty)
-            eval->FeatureStates[pos2f->feature[i].feat] -= pos2f->feature[i].idx;
-            //assert(eval->FeatureStates[pos2f->feature[i].feat] < FeatMaxIndex[pos2f->feature[i].feat]);
-        }
+        QNNetAccumulateDelta(qnet, eval->stateStack[level - 1], eval->stateStack[level],
+                             eval->accStack[level - 1], eval->accStack[level]);
+    }
+    else
+    {
+        QNNetAccumulate(qnet, eval->stateStack[level], eval->accStack[level]);
+    }
+#else
+    const NNet *net = &eval->net[NetPhase(nbEmpty)];
 
-        // 反転箇所について
-        for (flipIdx = PosIndexFromBit(flip); flip; flipIdx = NextIndex(&flip))
-        {
-            pos2f = &(Pos2Feat[flipIdx]);
-            nbFeat = pos2f->nbFeature;
-            // 関連するすべての特徴のインデックスを戻す
-            for (i = 0; i < nbFeat; i++)
-            {
-                // 1(own) -> 2(opp)
-                eval->FeatureStates[pos2f->feature[i].feat] += pos2f->feature[i].idx;
-                //assert(eval->FeatureStates[pos2f->feature[i].feat] < FeatMaxIndex[pos2f->feature[i].feat]);
-            }
-        }
+    if (isFromParent && NetPhase(nbEmpty + 1) == NetPhase(nbEmpty))
+    {
+        NNetAccumulateDelta(net, eval->stateStack[level - 1], eval->stateStack[level],
+                            eval->accStack[level - 1], eval->accStack[level]);
     }
     else
     {
-        // 着手箇所について
-        // 関連するすべての特徴のインデックスを戻す
-        for (i = 0; i < nbFeat; i++)
-        {
-            // 2(opp) -> 0(empty)
-            eval->FeatureStates[pos2f->feature[i].feat] -= 2 * pos2f->feature[i].idx;
-            //assert(eval->FeatureStates[pos2f->feature[i].feat] < FeatMaxIndex[pos2f->feature[i].feat]);
-        }
+        NNetAccumulate(net, eval->stateStack[level], eval->accStack[level]);
+    }
+#endif
+}
+#endif
 
-        // 反転箇所について
-        for (flipIdx = PosIndexFromBit(flip); flip; flipIdx = NextIndex(&flip))
-        {
-            pos2f = &(Pos2Feat[flipIdx]);
-            nbFeat = pos2f->nbFeature;
-            // 関連するすべての特徴のインデックスを戻す
-            for (i = 0; i < nbFeat; i++)
-            {
-                // 2(opp) -> 1(own)
-                eval->FeatureStates[pos2f->feature[i].feat] -= pos2f->feature[i].idx;
-                //assert(eval->FeatureStates[pos2f->feature[i].feat] < FeatMaxIndex[pos2f->feature[i].feat]);
-            }
-        }
+void EvalReload(Evaluator *eval, uint64_t own, uint64_t opp, uint8 player)
+{
+    FeatBlock ownDelta[FEAT_NB_BLOCK], oppDelta[FEAT_NB_BLOCK];
+
+    FeatDeltaInit();
+
+    // 自分の手番
+    eval->player = player;
+    eval->FeatureStates = eval->stateStack[0];
+    for (int feat = 0; feat < FEAT_NUM_PADDED; feat++)
+    {
+        eval->FeatureStates[feat] = 0;
     }
+
+    // 2 * (相手の石) + (自分の石) は，相手の着手と同じ形
+    FeatDeltaSum(own, ownDelta);
+    FeatDeltaSum(opp, oppDelta);
+    FeatStatesApply(eval->FeatureStates, eval->FeatureStates, oppDelta, ownDelta, OPP);
+    assert(IsValidFeatureStates(eval));
+
+    eval->nbEmptyBase = 64 - CountBits(own | opp);
+#ifdef USE_NN
+    EvalAccumulate(eval, false);
+#endif
+}
+
+/**
+ * @brief 保存しておいた特徴のインデックスを読み込む
+ * 
+ * 盤面から計算し直すEvalReloadの代わりに，他の評価器の状態を写すときに使う
+ * 
+ * @param eval 評価器
+ * @param featureStates 特徴のインデックス（FeatureStatesを写したもの）
+ * @param player 手番
+ * @param nbEmpty 空きマス数
+ */
+void EvalLoadState(Evaluator *eval, const unsigned short featureStates[FEAT_NUM_PADDED], uint8 player, uint8 nbEmpty)
+{
+    eval->player = player;
+    eval->FeatureStates = eval->stateStack[0];
+    memcpy(eval->FeatureStates, featureStates, sizeof(eval->stateStack[0]));
+    eval->nbEmptyBase = nbEmpty;
+    assert(IsValidFeatureStates(eval));
+#ifdef USE_NN
+    EvalAccumulate(eval, false);
+#endif
+}
+
+void EvalUpdate(Evaluator *eval, uint8 pos, uint64_t flip)
+{
+    FeatBlock flipped[FEAT_NB_BLOCK];
+    unsigned short *next = eval->FeatureStates + FEAT_NUM_PADDED;
+
+    assert(next <= eval->stateStack[EVAL_STACK_SIZE - 1]);
+    // 次の段へ，今の状態と着手による変化の和を書き込む
+    FeatDeltaSum(flip, flipped);
+    FeatStatesApply(next, eval->FeatureStates, FeatDelta[pos], flipped, eval->player);
+    eval->FeatureStates = next;
+    eval->player ^= 1;
+    assert(IsValidFeatureStates(eval));
+#ifdef USE_NN
+    EvalAccumulate(eval, true);
+#endif
+}
+
+void EvalUndo(Evaluator *eval)
+{
+    // 着手前の状態は前の段に残っている
+    assert(eval->FeatureStates > eval->stateStack[0]);
+    eval->FeatureStates -= FEAT_NUM_PADDED;
+    eval->player ^= 1;
 }
 
 void EvalUpdatePass(Evaluator *eval)
@@ -412,20 +663,44 @@ void EvalUpdatePass(Evaluator *eval)
 
 score_t Evaluate(Evaluator *eval, uint8 nbEmpty)
 {
-    double scoref;
     score_t score;
-#ifdef USE_NN
-    if (eval->player)
+#ifdef USE_QNN
+    const QNNet *qnet = eval->qnet[NetPhase(nbEmpty)];
+    float scoref;
+
+    if (NetPhase(EvalNbEmpty(eval)) == NetPhase(nbEmpty))
     {
-        score = Predict(&eval->net[PHASE(eval->nbEmpty)], eval->FeatureStates);
+        scoref = QPredictWithAcc(qnet, eval->accStack[EvalLevel(eval)]);
     }
     else
     {
-        score = -Predict(&eval->net[PHASE(eval->nbEmpty)], eval->FeatureStates);
+        // 評価器の局面と違うフェーズで評価するとき
+        scoref = QPredict(qnet, eval->FeatureStates);
     }
+    score = (score_t)(eval->player ? scoref : -scoref);
+#elif USE_NN
+    const NNet *net = &eval->net[NetPhase(nbEmpty)];
+    float acc[VALUE_HIDDEN_UNITS1];
+    float scoref;
+
+    if (NetPhase(EvalNbEmpty(eval)) == NetPhase(nbEmpty))
+    {
+        scoref = PredictWithAcc(net, eval->accStack[EvalLevel(eval)]);
+    }
+    else
+    {
+        // 評価器の局面と違うフェーズで評価するとき
+        NNetAccumulate(net, eval->FeatureStates, acc);
+        scoref = PredictWithAcc(net, acc);
+    }
+    score = (score_t)(eval->player ? scoref : -scoref);
 #elif USE_REGRESSION
-    scoref = RegrPred(&eval->regr[PHASE(nbEmpty)], eval->FeatureStates, eval->player);
-    score = (score_t)roundl(scoref * STONE_VALUE);
+    int32_t scorei;
+
+    // 量子化した重みの和を石の価値の単位へ（四捨五入）
+    scorei = RegrPredFast(&eval->regr[PHASE(nbEmpty)], eval->FeatureStates, eval->player);
+    scorei = (scorei * STONE_VALUE + REGR_WEIGHT_SCALE / 2) >> REGR_WEIGHT_SHIFT;
+    score = (score_t)MAX(MIN(scorei, EVAL_MAX), EVAL_MIN);
 #endif
 
     // 最小値以上，最大値以下に
@@ -16,12 +16,30 @@ extern const uint32_t FTYPE_DIGIT[FEAT_TYPE_NUM];
 
 extern const score_t VALUE_TABLE[64];
 
+// 評価器が戻せる着手の数（EvalReloadの局面から全マスを埋めるまで）
+#define EVAL_STACK_SIZE (60 + 1)
+
 typedef struct Evaluator
 {
-    unsigned short FeatureStates[FEAT_NUM];
+    // 局面ごとのパターンのインデックス（着手のたびに次の段へ書き込み，戻すときは前の段へ戻る）
+    // FEAT_NUM以降はまとめて更新するためのパディングで常に0
+    unsigned short stateStack[EVAL_STACK_SIZE][FEAT_NUM_PADDED];
+    // 現在の局面のパターンのインデックス（stateStackのいずれかの段を指す）
+    unsigned short *FeatureStates;
     uint8 player;
-#ifdef USE_NN
+    // EvalReload（EvalLoadState）した局面の空きマス数
+    uint8 nbEmptyBase;
+#ifdef USE_QNN
+    // フェーズごとのネットワーク（モデルファイルをマップしたときはファイル内を指す）
+    const QNNet *qnet[NB_PHASE];
+    // マップしたモデルファイル（floatのモデルから変換したときはNULL）
+    ModelFile *model;
+    // 局面ごとの中間層1への入力の和（stateStackと同じ段を使う）
+    int32_t accStack[EVAL_STACK_SIZE][VALUE_HIDDEN_UNITS1];
+#elif USE_NN
     NNet *net;
+    // 局面ごとの中間層1への入力の和（stateStackと同じ段を使う）
+    float accStack[EVAL_STACK_SIZE][VALUE_HIDDEN_UNITS1];
 #elif USE_REGRESSION
     Regressor *regr;
 #endif
@@ -33,9 +51,12 @@ uint16_t OpponentIndex(uint16_t idx, uint8 digit);
 void EvalInit(Evaluator *eval);
 void EvalDelete(Evaluator *eval);
 void EvalClone(Evaluator *src, Evaluator *dst);
+uint32_t EvalModelChecksum(Evaluator *eval);
 void EvalReload(Evaluator *eval, uint64_t own, uint64_t opp, uint8 player);
+void EvalLoadState(Evaluator *eval, const unsigned short featureStates[FEAT_NUM_PADDED], uint8 player, uint8 nbEmpty);
+uint8 EvalNbEmpty(const Evaluator *eval);
 void EvalUpdate(Evaluator *eval, uint8 pos, uint64_t flip);
-void EvalUndo(Evaluator *eval, uint8 pos, uint64_t flip);
+void EvalUndo(Evaluator *eval);
 void EvalUpdatePass(Evaluator *eval);
 //void SetWeights(Evaluator *eval, Weight *weights[NB_PHASE]);
 
@@ -0,0 +1,422 @@
+/**
+ * @file model_file.c
+ * @author Daichi Sato
+ * @brief 評価モデルの単一ファイル形式
+ * @version 1.0
+ * @date 2021-03-01
+ * 
+ * @copyright Copyright (c) 2021 Daichi Sato
+ * 
+ * 探索に使う重み（推論用に並べ替え・量子化したもの）を1つのファイルにまとめ，
+ * 読み込み専用でメモリにマップしてそのまま参照する。
+ * 複数のエンジンのプロセスを起動しても，重みはページキャッシュで共有され，起動時の読み込み・変換もない。
+ * 
+ * ファイル構造：
+ * ヘッダ(ModelFileHeader)，セクション表(ModelFileSection x nbSections)，各セクションのデータの順に並ぶ。
+ * 各セクションの先頭はMODEL_FILE_ALIGNに揃え，隙間は0で埋める。
+ * チェックサムはセクション表と各セクションのデータ（8byte単位に0で埋めたもの）から計算し，
+ * ファイルごとにプロセスで最初に開いたときだけ照合する（2回目以降はヘッダとセクション表のみ確かめる）。
+ * 
+ */
+
+#define _CRT_SECURE_NO_WARNINGS
+#ifdef _WIN32
+#include <Windows.h>
+#include <process.h>
+#define getpid _getpid
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "model_file.h"
+#include "../search/thread_util.h"
+
+#define MODEL_CHECKSUM_INIT 14695981039346656037ULL
+#define MODEL_CHECKSUM_PRIME 1099511628211ULL
+// チェックサムを照合済みとして覚えておくファイル数
+#define MODEL_VERIFIED_MAX 8
+
+// チェックサムを照合済みのファイル
+typedef struct ModelVerified
+{
+    char file[FILENAME_MAX];
+    uint64_t fileSize;
+    uint64_t checksum;
+} ModelVerified;
+
+static ModelVerified VerifiedModels[MODEL_VERIFIED_MAX];
+static int NbVerifiedModels = 0;
+static SpinLock VerifiedModelsLock = 0;
+
+/**
+ * @brief バイト列をチェックサムに加える(8byte単位のFNV-1a)
+ * 
+ * 8byteに満たない末尾は0で埋めたものとして扱う
+ * 
+ * @param checksum 途中までのチェックサム
+ * @param data バイト列
+ * @param size バイト数
+ * @return uint64_t 更新したチェックサム
+ */
+static uint64_t ModelChecksumUpdate(uint64_t checksum, const void *data, uint64_t size)
+{
+    const uint8 *bytes = (const uint8 *)data;
+    uint64_t word;
+    uint64_t i;
+
+    for (i = 0; i + sizeof(word) <= size; i += sizeof(word))
+    {
+        memcpy(&word, bytes + i, sizeof(word));
+        checksum ^= word;
+        checksum *= MODEL_CHECKSUM_PRIME;
+    }
+    if (i < size)
+    {
+        word = 0;
+        memcpy(&word, bytes + i, (size_t)(size - i));
+        checksum ^= word;
+        checksum *= MODEL_CHECKSUM_PRIME;
+    }
+    return checksum;
+}
+
+/**
+ * @brief 整列サイズの倍数に切り上げる
+ */
+static uint64_t ModelFileAlign(uint64_t size)
+{
+    return (size + MODEL_FILE_ALIGN - 1) & ~(uint64_t)(MODEL_FILE_ALIGN - 1);
+}
+
+/**
+ * @brief 現在位置から整列サイズの倍数の位置まで0を書き込む
+ * 
+ * @param fp ファイル
+ * @param pos 現在位置
+ * @return bool 書き込めたか
+ */
+static bool ModelFileWritePadding(FILE *fp, uint64_t pos)
+{
+    static const uint8 zeros[MODEL_FILE_ALIGN] = {0};
+    size_t padding = (size_t)(ModelFileAlign(pos) - pos);
+    return fwrite(zeros, 1, padding, fp) == padding;
+}
+
+/**
+ * @brief 書き込んだ一時ファイルでモデルファイルを置き換える
+ * 
+ * 実行中のエンジンがマップしているファイルを上書きで切り詰めると，そのエンジンが重みを読んだときに落ちるので，
+ * 別名で書き込んでから名前を付け替える（マップ中のプロセスは古いファイルを参照し続ける）。
+ * 
+ * @param tmpFile 書き込んだ一時ファイル
+ * @param file 置き換えるファイル名
+ * @return bool 置き換えられたか
+ */
+static bool ModelFileReplace(const char *tmpFile, const char *file)
+{
+#ifdef _WIN32
+    return MoveFileExA(tmpFile, file, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(tmpFile, file) == 0;
+#endif
+}
+
+/**
+ * @brief モデルファイルを書き込む
+ * 
+ * 一時ファイル(ファイル名+".プロセスID.tmp")に書き込んでから置き換える。
+ * 複数のプロセスが同時に書き込んでも，互いの一時ファイルを壊さない。
+ * 
+ * @param file ファイル名
+ * @param kind モデルの種類
+ * @param sections 書き込むセクション
+ * @param nbSections セクション数
+ * @return bool 書き込めたか
+ */
+bool ModelFileSave(const char *file, ModelKind kind, const ModelSectionData sections[], uint32_t nbSections)
+{
+    ModelFileHeader header;
+    ModelFileSection *table;
+    uint64_t pos;
+    uint32_t i;
+    bool isSucceeded;
+    FILE *fp;
+    char tmpFile[FILENAME_MAX];
+
+    if (snprintf(tmpFile, sizeof(tmpFile), "%s.%d.tmp", file, (int)getpid()) >= (int)sizeof(tmpFile))
+    {
+        return false;
+    }
+
+    table = (ModelFileSection *)calloc(nbSections, sizeof(ModelFileSection));
+    if (table == NULL)
+    {
+        return false;
+    }
+
+    // 各セクションの位置を決める
+    pos = ModelFileAlign(sizeof(ModelFileHeader) + (uint64_t)nbSections * sizeof(ModelFileSection));
+    for (i = 0; i < nbSections; i++)
+    {
+        table[i].id = sections[i].id;
+        table[i].phase = sections[i].phase;
+        table[i].offset = pos;
+        table[i].size = sections[i].size;
+        pos = ModelFileAlign(pos + sections[i].size);
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = MODEL_FILE_MAGIC;
+    header.version = MODEL_FILE_VERSION;
+    header.kind = (uint32_t)kind;
+    header.nbSections = nbSections;
+    header.fileSize = pos;
+    header.checksum = ModelChecksumUpdate(MODEL_CHECKSUM_INIT, table, (uint64_t)nbSections * sizeof(ModelFileSection));
+    for (i = 0; i < nbSections; i++)
+    {
+        header.checksum = ModelChecksumUpdate(header.checksum, sections[i].data, sections[i].size);
+    }
+
+    fp = fopen(tmpFile, "wb");
+    if (fp == NULL)
+    {
+        free(table);
+        return false;
+    }
+    isSucceeded = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+                  fwrite(table, sizeof(ModelFileSection), nbSections, fp) == nbSections &&
+                  ModelFileWritePadding(fp, sizeof(ModelFileHeader) + (uint64_t)nbSections * sizeof(ModelFileSection));
+    for (i = 0; isSucceeded && i < nbSections; i++)
+    {
+        isSucceeded = fwrite(sections[i].data, 1, (size_t)sections[i].size, fp) == sections[i].size &&
+                      ModelFileWritePadding(fp, table[i].offset + table[i].size);
+    }
+    free(table);
+
+    if (fclose(fp) == EOF)
+    {
+        isSucceeded = false;
+    }
+    if (!isSucceeded || !ModelFileReplace(tmpFile, file))
+    {
+        remove(tmpFile);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 同じファイル名・サイズ・チェックサムのファイルを照合済みか
+ * 
+ * 置き換えられたファイルはヘッダのチェックサムかサイズが変わるので，照合し直される
+ * 
+ * @param file ファイル名
+ * @param header マップしたファイルのヘッダ
+ * @param isAdd 照合済みとして登録するか
+ * @return bool 照合済みだったか
+ */
+static bool ModelFileVerified(const char *file, const ModelFileHeader *header, bool isAdd)
+{
+    bool isVerified = false;
+    int i;
+
+    SpinLockAcquire(&VerifiedModelsLock);
+    for (i = 0; i < NbVerifiedModels; i++)
+    {
+        if (strcmp(VerifiedModels[i].file, file) == 0)
+        {
+            isVerified = VerifiedModels[i].fileSize == header->fileSize && VerifiedModels[i].checksum == header->checksum;
+            break;
+        }
+    }
+    if (isAdd && !isVerified && strlen(file) < sizeof(VerifiedModels[0].file))
+    {
+        // 同じファイル名の記録があれば上書きし，なければ空きがあるときだけ追加する
+        if (i == NbVerifiedModels && NbVerifiedModels < MODEL_VERIFIED_MAX)
+        {
+            NbVerifiedModels++;
+        }
+        if (i < NbVerifiedModels)
+        {
+            strcpy(VerifiedModels[i].file, file);
+            VerifiedModels[i].fileSize = header->fileSize;
+            VerifiedModels[i].checksum = header->checksum;
+        }
+    }
+    SpinLockRelease(&VerifiedModelsLock);
+    return isVerified;
+}
+
+/**
+ * @brief ヘッダ・セクション表・チェックサムを確かめる
+ * 
+ * ファイル全体のチェックサムの照合は，同じファイルにつきプロセスで1度だけ行う
+ * 
+ * @param model マップしたモデルファイル
+ * @param file ファイル名
+ * @param kind モデルの種類
+ * @return bool 正しいファイルか
+ */
+static bool ModelFileValidate(const ModelFile *model, const char *file, ModelKind kind)
+{
+    const ModelFileHeader *header = model->header;
+    uint64_t checksum;
+    uint32_t i;
+
+    if (model->size < sizeof(ModelFileHeader) ||
+        header->magic != MODEL_FILE_MAGIC ||
+        header->version != MODEL_FILE_VERSION ||
+        header->kind != (uint32_t)kind ||
+        header->fileSize != model->size ||
+        header->nbSections > (model->size - sizeof(ModelFileHeader)) / sizeof(ModelFileSection))
+    {
+        return false;
+    }
+
+    for (i = 0; i < header->nbSections; i++)
+    {
+        if (model->sections[i].offset % MODEL_FILE_ALIGN != 0 ||
+            model->sections[i].offset > model->size ||
+            model->sections[i].size > model->size - model->sections[i].offset)
+        {
+            return false;
+        }
+    }
+
+    if (ModelFileVerified(file, header, false))
+    {
+        return true;
+    }
+    checksum = ModelChecksumUpdate(MODEL_CHECKSUM_INIT, model->sections, (uint64_t)header->nbSections * sizeof(ModelFileSection));
+    for (i = 0; i < header->nbSections; i++)
+    {
+        checksum = ModelChecksumUpdate(checksum, model->view + model->sections[i].offset, model->sections[i].size);
+    }
+    if (checksum != header->checksum)
+    {
+        return false;
+    }
+    ModelFileVerified(file, header, true);
+    return true;
+}
+
+/**
+ * @brief モデルファイルを読み込み専用でメモリにマップする
+ * 
+ * ファイルがないときはメッセージを出さずに失敗する（従来の形式のファイルから読み込むため）
+ * 
+ * @param model マップ情報の格納先
+ * @param file ファイル名
+ * @param kind モデルの種類
+ * @return bool マップできたか
+ */
+bool ModelFileOpen(ModelFile *model, const char *file, ModelKind kind)
+{
+    model->view = NULL;
+    model->size = 0;
+#ifdef _WIN32
+    LARGE_INTEGER fileSize;
+    model->mapping = NULL;
+    // 開いている間もModelFileSaveで置き換えられるよう，削除・名前変更を許す
+    model->file = CreateFileA(file, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (model->file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    if (GetFileSizeEx(model->file, &fileSize) && fileSize.QuadPart > 0)
+    {
+        model->mapping = CreateFileMappingA(model->file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (model->mapping != NULL)
+        {
+            model->view = (const uint8 *)MapViewOfFile(model->mapping, FILE_MAP_READ, 0, 0, 0);
+            model->size = (size_t)fileSize.QuadPart;
+        }
+    }
+    if (model->view == NULL)
+    {
+        if (model->mapping != NULL)
+        {
+            CloseHandle(model->mapping);
+        }
+        CloseHandle(model->file);
+        return false;
+    }
+#else
+    struct stat fileStat;
+    int fd = open(file, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0)
+    {
+        // 共有マップにして，他のプロセスと同じページを使う
+        void *view = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (view != MAP_FAILED)
+        {
+            model->view = (const uint8 *)view;
+            model->size = (size_t)fileStat.st_size;
+        }
+    }
+    close(fd);
+    if (model->view == NULL)
+    {
+        return false;
+    }
+#endif
+
+    model->header = (const ModelFileHeader *)model->view;
+    model->sections = (const ModelFileSection *)(model->view + sizeof(ModelFileHeader));
+    if (!ModelFileValidate(model, file, kind))
+    {
+        fprintf(stderr, "モデルファイル(%s)の形式が違うか，壊れています。\n", file);
+        ModelFileClose(model);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief セクションのデータを探す
+ * 
+ * @param model マップしたモデルファイル
+ * @param id セクションの種類
+ * @param phase フェーズ
+ * @param size 期待するサイズ
+ * @return const void* データの先頭（MODEL_FILE_ALIGNに整列，見つからないかサイズが違うときはNULL）
+ */
+const void *ModelFileSectionData(const ModelFile *model, uint32_t id, uint32_t phase, uint64_t size)
+{
+    for (uint32_t i = 0; i < model->header->nbSections; i++)
+    {
+        if (model->sections[i].id == id && model->sections[i].phase == phase)
+        {
+            return (model->sections[i].size == size) ? model->view + model->sections[i].offset : NULL;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief マップしたモデルファイルを閉じる
+ * 
+ * @param model マップ情報
+ */
+void ModelFileClose(ModelFile *model)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(model->view);
+    CloseHandle(model->mapping);
+    CloseHandle(model->file);
+#else
+    munmap((void *)model->view, model->size);
+#endif
+    model->view = NULL;
+    model->size = 0;
+}
@@ -0,0 +1,81 @@
+#ifndef MODEL_FILE_DEFINED
+#define MODEL_FILE_DEFINED
+
+#include <stddef.h>
+#include "../const.h"
+
+// モデルファイルの識別子("MRMD")
+#define MODEL_FILE_MAGIC (0x444D524D)
+// モデルファイルの形式バージョン（ヘッダやセクション表の構造を変えたら上げる）
+#define MODEL_FILE_VERSION 1
+// 各セクションの先頭の整列サイズ（キャッシュライン）
+#define MODEL_FILE_ALIGN 64
+// モデルのフォルダ内でのファイル名
+#define MODEL_FILE_NAME "model.bin"
+
+// モデルの種類
+typedef enum ModelKind
+{
+    MODEL_KIND_REGRESSION = 1,
+    MODEL_KIND_QNNET = 2
+} ModelKind;
+
+// モデルファイルのヘッダ
+typedef struct ModelFileHeader
+{
+    // 識別子
+    uint32_t magic;
+    // 形式バージョン
+    uint32_t version;
+    // モデルの種類(ModelKind)
+    uint32_t kind;
+    // セクション数
+    uint32_t nbSections;
+    // ファイル全体のサイズ
+    uint64_t fileSize;
+    // セクション表と各セクションのデータのチェックサム
+    uint64_t checksum;
+} ModelFileHeader;
+
+// セクション表の要素（ヘッダの直後に並ぶ）
+typedef struct ModelFileSection
+{
+    // セクションの種類（モデルの種類ごとに定義）
+    uint32_t id;
+    // フェーズ（フェーズによらないセクションは0）
+    uint32_t phase;
+    // ファイル先頭からの位置（MODEL_FILE_ALIGNの倍数）
+    uint64_t offset;
+    // サイズ
+    uint64_t size;
+} ModelFileSection;
+
+// 書き込むセクション
+typedef struct ModelSectionData
+{
+    uint32_t id;
+    uint32_t phase;
+    const void *data;
+    uint64_t size;
+} ModelSectionData;
+
+// 読み込み専用でマップしたモデルファイル
+typedef struct ModelFile
+{
+    const uint8 *view;
+    size_t size;
+    const ModelFileHeader *header;
+    const ModelFileSection *sections;
+#ifdef _WIN32
+    // HANDLE
+    void *file;
+    void *mapping;
+#endif
+} ModelFile;
+
+bool ModelFileSave(const char *file, ModelKind kind, const ModelSectionData sections[], uint32_t nbSections);
+bool ModelFileOpen(ModelFile *model, const char *file, ModelKind kind);
+const void *ModelFileSectionData(const ModelFile *model, uint32_t id, uint32_t phase, uint64_t size);
+void ModelFileClose(ModelFile *model);
+
+#endif
@@ -13,6 +13,14 @@
  * 入力層から隠れ層の間は殆どが0接続になるため，
  * 必要な接続箇所のみ計算するように実装
  * 
+ * 探索中は入力層 -> 中間層1の和（アキュムレータ）を評価器が局面ごとに持ち，
+ * 着手で変わったパターンの重みだけを足し引きして更新する（PredictWithAcc）。
+ * c1は[入力][中間層1のユニット]の並びなので，1パターン分の32個の重みは連続している。
+ * 
+ * 探索用には重みを量子化したQNNet（入力層int16，中間層int8）を使う。
+ * アキュムレータはint32で持ち，中間層1の活性化関数以降はfloatで計算する。
+ * QNNetはモデルファイル（model_file.c）に保存でき，ファイルがあればマップしてそのまま使う。
+ * 
  */
 
 #define _CRT_SECURE_NO_WARNINGS
@@ -25,6 +33,42 @@
 #include <stdio.h>
 #include <math.h>
 #include <assert.h>
+#ifdef USE_INTRIN
+#include <intrin.h>
+#endif
+#include "../bit_operation.h"
+
+// 各パターンの入力層の重みの，c1内での先頭行
+static uint32_t FeatWeightOffset[FEAT_NUM];
+
+// モデルファイルのセクション
+#define QNNET_SECTION_LAYOUT 1
+#define QNNET_SECTION_NET 2
+
+// モデルファイルに保存するネットワークの構造
+typedef struct QNNetModelLayout
+{
+    uint32_t netSize;
+    uint32_t nbFeatComb;
+    uint32_t nbHiddenUnits1;
+    uint32_t nbHiddenUnits2;
+} QNNetModelLayout;
+
+static void AccumulateScalar(const NNet *net, const uint16_t features[FEAT_NUM_PADDED], float acc[VALUE_HIDDEN_UNITS1]);
+static void AccumulateDeltaScalar(const NNet *net, const uint16_t prev[FEAT_NUM_PADDED], const uint16_t next[FEAT_NUM_PADDED],
+                                  const float prevAcc[VALUE_HIDDEN_UNITS1], float acc[VALUE_HIDDEN_UNITS1]);
+static void (*AccumulateKernel)(const NNet *net, const uint16_t features[FEAT_NUM_PADDED], float acc[VALUE_HIDDEN_UNITS1]) = AccumulateScalar;
+static void (*AccumulateDeltaKernel)(const NNet *net, const uint16_t prev[FEAT_NUM_PADDED], const uint16_t next[FEAT_NUM_PADDED],
+                                     const float prevAcc[VALUE_HIDDEN_UNITS1], float acc[VALUE_HIDDEN_UNITS1]) = AccumulateDeltaScalar;
+
+static void QAccumulateScalar(const QNNet *qnet, const uint16_t features[FEAT_NUM_PADDED], int32_t acc[VALUE_HIDDEN_UNITS1]);
+static void QAccumulateDeltaScalar(const QNNet *qnet, const uint16_t prev[FEAT_NUM_PADDED], const uint16_t next[FEAT_NUM_PADDED],
+                                   const int32_t prevAcc[VALUE_HIDDEN_UNITS1], int32_t acc[VALUE_HIDDEN_UNITS1]);
+static float QPredictScalar(const QNNet *qnet, const int32_t acc[VALUE_HIDDEN_UNITS1]);
+static void (*QAccumulateKernel)(const QNNet *qnet, const uint16_t features[FEAT_NUM_PADDED], int32_t acc[VALUE_HIDDEN_UNITS1]) = QAccumulateScalar;
+static void (*QAccumulateDeltaKernel)(const QNNet *qnet, const uint16_t prev[FEAT_NUM_PADDED], const uint16_t next[FEAT_NUM_PADDED],
+                                      const int32_t prevAcc[VALUE_HIDDEN_UNITS1], int32_t acc[VALUE_HIDDEN_UNITS1]) = QAccumulateDeltaScalar;
+static float (*QPredictKernel)(const QNNet *qnet, const int32_t acc[VALUE_HIDDEN_UNITS1]) = QPredictScalar;
 
 float act(float x)
 {
@@ -121,6 +165,636 @@ float Predict(NNet *net, const uint16_t features[])
     return forward(net, features, 0) - 0.5f;
 }
 
+/**
+ * @brief 中間層1への入力の和を計算（SIMDなし）
+ * 
+ * forwardと同じく，バイアスはパターンの数だけ足す
+ * 
+ * @param net ネットワーク
+ * @param features パターンのインデックス
+ * @param acc 出力：中間層1への入力の和
+ */
+static void AccumulateScalar(const NNet *net, const uint16_t features[FEAT_NUM_PADDED], float acc[VALUE_HIDDEN_UNITS1])
+{
+    const float *weight;
+    int unitIdx, featIdx;
+
+    for (unitIdx = 0; unitIdx < VALUE_HIDDEN_UNITS1; unitIdx++)
+    {
+        acc[unitIdx] = net->c1[NB_FEAT_COMB][unitIdx] * FEAT_NUM;
+    }
+    for (featIdx = 0; featIdx < FEAT_NUM; featIdx++)
+    {
+        weight = net->c1[FeatWeightOffset[featIdx] + features[featIdx]];
+        for (unitIdx = 0; unitIdx < VALUE_HIDDEN_UNITS1; unitIdx++)
+        {
+            acc[unitIdx] += weight[unitIdx];
+        }
+    }
+}
+
+/**
+ * @brief 変化したパターンの分だけ中間層1への入力の和を更新（SIMDなし）
+ * 
+ * @param net ネットワーク
+ * @param prev 更新前のパターンのインデックス
+ * @param next 更新後のパターンのインデックス
+ * @param prevAcc 更新前の中間層1への入力の和
+ * @param acc 出力：更新後の中間層1への入力の和
+ */
+static void AccumulateDeltaScalar(const NNet *net, const uint16_t prev[FEAT_NUM_PADDED], const uint16_t next[FEAT_NUM_PADDED],
+                                  const float prevAcc[VALUE_HIDDEN_UNITS1], float acc[VALUE_HIDDEN_UNITS1])
+{
+    const float *add, *sub;
+    int unitIdx, featIdx;
+
+    memcpy(acc, prevAcc, sizeof(float) * VALUE_HIDDEN_UNITS1);
+    for (featIdx = 0; featIdx < FEAT_NUM; featIdx++)
+    {
+        if (prev[featIdx] == next[featIdx])
+            continue;
+        add = net->c1[FeatWeightOffset[featIdx] + next[featIdx]];
+        sub = net->c1[FeatWeightOffset[featIdx] + prev[featIdx]];
+        for (unitIdx = 0; unitIdx < VALUE_HIDDEN_UNITS1; unitIdx++)
+        {
+            acc[unitIdx] = acc[unitIdx] + add[unitIdx] - sub[unitIdx];
+        }
+    }
+}
+
+#ifdef USE_INTRIN
+/**
+ * @brief 中間層1への入力の和を計算（AVX2，32ユニットを4レジスタで）
+ * 
+ * @param net ネットワーク
+ * @param features パターンのインデックス
+ * @param acc 出力：中間層1への入力の和
+ */
+TARGET_AVX2 static void AccumulateAVX2(const NNet *net, const uint16_t features[FEAT_NUM_PADDED], float acc[VALUE_HIDDEN_UNITS1])
+{
+    const __m256 nbFeat = _mm256_set1_ps((float)FEAT_NUM);
+    const float *bias = net->c1[NB_FEAT_COMB];
+    const float *weight;
+    __m256 acc0 = _mm256_mul_ps(_mm256_loadu_ps(bias + 0), nbFeat);
+    __m256 acc1 = _mm256_mul_ps(_mm256_loadu_ps(bias + 8), nbFeat);
+    __m256 acc2 = _mm256_mul_ps(_mm256_loadu_ps(bias + 16), nbFeat);
+    __m256 acc3 = _mm256_mul_ps(_mm256_loadu_ps(bias + 24), nbFeat);
+
+    for (int featIdx = 0; featIdx < FEAT_NUM; featIdx++)
+    {
+        weight = net->c1[FeatWeightOffset[featIdx] + features[featIdx]];
+        acc0 = _mm256_add_ps(acc0, _mm256_loadu_ps(weight + 0));
+        acc1 = _mm256_add_ps(acc1, _mm256_loadu_ps(weight + 8));
+        acc2 = _mm256_add_ps(acc2, _mm256_loadu_ps(weight + 16));
+        acc3 = _mm256_add_ps(acc3, _mm256_loadu_ps(weight + 24));
+    }
+    _mm256_storeu_ps(acc + 0, acc0);
+    _mm256_storeu_ps(acc + 8, acc1);
+    _mm256_storeu_ps(acc + 16, acc2);
+    _mm256_storeu_ps(acc + 24, acc3);
+}
+
+/**
+ * @brief 変化したパターンの分だけ中間層1への入力の和を更新（AVX2）
+ * 
+ * 変化したパターンは16個ずつ比較して求める（パディング分は常に等しい）
+ * 
+ * @param net ネットワーク
+ * @param prev 更新前のパターンのインデックス
+ * @param next 更新後のパターンのインデックス
+ * @param prevAcc 更新前の中間層1への入力の和
+ * @param acc 出力：更新後の中間層1への入力の和
+ */
+TARGET_AVX2 static void AccumulateDeltaAVX2(const NNet *net, const uint16_t prev[FEAT_NUM_PADDED], const uint16_t next[FEAT_NUM_PADDED],
+                                            const float prevAcc[VALUE_HIDDEN_UNITS1], float acc[VALUE_HIDDEN_UNITS1])
+{
+    const float *add, *sub;
+    __m256 acc0 = _mm256_loadu_ps(prevAcc + 0);
+    __m256 acc1 = _mm256_loadu_ps(prevAcc + 8);
+    __m256 acc2 = _mm256_loadu_ps(prevAcc + 16);
+    __m256 acc3 = _mm256_loadu_ps(prevAcc + 24);
+    __m256i same;
+    uint32_t changed;
+    int base, featIdx;
+
+    for (base = 0; base < FEAT_NUM_PADDED; base += 16)
+    {
+        same = _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i *)(prev + base)),
+                                  _mm256_loadu_si256((const __m256i *)(next + base)));
+        // 1パターンにつき2bit立つので，下位bitだけ見る
+        changed = ~(uint32_t)_mm256_movemask_epi8(same) & 0x55555555;
+        for (; changed; changed &= changed - 1)
+        {
+            featIdx = base + (int)(_tzcnt_u32(changed) >> 1);
+            add = net->c1[FeatWeightOffset[featIdx] + next[featIdx]];
+            sub = net->c1[FeatWeightOffset[featIdx] + prev[featIdx]];
+            acc0 = _mm256_sub_ps(_mm256_add_ps(acc0, _mm256_loadu_ps(add + 0)), _mm256_loadu_ps(sub + 0));
+            acc1 = _mm256_sub_ps(_mm256_add_ps(acc1, _mm256_loadu_ps(add + 8)), _mm256_loadu_ps(sub + 8));
+            acc2 = _mm256_sub_ps(_mm256_add_ps(acc2, _mm256_loadu_ps(add + 16)), _mm256_loadu_ps(sub + 16));
+            acc3 = _mm256_sub_ps(_mm256_add_ps(acc3, _mm256_loadu_ps(add + 24)), _mm256_loadu_ps(sub + 24));
+        }
+    }
+    _mm256_storeu_ps(acc + 0, acc0);
+    _mm256_storeu_ps(acc + 8, acc1);
+    _mm256_storeu_ps(acc + 16, acc2);
+    _mm256_storeu_ps(acc + 24, acc3);
+}
+#endif
+
+/**
+ * @brief 中間層1への入力の和を量子化した重みで計算（SIMDなし）
+ * 
+ * @param qnet 量子化したネットワーク
+ * @param features パターンのインデックス
+ * @param acc 出力：中間層1への入力の和（scale1倍）
+ */
+static void QAccumulateScalar(const QNNet *qnet, const uint16_t features[FEAT_NUM_PADDED], int32_t acc[VALUE_HIDDEN_UNITS1])
+{
+    const int16_t *weight;
+    int unitIdx, featIdx;
+
+    memcpy(acc, qnet->bias1, sizeof(int32_t) * VALUE_HIDDEN_UNITS1);
+    for (featIdx = 0; featIdx < FEAT_NUM; featIdx++)
+    {
+        weight = qnet->c1[FeatWeightOffset[featIdx] + features[featIdx]];
+        for (unitIdx = 0; unitIdx < VALUE_HIDDEN_UNITS1; unitIdx++)
+        {
+            acc[unitIdx] += weight[unitIdx];
+        }
+    }
+}
+
+/**
+ * @brief 変化したパターンの分だけ量子化したアキュムレータを更新（SIMDなし）
+ * 
+ * @param qnet 量子化したネットワーク
+ * @param prev 更新前のパターンのインデックス
+ * @param next 更新後のパターンのインデックス
+ * @param prevAcc 更新前の中間層1への入力の和
+ * @param acc 出力：更新後の中間層1への入力の和
+ */
+static void QAccumulateDeltaScalar(const QNNet *qnet, const uint16_t prev[FEAT_NUM_PADDED], const uint16_t next[FEAT_NUM_PADDED],
+                                   const int32_t prevAcc[VALUE_HIDDEN_UNITS1], int32_t acc[VALUE_HIDDEN_UNITS1])
+{
+    const int16_t *add, *sub;
+    int unitIdx, featIdx;
+
+    memcpy(acc, prevAcc, sizeof(int32_t) * VALUE_HIDDEN_UNITS1);
+    for (featIdx = 0; featIdx < FEAT_NUM; featIdx++)
+    {
+        if (prev[featIdx] == next[featIdx])
+            continue;
+        add = qnet->c1[FeatWeightOffset[featIdx] + next[featIdx]];
+        sub = qnet->c1[FeatWeightOffset[featIdx] + prev[featIdx]];
+        for (unitIdx = 0; unitIdx < VALUE_HIDDEN_UNITS1; unitIdx++)
+        {
+            acc[unitIdx] += add[unitIdx] - sub[unitIdx];
+        }
+    }
+}
+
+/**
+ * @brief 量子化したアキュムレータから予測する（SIMDなし）
+ * 
+ * @param qnet 量子化したネットワーク
+ * @param acc 中間層1への入力の和（scale1倍）
+ * @return float 予測値（Predictと同じ）
+ */
+static float QPredictScalar(const QNNet *qnet, const int32_t acc[VALUE_HIDDEN_UNITS1])
+{
+    const float invScale1 = 1.0f / qnet->scale1;
+    float out1[VALUE_HIDDEN_UNITS1];
+    float out2[VALUE_HIDDEN_UNITS2];
+    float sum;
+    int unitIdx, prevUnit;
+
+    for (unitIdx = 0; unitIdx < VALUE_HIDDEN_UNITS1; unitIdx++)
+    {
+        out1[unitIdx] = act((float)acc[unitIdx] * invScale1);
+    }
+
+    for (unitIdx = 0; unitIdx < VALUE_HIDDEN_UNITS2; unitIdx++)
+    {
+        sum = 0;
+        for (prevUnit = 0; prevUnit < VALUE_HIDDEN_UNITS1; prevUnit++)
+        {
+            sum += qnet->c2[unitIdx][prevUnit] * out1[prevUnit];
+        }
+        out2[unitIdx] = act(sum / qnet->scale2 + qnet->bias2[unitIdx]);
+    }
+
+    sum = 0;
+    for (prevUnit = 0; prevUnit < VALUE_HIDDEN_UNITS2; prevUnit++)
+    {
+        sum += qnet->c3[prevUnit] * out2[prevUnit];
+    }
+    return sum / qnet->scale3 + qnet->bias3 - 0.5f;
+}
+
+#ifdef USE_INTRIN
+/**
+ * @brief 8個のexp（AVX2）
+ * 
+ * 2^n * exp(r)（|r| <= ln2 / 2）に分けて，exp(r)を多項式で近似する（相対誤差2e-7程度）
+ * 
+ * @param x 入力
+ * @return __m256 exp(x)
+ */
+TARGET_AVX2 static inline __m256 ExpAVX2(__m256 x)
+{
+    __m256 fx, r, y;
+    __m256i pow2n;
+
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-87.3f)), _mm256_set1_ps(88.3f));
+    fx = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    // r = x - n * ln2（ln2を上位と下位に分けて引く）
+    r = _mm256_sub_ps(x, _mm256_mul_ps(fx, _mm256_set1_ps(0.693359375f)));
+    r = _mm256_add_ps(r, _mm256_mul_ps(fx, _mm256_set1_ps(2.12194440e-4f)));
+
+    y = _mm256_set1_ps(1.9875691500e-4f);
+    y = _mm256_add_ps(_mm256_mul_ps(y, r), _mm256_set1_ps(1.3981999507e-3f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, r), _mm256_set1_ps(8.3334519073e-3f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, r), _mm256_set1_ps(4.1665795894e-2f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, r), _mm256_set1_ps(1.6666665459e-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, r), _mm256_set1_ps(5.0000001201e-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(y, r), r), _mm256_add_ps(r, _mm256_set1_ps(1.0f)));
+
+    pow2n = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(fx), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(y, _mm256_castsi256_ps(pow2n));
+}
+
+/**
+ * @brief 8個のtanhExp（AVX2）
+ * 
+ * x * tanh(exp(x))，tanh(e) = 1 - 2 / (exp(2e) + 1)
+ * exp(x) > 9.9ではfloatのtanhは1になるので，x <= 2.3に丸めてからexpをとる
+ * 
+ * @param x 入力
+ * @return __m256 x * tanh(exp(x))
+ */
+TARGET_AVX2 static inline __m256 ActAVX2(__m256 x)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 two = _mm256_set1_ps(2.0f);
+    __m256 e = ExpAVX2(_mm256_min_ps(x, _mm256_set1_ps(2.3f)));
+    __m256 t = _mm256_sub_ps(one, _mm256_div_ps(two, _mm256_add_ps(ExpAVX2(_mm256_mul_ps(e, two)), one)));
+    return _mm256_mul_ps(x, t);
+}
+
+/**
+ * @brief 8個の和
+ */
+TARGET_AVX2 static inline float HorizontalSumAVX2(__m256 v)
+{
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+/**
+ * @brief 量子化したint16の重み32個をint32に広げて足し引きする
+ */
+#define QACC_ADD(acc0, acc1, acc2, acc3, op, weight)                                                   \
+    do                                                                                                 \
+    {                                                                                                  \
+        __m256i w01 = _mm256_loadu_si256((const __m256i *)(weight));                                   \
+        __m256i w23 = _mm256_loadu_si256((const __m256i *)((weight) + 16));                            \
+        acc0 = op(acc0, _mm256_cvtepi16_epi32(_mm256_castsi256_si128(w01)));                           \
+        acc1 = op(acc1, _mm256_cvtepi16_epi32(_mm256_extracti128_si256(w01, 1)));                      \
+        acc2 = op(acc2, _mm256_cvtepi16_epi32(_mm256_castsi256_si128(w23)));                           \
+        acc3 = op(acc3, _mm256_cvtepi16_epi32(_mm256_extracti128_si256(w23, 1)));                      \
+    } while (0)
+
+/**
+ * @brief 中間層1への入力の和を量子化した重みで計算（AVX2）
+ * 
+ * @param qnet 量子化したネットワーク
+ * @param features パターンのインデックス
+ * @param acc 出力：中間層1への入力の和（scale1倍）
+ */
+TARGET_AVX2 static void QAccumulateAVX2(const QNNet *qnet, const uint16_t features[FEAT_NUM_PADDED], int32_t acc[VALUE_HIDDEN_UNITS1])
+{
+    const int16_t *weight;
+    __m256i acc0 = _mm256_loadu_si256((const __m256i *)(qnet->bias1 + 0));
+    __m256i acc1 = _mm256_loadu_si256((const __m256i *)(qnet->bias1 + 8));
+    __m256i acc2 = _mm256_loadu_si256((const __m256i *)(qnet->bias1 + 16));
+    __m256i acc3 = _mm256_loadu_si256((const __m256i *)(qnet->bias1 + 24));
+
+    for (int featIdx = 0; featIdx < FEAT_NUM; featIdx++)
+    {
+        weight = qnet->c1[FeatWeightOffset[featIdx] + features[featIdx]];
+        QACC_ADD(acc0, acc1, acc2, acc3, _mm256_add_epi32, weight);
+    }
+    _mm256_storeu_si256((__m256i *)(acc + 0), acc0);
+    _mm256_storeu_si256((__m256i *)(acc + 8), acc1);
+    _mm256_storeu_si256((__m256i *)(acc + 16), acc2);
+    _mm256_storeu_si256((__m256i *)(acc + 24), acc3);
+}
+
+/**
+ * @brief 変化したパターンの分だけ量子化したアキュムレータを更新（AVX2）
+ * 
+ * @param qnet 量子化したネットワーク
+ * @param prev 更新前のパターンのインデックス
+ * @param next 更新後のパターンのインデックス
+ * @param prevAcc 更新前の中間層1への入力の和
+ * @param acc 出力：更新後の中間層1への入力の和
+ */
+TARGET_AVX2 static void QAccumulateDeltaAVX2(const QNNet *qnet, const uint16_t prev[FEAT_NUM_PADDED], const uint16_t next[FEAT_NUM_PADDED],
+                                             const int32_t prevAcc[VALUE_HIDDEN_UNITS1], int32_t acc[VALUE_HIDDEN_UNITS1])
+{
+    const int16_t *add, *sub;
+    __m256i acc0 = _mm256_loadu_si256((const __m256i *)(prevAcc + 0));
+    __m256i acc1 = _mm256_loadu_si256((const __m256i *)(prevAcc + 8));
+    __m256i acc2 = _mm256_loadu_si256((const __m256i *)(prevAcc + 16));
+    __m256i acc3 = _mm256_loadu_si256((const __m256i *)(prevAcc + 24));
+    __m256i same;
+    uint32_t changed;
+    int base, featIdx;
+
+    for (base = 0; base < FEAT_NUM_PADDED; base += 16)
+    {
+        same = _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i *)(prev + base)),
+                                  _mm256_loadu_si256((const __m256i *)(next + base)));
+        changed = ~(uint32_t)_mm256_movemask_epi8(same) & 0x55555555;
+        for (; changed; changed &= changed - 1)
+        {
+            featIdx = base + (int)(_tzcnt_u32(changed) >> 1);
+            add = qnet->c1[FeatWeightOffset[featIdx] + next[featIdx]];
+            sub = qnet->c1[FeatWeightOffset[featIdx] + prev[featIdx]];
+            QACC_ADD(acc0, acc1, acc2, acc3, _mm256_add_epi32, add);
+            QACC_ADD(acc0, acc1, acc2, acc3, _mm256_sub_epi32, sub);
+        }
+    }
+    _mm256_storeu_si256((__m256i *)(acc + 0), acc0);
+    _mm256_storeu_si256((__m256i *)(acc + 8), acc1);
+    _mm256_storeu_si256((__m256i *)(acc + 16), acc2);
+    _mm256_storeu_si256((__m256i *)(acc + 24), acc3);
+}
+
+/**
+ * @brief 量子化したアキュムレータから予測する（AVX2）
+ * 
+ * 中間層1の32ユニットの活性化関数を8個ずつまとめて計算する
+ * 
+ * @param qnet 量子化したネットワーク
+ * @param acc 中間層1への入力の和（scale1倍）
+ * @return float 予測値（Predictと同じ）
+ */
+TARGET_AVX2 static float QPredictAVX2(const QNNet *qnet, const int32_t acc[VALUE_HIDDEN_UNITS1])
+{
+    const __m256 invScale1 = _mm256_set1_ps(1.0f / qnet->scale1);
+    __m256 out1[VALUE_HIDDEN_UNITS1 / 8];
+    __m256 sumv, weight;
+    float out2[VALUE_HIDDEN_UNITS2];
+    float sum;
+    int unitIdx, i;
+
+    for (i = 0; i < VALUE_HIDDEN_UNITS1 / 8; i++)
+    {
+        out1[i] = ActAVX2(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i *)(acc + i * 8))), invScale1));
+    }
+
+    for (unitIdx = 0; unitIdx < VALUE_HIDDEN_UNITS2; unitIdx++)
+    {
+        sumv = _mm256_setzero_ps();
+        for (i = 0; i < VALUE_HIDDEN_UNITS1 / 8; i++)
+        {
+            weight = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *)(qnet->c2[unitIdx] + i * 8))));
+            sumv = _mm256_add_ps(sumv, _mm256_mul_ps(weight, out1[i]));
+        }
+        out2[unitIdx] = act(HorizontalSumAVX2(sumv) / qnet->scale2 + qnet->bias2[unitIdx]);
+    }
+
+    sum = 0;
+    for (i = 0; i < VALUE_HIDDEN_UNITS2; i++)
+    {
+        sum += qnet->c3[i] * out2[i];
+    }
+    return sum / qnet->scale3 + qnet->bias3 - 0.5f;
+}
+#endif
+
+/**
+ * @brief 推論用の準備（パターンごとの重みの位置・実装の選択）
+ * 
+ * 実装は，BitKernelSelectで選択したビット演算の実装と同じ命令セットの段階に合わせる
+ */
+static void NNetInferenceInit()
+{
+    uint32_t shift = 0;
+    for (int featIdx = 0; featIdx < FEAT_NUM; featIdx++)
+    {
+        FeatWeightOffset[featIdx] = shift;
+        shift += FTYPE_INDEX_MAX[FeatID2Type[featIdx]];
+    }
+    assert(shift == NB_FEAT_COMB);
+
+#ifdef USE_INTRIN
+    if (BitKernelLevel() >= CPU_LEVEL_AVX2)
+    {
+        AccumulateKernel = AccumulateAVX2;
+        AccumulateDeltaKernel = AccumulateDeltaAVX2;
+        QAccumulateKernel = QAccumulateAVX2;
+        QAccumulateDeltaKernel = QAccumulateDeltaAVX2;
+        QPredictKernel = QPredictAVX2;
+    }
+    else
+    {
+        AccumulateKernel = AccumulateScalar;
+        AccumulateDeltaKernel = AccumulateDeltaScalar;
+        QAccumulateKernel = QAccumulateScalar;
+        QAccumulateDeltaKernel = QAccumulateDeltaScalar;
+        QPredictKernel = QPredictScalar;
+    }
+#endif
+}
+
+/**
+ * @brief 中間層1への入力の和（アキュムレータ）を計算
+ * 
+ * @param net ネットワーク
+ * @param features パターンのインデックス（FEAT_NUM_PADDED個，パディングは0）
+ * @param acc 出力：中間層1への入力の和
+ */
+void NNetAccumulate(const NNet *net, const uint16_t features[FEAT_NUM_PADDED], float acc[VALUE_HIDDEN_UNITS1])
+{
+    AccumulateKernel(net, features, acc);
+}
+
+/**
+ * @brief 変化したパターンの重みだけを足し引きしてアキュムレータを更新
+ * 
+ * @param net ネットワーク
+ * @param prev 更新前のパターンのインデックス
+ * @param next 更新後のパターンのインデックス
+ * @param prevAcc 更新前の中間層1への入力の和
+ * @param acc 出力：更新後の中間層1への入力の和
+ */
+void NNetAccumulateDelta(const NNet *net, const uint16_t prev[FEAT_NUM_PADDED], const uint16_t next[FEAT_NUM_PADDED],
+                         const float prevAcc[VALUE_HIDDEN_UNITS1], float acc[VALUE_HIDDEN_UNITS1])
+{
+    AccumulateDeltaKernel(net, prev, next, prevAcc, acc);
+}
+
+/**
+ * @brief アキュムレータから予測する
+ * 
+ * 中間層1以降はforwardと同じ計算（バイアスも同じ回数足す）
+ * 
+ * @param net ネットワーク
+ * @param acc 中間層1への入力の和
+ * @return float 予測値（Predictと同じ）
+ */
+float PredictWithAcc(const NNet *net, const float acc[VALUE_HIDDEN_UNITS1])
+{
+    float out1[VALUE_HIDDEN_UNITS1];
+    float out2[VALUE_HIDDEN_UNITS2];
+    float sum;
+    int unitIdx, prevUnit;
+
+    for (unitIdx = 0; unitIdx < VALUE_HIDDEN_UNITS1; unitIdx++)
+    {
+        out1[unitIdx] = act(acc[unitIdx]);
+    }
+
+    for (unitIdx = 0; unitIdx < VALUE_HIDDEN_UNITS2; unitIdx++)
+    {
+        sum = net->c2[VALUE_HIDDEN_UNITS1][unitIdx] * VALUE_HIDDEN_UNITS1;
+        for (prevUnit = 0; prevUnit < VALUE_HIDDEN_UNITS1; prevUnit++)
+        {
+            sum += net->c2[prevUnit][unitIdx] * out1[prevUnit];
+        }
+        out2[unitIdx] = act(sum);
+    }
+
+    sum = net->c3[VALUE_HIDDEN_UNITS2][0] * VALUE_HIDDEN_UNITS2;
+    for (prevUnit = 0; prevUnit < VALUE_HIDDEN_UNITS2; prevUnit++)
+    {
+        sum += net->c3[prevUnit][0] * out2[prevUnit];
+    }
+    return sum - 0.5f;
+}
+
+/**
+ * @brief 量子化したネットワークで中間層1への入力の和を計算
+ * 
+ * @param qnet 量子化したネットワーク
+ * @param features パターンのインデックス（FEAT_NUM_PADDED個，パディングは0）
+ * @param acc 出力：中間層1への入力の和（scale1倍）
+ */
+void QNNetAccumulate(const QNNet *qnet, const uint16_t features[FEAT_NUM_PADDED], int32_t acc[VALUE_HIDDEN_UNITS1])
+{
+    QAccumulateKernel(qnet, features, acc);
+}
+
+/**
+ * @brief 量子化したネットワークのアキュムレータを，変化したパターンの分だけ更新
+ * 
+ * 整数の足し引きなので，計算し直したものと常に一致する
+ * 
+ * @param qnet 量子化したネットワーク
+ * @param prev 更新前のパターンのインデックス
+ * @param next 更新後のパターンのインデックス
+ * @param prevAcc 更新前の中間層1への入力の和
+ * @param acc 出力：更新後の中間層1への入力の和
+ */
+void QNNetAccumulateDelta(const QNNet *qnet, const uint16_t prev[FEAT_NUM_PADDED], const uint16_t next[FEAT_NUM_PADDED],
+                          const int32_t prevAcc[VALUE_HIDDEN_UNITS1], int32_t acc[VALUE_HIDDEN_UNITS1])
+{
+    QAccumulateDeltaKernel(qnet, prev, next, prevAcc, acc);
+}
+
+/**
+ * @brief 量子化したネットワークのアキュムレータから予測する
+ * 
+ * @param qnet 量子化したネットワーク
+ * @param acc 中間層1への入力の和（scale1倍）
+ * @return float 予測値（Predictと同じ）
+ */
+float QPredictWithAcc(const QNNet *qnet, const int32_t acc[VALUE_HIDDEN_UNITS1])
+{
+    return QPredictKernel(qnet, acc);
+}
+
+/**
+ * @brief 量子化したネットワークで予測する
+ * 
+ * @param qnet 量子化したネットワーク
+ * @param features パターンのインデックス
+ * @return float 予測値（Predictと同じ）
+ */
+float QPredict(const QNNet *qnet, const uint16_t features[])
+{
+    int32_t acc[VALUE_HIDDEN_UNITS1];
+    QAccumulateKernel(qnet, features, acc);
+    return QPredictKernel(qnet, acc);
+}
+
+/**
+ * @brief 重みの絶対値の最大がqmaxになる倍率
+ * 
+ * @param weight 重み
+ * @param nbWeight 重みの数
+ * @param qmax 量子化後の最大値
+ * @return float 倍率（量子化値 = 重み * 倍率）
+ */
+static float QuantScale(const float *weight, size_t nbWeight, float qmax)
+{
+    float maxAbs = 0;
+    for (size_t i = 0; i < nbWeight; i++)
+    {
+        if (fabsf(weight[i]) > maxAbs)
+            maxAbs = fabsf(weight[i]);
+    }
+    return (maxAbs > 0) ? qmax / maxAbs : 1.0f;
+}
+
+/**
+ * @brief ネットワークを推論用に量子化する
+ * 
+ * 入力層の重みはint16，中間層の重みはint8へ，それぞれ層ごとに絶対値の最大で正規化する
+ * バイアスはforwardと同じ回数足したものを持つ
+ * 
+ * @param net ネットワーク
+ * @param qnet 出力：量子化したネットワーク
+ */
+void QuantizeNet(const NNet *net, QNNet *qnet)
+{
+    int featIdx, unitIdx, prevUnit;
+
+    qnet->scale1 = QuantScale(&net->c1[0][0], (size_t)NB_FEAT_COMB * VALUE_HIDDEN_UNITS1, INT16_MAX);
+    for (featIdx = 0; featIdx < NB_FEAT_COMB; featIdx++)
+    {
+        for (unitIdx = 0; unitIdx < VALUE_HIDDEN_UNITS1; unitIdx++)
+        {
+            qnet->c1[featIdx][unitIdx] = (int16_t)lrintf(net->c1[featIdx][unitIdx] * qnet->scale1);
+        }
+    }
+    for (unitIdx = 0; unitIdx < VALUE_HIDDEN_UNITS1; unitIdx++)
+    {
+        qnet->bias1[unitIdx] = (int32_t)lrintf(net->c1[NB_FEAT_COMB][unitIdx] * FEAT_NUM * qnet->scale1);
+    }
+
+    qnet->scale2 = QuantScale(&net->c2[0][0], (size_t)VALUE_HIDDEN_UNITS1 * VALUE_HIDDEN_UNITS2, INT8_MAX);
+    for (unitIdx = 0; unitIdx < VALUE_HIDDEN_UNITS2; unitIdx++)
+    {
+        for (prevUnit = 0; prevUnit < VALUE_HIDDEN_UNITS1; prevUnit++)
+        {
+            qnet->c2[unitIdx][prevUnit] = (int8_t)lrintf(net->c2[prevUnit][unitIdx] * qnet->scale2);
+        }
+        qnet->bias2[unitIdx] = net->c2[VALUE_HIDDEN_UNITS1][unitIdx] * VALUE_HIDDEN_UNITS1;
+    }
+
+    qnet->scale3 = QuantScale(&net->c3[0][0], VALUE_HIDDEN_UNITS2, INT8_MAX);
+    for (prevUnit = 0; prevUnit < VALUE_HIDDEN_UNITS2; prevUnit++)
+    {
+        qnet->c3[prevUnit] = (int8_t)lrintf(net->c3[prevUnit][0] * qnet->scale3);
+    }
+    qnet->bias3 = net->c3[VALUE_HIDDEN_UNITS2][0] * VALUE_HIDDEN_UNITS2;
+}
+
 void SaveNets(NNet *net, const char *file)
 {
     int phase;
@@ -155,36 +829,173 @@ void SaveNets(NNet *net, const char *file)
     }
 }
 
-void LoadNets(NNet *net, const char *file)
+/**
+ * @brief 1フェーズ分のモデルファイルを読み込む
+ * 
+ * @param net ネットワーク（1フェーズ分）
+ * @param file モデルのフォルダ
+ * @param phase フェーズ
+ * @return true 読み込めた
+ * @return false 読み込めなかった
+ */
+bool LoadNet(NNet *net, const char *file, int phase)
 {
-    int phase;
     size_t readed;
     char fileName[100];
     FILE *fp;
+
+    sprintf(fileName, "%sphase%d", file, phase);
+    fp = fopen(fileName, "rb");
+    if (fp == NULL)
+    {
+        fputs("読み込み用モデルファイルオープンに失敗しました。\n", stderr);
+        return false;
+    }
+
+    readed = 0;
+    readed += fread(&net->c1, sizeof(float), (NB_FEAT_COMB + 1) * VALUE_HIDDEN_UNITS1, fp);
+    readed += fread(&net->c2, sizeof(float), (VALUE_HIDDEN_UNITS1 + 1) * VALUE_HIDDEN_UNITS2, fp);
+    readed += fread(&net->c3, sizeof(float), (VALUE_HIDDEN_UNITS2 + 1), fp);
+    if (readed < 3)
+    {
+        fputs("モデルファイルの読み込みに失敗しました。\n", stderr);
+        fclose(fp);
+        return false;
+    }
+
+    if (fclose(fp) == EOF)
+    {
+        fputs("モデルファイルクローズに失敗しました。\n", stderr);
+        return false;
+    }
+    return true;
+}
+
+void LoadNets(NNet *net, const char *file)
+{
+    int phase;
+
+    NNetInferenceInit();
     for (phase = 0; phase < NB_PHASE; phase++)
     {
-        sprintf(fileName, "%sphase%d", file, phase);
-        fp = fopen(fileName, "rb");
-        if (fp == NULL)
-        {
-            fputs("読み込み用モデルファイルオープンに失敗しました。\n", stderr);
+        if (!LoadNet(&net[phase], file, phase))
             return;
-        }
+    }
+}
 
-        readed = 0;
-        readed += fread(&net[phase].c1, sizeof(float), (NB_FEAT_COMB + 1) * VALUE_HIDDEN_UNITS1, fp);
-        readed += fread(&net[phase].c2, sizeof(float), (VALUE_HIDDEN_UNITS1 + 1) * VALUE_HIDDEN_UNITS2, fp);
-        readed += fread(&net[phase].c3, sizeof(float), (VALUE_HIDDEN_UNITS2 + 1), fp);
-        if (readed < 3)
-        {
-            fputs("モデルファイルの読み込みに失敗しました。\n", stderr);
-            return;
-        }
+/**
+ * @brief floatのモデルファイルを読み込んで量子化する
+ * 
+ * @param qnet 量子化したネットワーク（NB_PHASE個）
+ * @param file モデルのフォルダ
+ */
+void LoadQNets(QNNet *qnet, const char *file)
+{
+    NNet *net;
+    int phase;
 
-        if (fclose(fp) == EOF)
-        {
-            fputs("モデルファイルクローズに失敗しました。\n", stderr);
-            return;
-        }
+    NNetInferenceInit();
+    net = (NNet *)malloc(sizeof(NNet));
+    if (net == NULL)
+    {
+        fputs("メモリの確保に失敗しました。\n", stderr);
+        return;
+    }
+    for (phase = 0; phase < NB_PHASE; phase++)
+    {
+        if (!LoadNet(net, file, phase))
+            break;
+        QuantizeNet(net, &qnet[phase]);
+    }
+    free(net);
+}
+
+/**
+ * @brief 量子化したネットワークの構造（読み込み時に現在の定義と照合する）
+ * 
+ * @param layout 出力：構造
+ */
+static void QNNetLayoutInit(QNNetModelLayout *layout)
+{
+    memset(layout, 0, sizeof(QNNetModelLayout));
+    layout->netSize = sizeof(QNNet);
+    layout->nbFeatComb = NB_FEAT_COMB;
+    layout->nbHiddenUnits1 = VALUE_HIDDEN_UNITS1;
+    layout->nbHiddenUnits2 = VALUE_HIDDEN_UNITS2;
+}
+
+/**
+ * @brief 量子化したネットワークをモデルファイルに保存する
+ * 
+ * @param qnet 量子化したネットワーク（NB_PHASE個）
+ * @param file モデルのフォルダ（MODEL_FILE_NAMEで保存する）
+ */
+void SaveQNetModel(const QNNet *qnet, const char *file)
+{
+    QNNetModelLayout layout;
+    ModelSectionData sections[1 + NB_PHASE];
+    char fileName[100];
+
+    QNNetLayoutInit(&layout);
+    sections[0].id = QNNET_SECTION_LAYOUT;
+    sections[0].phase = 0;
+    sections[0].data = &layout;
+    sections[0].size = sizeof(layout);
+    for (int phase = 0; phase < NB_PHASE; phase++)
+    {
+        sections[1 + phase].id = QNNET_SECTION_NET;
+        sections[1 + phase].phase = phase;
+        sections[1 + phase].data = &qnet[phase];
+        sections[1 + phase].size = sizeof(QNNet);
+    }
+
+    sprintf(fileName, "%s%s", file, MODEL_FILE_NAME);
+    if (!ModelFileSave(fileName, MODEL_KIND_QNNET, sections, 1 + NB_PHASE))
+    {
+        fputs("モデルファイルへの書き込みに失敗しました。\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief モデルファイルをマップして量子化したネットワークとして使う
+ * 
+ * @param qnet 出力：フェーズごとのネットワーク（ファイル内を直接指す）
+ * @param file モデルのフォルダ（MODEL_FILE_NAMEを読み込む）
+ * @return ModelFile* マップしたモデルファイル（ファイルがない・形式が違うときはNULL）
+ */
+ModelFile *MapQNetModel(const QNNet *qnet[NB_PHASE], const char *file)
+{
+    QNNetModelLayout layout;
+    const QNNetModelLayout *fileLayout;
+    ModelFile *model;
+    char fileName[100];
+    bool isValid;
+    int phase;
+
+    model = (ModelFile *)malloc(sizeof(ModelFile));
+    sprintf(fileName, "%s%s", file, MODEL_FILE_NAME);
+    if (model == NULL || !ModelFileOpen(model, fileName, MODEL_KIND_QNNET))
+    {
+        free(model);
+        return NULL;
+    }
+
+    QNNetLayoutInit(&layout);
+    fileLayout = (const QNNetModelLayout *)ModelFileSectionData(model, QNNET_SECTION_LAYOUT, 0, sizeof(layout));
+    isValid = fileLayout != NULL && memcmp(fileLayout, &layout, sizeof(layout)) == 0;
+    for (phase = 0; isValid && phase < NB_PHASE; phase++)
+    {
+        qnet[phase] = (const QNNet *)ModelFileSectionData(model, QNNET_SECTION_NET, phase, sizeof(QNNet));
+        isValid = qnet[phase] != NULL;
+    }
+    if (!isValid)
+    {
+        fprintf(stderr, "モデルファイル(%s)のネットワークの構造が違います。\n", fileName);
+        ModelFileClose(model);
+        free(model);
+        return NULL;
     }
+    NNetInferenceInit();
+    return model;
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define NNET_DEFINED
 
 #include "ai_const.h"
+#include "model_file.h"
 
 #define VALUE_HIDDEN_UNITS1 32
 #define VALUE_HIDDEN_UNITS2 1
@@ -9,6 +10,11 @@
 #define NB_LAYERS 3
 #define NB_PHASE 15
 
+// 探索では量子化したネットワーク（QNNet）で評価する（学習中はfloatのまま）
+#if defined(USE_NN) && !defined(LEARN_MODE)
+#define USE_QNN
+#endif
+
 #ifdef LEARN_MODE
 typedef struct UnitState
 {
@@ -40,10 +46,50 @@ typedef struct NNet
 #endif
 } NNet;
 
+/**
+ * @brief 推論用に量子化したネットワーク
+ * 
+ * 入力層の重みはint16，中間層の重みはint8で持つ（float値 = 量子化値 / scale）
+ * 中間層の出力（活性化関数の値）はfloatのまま扱う
+ */
+typedef struct QNNet
+{
+    // 入力層 -> 中間層1（c1のバイアス以外）
+    int16_t c1[NB_FEAT_COMB][VALUE_HIDDEN_UNITS1];
+    // 中間層1のバイアス（forwardと同じくパターンの数だけ足したもの，scale1倍）
+    int32_t bias1[VALUE_HIDDEN_UNITS1];
+    // 中間層1 -> 中間層2（[出力ユニット][入力ユニット]の並び）
+    int8_t c2[VALUE_HIDDEN_UNITS2][VALUE_HIDDEN_UNITS1];
+    // 中間層2のバイアス（forwardと同じく入力ユニットの数だけ足したもの）
+    float bias2[VALUE_HIDDEN_UNITS2];
+    // 中間層2 -> 出力層
+    int8_t c3[VALUE_HIDDEN_UNITS2];
+    float bias3;
+
+    float scale1;
+    float scale2;
+    float scale3;
+} QNNet;
+
 float Predict(NNet *net, const uint16_t features[]);
+void NNetAccumulate(const NNet *net, const uint16_t features[FEAT_NUM_PADDED], float acc[VALUE_HIDDEN_UNITS1]);
+void NNetAccumulateDelta(const NNet *net, const uint16_t prev[FEAT_NUM_PADDED], const uint16_t next[FEAT_NUM_PADDED],
+                         const float prevAcc[VALUE_HIDDEN_UNITS1], float acc[VALUE_HIDDEN_UNITS1]);
+float PredictWithAcc(const NNet *net, const float acc[VALUE_HIDDEN_UNITS1]);
+
+void QuantizeNet(const NNet *net, QNNet *qnet);
+void QNNetAccumulate(const QNNet *qnet, const uint16_t features[FEAT_NUM_PADDED], int32_t acc[VALUE_HIDDEN_UNITS1]);
+void QNNetAccumulateDelta(const QNNet *qnet, const uint16_t prev[FEAT_NUM_PADDED], const uint16_t next[FEAT_NUM_PADDED],
+                          const int32_t prevAcc[VALUE_HIDDEN_UNITS1], int32_t acc[VALUE_HIDDEN_UNITS1]);
+float QPredictWithAcc(const QNNet *qnet, const int32_t acc[VALUE_HIDDEN_UNITS1]);
+float QPredict(const QNNet *qnet, const uint16_t features[]);
 
 float forward(NNet *net, const uint16_t features[FEAT_NUM], uint8 isTrain);
 void SaveNets(NNet *net, const char *file);
 void LoadNets(NNet *net, const char *file);
+bool LoadNet(NNet *net, const char *file, int phase);
+void LoadQNets(QNNet *qnet, const char *file);
+void SaveQNetModel(const QNNet *qnet, const char *file);
+ModelFile *MapQNetModel(const QNNet *qnet[NB_PHASE], const char *file);
 
 #endif
\ No newline at end of file
@@ -12,22 +12,212 @@
  * M-buroさんの論文を参考に作成
  * https://skatgame.net/mburo/ps/improve.pdf
  * 
+ * 探索中の評価（RegrPredFast）は，学習用のdoubleの重みとは別に
+ * int16に量子化して全フェーズ分を1つの配列に並べた重みを使い，整数で足し合わせる。
+ * （AVX2ではgatherで8パターンずつまとめて引く）
+ * 
+ * 推論用の重み（相手手番の分も計算済み）はモデルファイル（model_file.c）に保存でき，
+ * ファイルがあればマップしてそのまま使う（RegrMapModel）。
+ * 
  */
 
 #define _CRT_SECURE_NO_WARNINGS
 #include "regression.h"
 #include "eval.h"
 
+#ifdef USE_INTRIN
+#include <intrin.h>
+#endif
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 #include <math.h>
 #include "../board.h"
+#include "../bit_operation.h"
+
+// 推論用の重みの配列の整列サイズ
+#define PRED_WEIGHT_ALIGN 64
+
+// 推論時に一度に引くパターン数
+#define PRED_BLOCK_SIZE 8
+// 推論時のブロック数（最後のブロックは前のブロックと重ねて，重なった分は足さない）
+#define PRED_NB_BLOCK ((FEAT_NUM + PRED_BLOCK_SIZE - 1) / PRED_BLOCK_SIZE)
+#define PRED_LAST_BLOCK_START (FEAT_NUM - PRED_BLOCK_SIZE)
+#define PRED_LAST_BLOCK_SKIP (PRED_BLOCK_SIZE * PRED_NB_BLOCK - FEAT_NUM)
+
+// モデルファイルのセクション
+#define REGR_SECTION_LAYOUT 1
+#define REGR_SECTION_PRED_WEIGHT 2
+
+// モデルファイルに保存する推論用の重みの並び（読み込み時に現在の定義と照合する）
+typedef struct RegrModelLayout
+{
+    uint32_t weightShift;
+    uint32_t stride;
+    uint32_t nbType;
+    // パターンの種類ごとの先頭位置・要素数
+    uint32_t typeOffset[FEAT_TYPE_NUM];
+    uint32_t typeSize[FEAT_TYPE_NUM];
+} RegrModelLayout;
+
+// 各パターンの重みのpredWeight内での先頭位置
+static int32_t FeatWeightOffset[FEAT_NUM];
+
+static int32_t RegrPredScalar(const Regressor *regr, const uint16_t features[FEAT_NUM], uint8 player);
+static int32_t (*RegrPredKernel)(const Regressor *regr, const uint16_t features[FEAT_NUM], uint8 player) = RegrPredScalar;
+
+/**
+ * @brief 整列したメモリを確保する
+ * 
+ * @param size 確保するサイズ（PRED_WEIGHT_ALIGNの倍数）
+ * @return void* 確保したメモリ
+ */
+static void *AlignedAlloc(size_t size)
+{
+#ifdef _WIN32
+    return _aligned_malloc(size, PRED_WEIGHT_ALIGN);
+#else
+    return aligned_alloc(PRED_WEIGHT_ALIGN, size);
+#endif
+}
+
+/**
+ * @brief AlignedAllocで確保したメモリを解放する
+ * 
+ * @param memory 解放するメモリ
+ */
+static void AlignedFree(void *memory)
+{
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    free(memory);
+#endif
+}
+
+/**
+ * @brief 重みを推論用に量子化する
+ * 
+ * @param weight 重み（石差）
+ * @return int16_t 量子化した重み（1/REGR_WEIGHT_SCALE石単位）
+ */
+static int16_t QuantizeWeight(double weight)
+{
+    double scaled = round(weight * REGR_WEIGHT_SCALE);
+    if (scaled > INT16_MAX)
+        return INT16_MAX;
+    if (scaled < INT16_MIN)
+        return INT16_MIN;
+    return (int16_t)scaled;
+}
+
+#ifdef USE_INTRIN
+/**
+ * @brief 推論用の重みでの予測（AVX2で8パターンずつgather）
+ * 
+ * int16の重みを32bit単位でgatherし，下位16bitを符号拡張して足す
+ * （各手番の末尾はパディングしてあるので，最後の要素でも配列外は読まない）
+ * 
+ * @param regr 回帰モデル
+ * @param features パターンのインデックス
+ * @param player 手番
+ * @return int32_t 予測石差（1/REGR_WEIGHT_SCALE石単位）
+ */
+TARGET_AVX2 static int32_t RegrPredAVX2(const Regressor *regr, const uint16_t features[FEAT_NUM], uint8 player)
+{
+    const int *weight = (const int *)(regr->predWeight + player * PRED_WEIGHT_STRIDE);
+    const __m256i lastMask = _mm256_cmpgt_epi32(
+        _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(PRED_LAST_BLOCK_SKIP - 1));
+    __m256i index, value;
+    __m256i sum = _mm256_setzero_si256();
+    __m128i sum4;
+    int i;
+
+    for (i = 0; i < PRED_NB_BLOCK - 1; i++)
+    {
+        index = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(features + i * PRED_BLOCK_SIZE)));
+        index = _mm256_add_epi32(index, _mm256_loadu_si256((const __m256i *)(FeatWeightOffset + i * PRED_BLOCK_SIZE)));
+        value = _mm256_i32gather_epi32(weight, index, 2);
+        sum = _mm256_add_epi32(sum, _mm256_srai_epi32(_mm256_slli_epi32(value, 16), 16));
+    }
+    // 最後のブロック（前のブロックと重なった分はマスクで除く）
+    index = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(features + PRED_LAST_BLOCK_START)));
+    index = _mm256_add_epi32(index, _mm256_loadu_si256((const __m256i *)(FeatWeightOffset + PRED_LAST_BLOCK_START)));
+    value = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), weight, index, lastMask, 2);
+    sum = _mm256_add_epi32(sum, _mm256_srai_epi32(_mm256_slli_epi32(value, 16), 16));
+
+    sum4 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    sum4 = _mm_add_epi32(sum4, _mm_shuffle_epi32(sum4, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum4 = _mm_add_epi32(sum4, _mm_shuffle_epi32(sum4, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum4);
+}
+#endif
+
+/**
+ * @brief 推論用の重みの並びを計算
+ * 
+ * @param layout 出力：推論用の重みの並び
+ */
+static void RegrLayoutInit(RegrModelLayout *layout)
+{
+    memset(layout, 0, sizeof(RegrModelLayout));
+    layout->weightShift = REGR_WEIGHT_SHIFT;
+    layout->stride = PRED_WEIGHT_STRIDE;
+    layout->nbType = FEAT_TYPE_NUM;
+    layout->typeOffset[0] = 0;
+    for (int type = 0; type < FEAT_TYPE_NUM; type++)
+    {
+        if (type > 0)
+        {
+            layout->typeOffset[type] = layout->typeOffset[type - 1] + FTYPE_INDEX_MAX[type - 1];
+        }
+        layout->typeSize[type] = FTYPE_INDEX_MAX[type];
+    }
+}
+
+/**
+ * @brief 推論用の準備（パターンごとの重みの位置・実装の選択）
+ * 
+ * 実装は，BitKernelSelectで選択したビット演算の実装と同じ命令セットの段階に合わせる
+ */
+static void RegrInferenceInit()
+{
+    RegrModelLayout layout;
+
+    RegrLayoutInit(&layout);
+    for (int feat = 0; feat < FEAT_NUM; feat++)
+    {
+        FeatWeightOffset[feat] = (int32_t)layout.typeOffset[FeatID2Type[feat]];
+    }
+#ifdef USE_INTRIN
+    if (BitKernelLevel() >= CPU_LEVEL_AVX2)
+    {
+        RegrPredKernel = RegrPredAVX2;
+    }
+    else
+    {
+        RegrPredKernel = RegrPredScalar;
+    }
+#endif
+}
 
 void InitRegr(Regressor regr[NB_PHASE])
 {
     int phase;
     int feat;
+    const size_t predSize = (size_t)NB_PHASE * 2 * PRED_WEIGHT_STRIDE * sizeof(int16_t);
+    int16_t *predWeight;
+
+    // 推論用の重みは全フェーズ分をまとめて確保（先頭はregr[0].predWeight）
+    predWeight = (int16_t *)AlignedAlloc(predSize);
+    if (predWeight == NULL)
+    {
+        fputs("推論用の重みの確保に失敗しました。\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+    memset(predWeight, 0, predSize);
+
     for (phase = 0; phase < NB_PHASE; phase++)
     {
         for (feat = 0; feat < FEAT_TYPE_NUM; feat++)
@@ -35,13 +225,22 @@ void InitRegr(Regressor regr[NB_PHASE])
             regr[phase].weight[0][feat] = (double *)calloc(FTYPE_INDEX_MAX[feat], sizeof(double));
             regr[phase].weight[1][feat] = (double *)calloc(FTYPE_INDEX_MAX[feat], sizeof(double));
         }
+        regr[phase].predWeight = predWeight + (size_t)phase * 2 * PRED_WEIGHT_STRIDE;
+        regr[phase].model = NULL;
     }
+    RegrInferenceInit();
 }
 
 void DelRegr(Regressor regr[NB_PHASE])
 {
     int phase;
     int feat;
+    if (regr[0].model != NULL)
+    {
+        ModelFileClose(regr[0].model);
+        free(regr[0].model);
+        return;
+    }
     for (phase = 0; phase < NB_PHASE; phase++)
     {
         for (feat = 0; feat < FEAT_TYPE_NUM; feat++)
@@ -50,6 +249,7 @@ void DelRegr(Regressor regr[NB_PHASE])
             free(regr[phase].weight[1][feat]);
         }
     }
+    AlignedFree(regr[0].predWeight);
 }
 
 void RegrCopyWeight(Regressor src[NB_PHASE], Regressor dst[NB_PHASE])
@@ -57,23 +257,49 @@ void RegrCopyWeight(Regressor src[NB_PHASE], Regressor dst[NB_PHASE])
     int phase;
     int feat;
     uint32_t i;
-    for (phase = 0; phase < NB_PHASE; phase++)
+    if (dst[0].model != NULL)
     {
-        for (feat = 0; feat < FEAT_TYPE_NUM; feat++)
+        // 同じモデルファイルをマップしたもの同士ならコピー不要
+        if (src[0].model != NULL && src[0].model->header->checksum == dst[0].model->header->checksum)
         {
-            for (i = 0; i < FTYPE_INDEX_MAX[feat]; i++)
+            return;
+        }
+        // マップしたモデルは書き換えられないので，書き込める重みを確保し直してからコピーする
+        DelRegr(dst);
+        InitRegr(dst);
+    }
+    // マップしたモデルには学習用の重みがないので，推論用の重みだけ写す
+    if (src[0].model == NULL)
+    {
+        for (phase = 0; phase < NB_PHASE; phase++)
+        {
+            for (feat = 0; feat < FEAT_TYPE_NUM; feat++)
             {
-                dst[phase].weight[0][feat][i] = src[phase].weight[0][feat][i];
-                dst[phase].weight[1][feat][i] = src[phase].weight[1][feat][i];
+                for (i = 0; i < FTYPE_INDEX_MAX[feat]; i++)
+                {
+                    dst[phase].weight[0][feat][i] = src[phase].weight[0][feat][i];
+                    dst[phase].weight[1][feat][i] = src[phase].weight[1][feat][i];
+                }
             }
         }
     }
+    for (phase = 0; phase < NB_PHASE; phase++)
+    {
+        memcpy(dst[phase].predWeight, src[phase].predWeight, 2 * PRED_WEIGHT_STRIDE * sizeof(int16_t));
+    }
 }
 
 void RegrClearWeight(Regressor regr[NB_PHASE])
 {
     int phase, feat;
     uint32_t i;
+    if (regr[0].model != NULL)
+    {
+        // マップしたモデルは書き換えられないので，0で初期化した重みを確保し直す
+        DelRegr(regr);
+        InitRegr(regr);
+        return;
+    }
     for (phase = 0; phase < NB_PHASE; phase++)
     {
         for (feat = 0; feat < FEAT_TYPE_NUM; feat++)
@@ -85,17 +311,23 @@ void RegrClearWeight(Regressor regr[NB_PHASE])
             }
         }
     }
+    memset(regr[0].predWeight, 0, (size_t)NB_PHASE * 2 * PRED_WEIGHT_STRIDE * sizeof(int16_t));
 }
 
 void RegrApplyWeightToOpp(Regressor *regr)
 {
     uint8 type;
     uint16_t i;
+    int16_t *pred0 = regr->predWeight;
+    int16_t *pred1 = regr->predWeight + PRED_WEIGHT_STRIDE;
     for (type = 0; type < FEAT_TYPE_NUM; type++)
     {
         for (i = 0; i < FTYPE_INDEX_MAX[type]; i++)
         {
             regr->weight[1][type][i] = regr->weight[0][type][OpponentIndex(i, FTYPE_DIGIT[type])];
+            // 推論用の重みも更新
+            *pred0++ = QuantizeWeight(regr->weight[0][type][i]);
+            *pred1++ = QuantizeWeight(regr->weight[1][type][i]);
         }
     }
 }
@@ -115,6 +347,43 @@ double RegrPred(Regressor *regr, const uint16_t features[FEAT_NUM], uint8 player
     return score;
 }
 
+/**
+ * @brief 推論用の重みでの予測（SIMDなし）
+ * 
+ * @param regr 回帰モデル
+ * @param features パターンのインデックス
+ * @param player 手番
+ * @return int32_t 予測石差（1/REGR_WEIGHT_SCALE石単位）
+ */
+static int32_t RegrPredScalar(const Regressor *regr, const uint16_t features[FEAT_NUM], uint8 player)
+{
+    const int16_t *weight = regr->predWeight + player * PRED_WEIGHT_STRIDE;
+    int32_t sum = 0;
+    int feat;
+
+    for (feat = 0; feat < FEAT_NUM; feat++)
+    {
+        assert(features[feat] < FTYPE_INDEX_MAX[FeatID2Type[feat]]);
+        sum += weight[FeatWeightOffset[feat] + features[feat]];
+    }
+    return sum;
+}
+
+/**
+ * @brief 推論用の重みで最終石差を予測
+ * 
+ * 学習中の重みの変更はRegrApplyWeightToOppで推論用の重みに反映される
+ * 
+ * @param regr 回帰モデル
+ * @param features パターンのインデックス
+ * @param player 手番
+ * @return int32_t 予測石差（1/REGR_WEIGHT_SCALE石単位）
+ */
+int32_t RegrPredFast(const Regressor *regr, const uint16_t features[FEAT_NUM], uint8 player)
+{
+    return RegrPredKernel(regr, features, player);
+}
+
 void RegrSave(Regressor regr[NB_PHASE], const char *file)
 {
     int phase, ftype;
@@ -150,7 +419,7 @@ void RegrSave(Regressor regr[NB_PHASE], const char *file)
     }
 }
 
-void RegrLoad(Regressor regr[NB_PHASE], const char *file)
+bool RegrLoad(Regressor regr[NB_PHASE], const char *file)
 {
     int phase, ftype;
     size_t readed;
@@ -163,7 +432,7 @@ void RegrLoad(Regressor regr[NB_PHASE], const char *file)
         if (fp == NULL)
         {
             fputs("読み込み用モデルファイルオープンに失敗しました。\n", stderr);
-            return;
+            return false;
         }
 
         readed = 0;
@@ -176,13 +445,110 @@ void RegrLoad(Regressor regr[NB_PHASE], const char *file)
         if (readed < TYPE_NB_MAX)
         {
             fputs("モデルファイルの読み込みに失敗しました。\n", stderr);
-            return;
+            fclose(fp);
+            return false;
         }
 
         if (fclose(fp) == EOF)
         {
             fputs("モデルファイルクローズに失敗しました。\n", stderr);
-            return;
+            return false;
         }
     }
+    return true;
+}
+
+/**
+ * @brief 推論用の重みをモデルファイルに保存する
+ * 
+ * 相手手番の重みも計算済みのものを保存するので，読み込み時の変換は不要。
+ * フェーズごとのファイル(phase*)を更新したら，この関数でモデルファイルも作り直すこと。
+ * 
+ * @param regr 回帰モデル
+ * @param file モデルのフォルダ（MODEL_FILE_NAMEで保存する）
+ * @return bool 保存できたか
+ */
+bool RegrSaveModel(Regressor regr[NB_PHASE], const char *file)
+{
+    RegrModelLayout layout;
+    ModelSectionData sections[1 + NB_PHASE];
+    char fileName[100];
+
+    RegrLayoutInit(&layout);
+    sections[0].id = REGR_SECTION_LAYOUT;
+    sections[0].phase = 0;
+    sections[0].data = &layout;
+    sections[0].size = sizeof(layout);
+    for (int phase = 0; phase < NB_PHASE; phase++)
+    {
+        sections[1 + phase].id = REGR_SECTION_PRED_WEIGHT;
+        sections[1 + phase].phase = phase;
+        sections[1 + phase].data = regr[phase].predWeight;
+        sections[1 + phase].size = 2 * PRED_WEIGHT_STRIDE * sizeof(int16_t);
+    }
+
+    sprintf(fileName, "%s%s", file, MODEL_FILE_NAME);
+    if (!ModelFileSave(fileName, MODEL_KIND_REGRESSION, sections, 1 + NB_PHASE))
+    {
+        fputs("モデルファイルへの書き込みに失敗しました。\n", stderr);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief モデルファイルをマップして推論用の重みとして使う
+ * 
+ * 推論用の重みはファイル内を直接指し，学習用の重み（weight）は確保しない（NULL）。
+ * InitRegrの代わりに呼び，失敗したときはInitRegrとRegrLoadで読み込む。
+ * 
+ * @param regr 回帰モデル
+ * @param file モデルのフォルダ（MODEL_FILE_NAMEを読み込む）
+ * @return true マップできた
+ * @return false ファイルがない・形式が違う
+ */
+bool RegrMapModel(Regressor regr[NB_PHASE], const char *file)
+{
+    RegrModelLayout layout;
+    const RegrModelLayout *fileLayout;
+    const int16_t *predWeight[NB_PHASE];
+    ModelFile *model;
+    char fileName[100];
+    bool isValid;
+    int phase;
+
+    model = (ModelFile *)malloc(sizeof(ModelFile));
+    sprintf(fileName, "%s%s", file, MODEL_FILE_NAME);
+    if (model == NULL || !ModelFileOpen(model, fileName, MODEL_KIND_REGRESSION))
+    {
+        free(model);
+        return false;
+    }
+
+    // 重みの並びが現在の定義と同じか
+    RegrLayoutInit(&layout);
+    fileLayout = (const RegrModelLayout *)ModelFileSectionData(model, REGR_SECTION_LAYOUT, 0, sizeof(layout));
+    isValid = fileLayout != NULL && memcmp(fileLayout, &layout, sizeof(layout)) == 0;
+    for (phase = 0; isValid && phase < NB_PHASE; phase++)
+    {
+        predWeight[phase] = (const int16_t *)ModelFileSectionData(model, REGR_SECTION_PRED_WEIGHT, phase,
+                                                                  2 * PRED_WEIGHT_STRIDE * sizeof(int16_t));
+        isValid = predWeight[phase] != NULL;
+    }
+    if (!isValid)
+    {
+        fprintf(stderr, "モデルファイル(%s)の重みの並びが違います。\n", fileName);
+        ModelFileClose(model);
+        free(model);
+        return false;
+    }
+
+    for (phase = 0; phase < NB_PHASE; phase++)
+    {
+        memset(regr[phase].weight, 0, sizeof(regr[phase].weight));
+        regr[phase].predWeight = (int16_t *)predWeight[phase];
+        regr[phase].model = (phase == 0) ? model : NULL;
+    }
+    RegrInferenceInit();
+    return true;
 }
\ No newline at end of file
@@ -2,6 +2,13 @@
 #define REGRESSION_DEFINED
 
 #include "ai_const.h"
+#include "model_file.h"
+
+// 推論用の重みの量子化の倍率（1/REGR_WEIGHT_SCALE石単位のint16で持つ）
+#define REGR_WEIGHT_SHIFT 10
+#define REGR_WEIGHT_SCALE (1 << REGR_WEIGHT_SHIFT)
+// 推論用の重みの，1手番分の要素数（キャッシュライン単位に揃える）
+#define PRED_WEIGHT_STRIDE ((TYPE_NB_MAX + 31) & ~31)
 
 typedef struct Regressor
 {
@@ -9,6 +16,14 @@ typedef struct Regressor
     //float weights[NB_FEAT_COMB];
     // weight[player][feat_index][pattern_pow3-shape]
     double *weight[2][FEAT_TYPE_NUM];
+    // 推論用の重み（weightをint16に量子化して手番・パターンの種類順に並べたもの）
+    // predWeight[player * 手番ごとの要素数 + パターンの種類の先頭位置 + index]
+    // 全フェーズ分が1つの配列に続けて並び，regr[0].predWeightがその先頭
+    // （モデルファイルをマップしたときはファイル内を直接指し，書き換えられない）
+    int16_t *predWeight;
+    // マップしたモデルファイル（regr[0]のみ，ファイルから読み込んだときはNULL）
+    // マップしたときは学習用の重み（weight）は確保しない
+    ModelFile *model;
 #ifdef LEARN_MODE
     uint32_t *nbAppears[FEAT_TYPE_NUM];
     double *delta[FEAT_TYPE_NUM];
@@ -22,8 +37,11 @@ void RegrCopyWeight(Regressor src[NB_PHASE], Regressor dst[NB_PHASE]);
 void RegrClearWeight(Regressor regr[NB_PHASE]);
 void RegrApplyWeightToOpp(Regressor *regr);
 double RegrPred(Regressor *regr, const uint16_t features[], uint8 player);
+int32_t RegrPredFast(const Regressor *regr, const uint16_t features[FEAT_NUM], uint8 player);
 
 void RegrSave(Regressor regr[NB_PHASE], const char *file);
-void RegrLoad(Regressor regr[NB_PHASE], const char *file);
+bool RegrLoad(Regressor regr[NB_PHASE], const char *file);
+bool RegrSaveModel(Regressor regr[NB_PHASE], const char *file);
+bool RegrMapModel(Regressor regr[NB_PHASE], const char *file);
 
 #endif
\ No newline at end of file
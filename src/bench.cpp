@@ -23,6 +23,10 @@ extern "C"
 }
 
 #define BENCH_LOG_DIR "./resources/bench/"
+// 置換表キャッシュファイル（定義すると各局面の探索前に読み込み，ベンチマーク後に保存する）
+//#define HASH_CACHE_FILE "./resources/bench/hash_cache"
+// 置換表キャッシュに保存するデータの最小探索深度
+#define HASH_CACHE_MIN_DEPTH 6
 
 using namespace std;
 
@@ -100,6 +104,10 @@ void Bench1Game(SearchTree tree[2], vector<uint8> moves, int nbPut, ofstream &lo
     BoardReset(board);
     TreeReset(&tree[0]);
     TreeReset(&tree[1]);
+#ifdef HASH_CACHE_FILE
+    TreeLoadHashCache(&tree[0], (HASH_CACHE_FILE + to_string(0)).c_str());
+    TreeLoadHashCache(&tree[1], (HASH_CACHE_FILE + to_string(1)).c_str());
+#endif
 
     for (uint8 move : moves)
     {
@@ -133,21 +141,29 @@ void Bench1Game(SearchTree tree[2], vector<uint8> moves, int nbPut, ofstream &lo
         }
         if (turnTree->option.useHash)
         {
-            logfile << turnTree->nwsTable->nbUsed << ","
+#ifdef HASH_STATS_ENABLED
+            logfile << turnTree->nwsTable->nbProbe << ","
                     << turnTree->nwsTable->nbHit << ","
-                    << turnTree->nwsTable->nb2ndUsed << ","
-                    << turnTree->nwsTable->nb2ndHit << ","
+                    << turnTree->nwsTable->nbUsed << ","
                     << turnTree->nwsTable->nbCollide << ",";
+#else
+            logfile << ",,,,";
+#endif
+            logfile << turnTree->nbEtcProbe << ","
+                    << turnTree->nbEtcCut << ",";
 
-            logfile << turnTree->pvTable->nbUsed << ","
+#ifdef HASH_STATS_ENABLED
+            logfile << turnTree->pvTable->nbProbe << ","
                     << turnTree->pvTable->nbHit << ","
-                    << turnTree->pvTable->nb2ndUsed << ","
-                    << turnTree->pvTable->nb2ndHit << ","
+                    << turnTree->pvTable->nbUsed << ","
                     << turnTree->pvTable->nbCollide << ",";
+#else
+            logfile << ",,,,";
+#endif
         }
         else
         {
-            logfile << ",,,";
+            logfile << ",,,,,,,,,,";
         }
         {
             logfile << turnTree->score / (float)(STONE_VALUE) << ","
@@ -171,7 +187,7 @@ void BenchSearching(vector<unsigned char> depths, bool useHash, bool useMPC, boo
 
     logfile.setf(ios::fixed, ios::floatfield);
     logfile.precision(2);
-    logfile << "探索深度,思考時間,探索ノード数,探索速度,カット数,ハッシュ記録数,ハッシュヒット数,2ndハッシュ記録数,2ndハッシュヒット数,ハッシュ衝突数,pvハッシュ記録数,pvハッシュヒット数,pv2ndハッシュ記録数,pv2ndハッシュヒット数,pvハッシュ衝突数,推定CPUスコア,着手位置\n";
+    logfile << "探索深度,思考時間,探索ノード数,探索速度,カット数,ハッシュ検索数,ハッシュヒット数,ハッシュ記録数,ハッシュ衝突数,ETC試行数,ETCカット数,pvハッシュ検索数,pvハッシュヒット数,pvハッシュ記録数,pvハッシュ衝突数,推定CPUスコア,着手位置\n";
     LoadGameRecords(benchFile.c_str(), records);
 
     TreeInit(&tree[0], false);
@@ -196,6 +212,203 @@ void BenchSearching(vector<unsigned char> depths, bool useHash, bool useMPC, boo
             logfile << "\n";
         }
     }
+#ifdef HASH_CACHE_FILE
+    TreeSaveHashCache(&tree[0], (HASH_CACHE_FILE + to_string(0)).c_str(), HASH_CACHE_MIN_DEPTH);
+    TreeSaveHashCache(&tree[1], (HASH_CACHE_FILE + to_string(1)).c_str(), HASH_CACHE_MIN_DEPTH);
+#endif
+
+    logfile.unsetf(ios::floatfield);
+    logfile.close();
+}
+
+/**
+ * @brief 置換表サイズごとのヒット率を計測する
+ * 
+ * 同じ局面群を置換表サイズだけ変えて探索し，サイズ毎の合計を1行ずつ出力する
+ * ヒット数などの統計はHASH_STATS_ENABLEDを定義したときのみ計測され，定義しないときはその列を空にする
+ * 
+ * @param sizes 計測するNWS置換表のバケット数
+ * @param depth 中盤探索深度
+ * @param benchFile 局面の棋譜ファイル
+ */
+void BenchHashSize(vector<size_t> sizes, unsigned char depth, string benchFile)
+{
+    SearchTree tree[1];
+    Board board[1];
+    vector<vector<uint8>> records;
+    string logFileName;
+
+    cout << "ベンチマーク: ログファイルのファイル名を入力してください\n";
+    cin >> logFileName;
+
+    ofstream logfile(BENCH_LOG_DIR + logFileName + ".csv");
+    logfile.setf(ios::fixed, ios::floatfield);
+    logfile.precision(4);
+    logfile << "バケット数,サイズ[MB],思考時間,探索ノード数,探索速度,ハッシュ検索数,ハッシュヒット数,ヒット率,ハッシュ記録数,ハッシュ衝突数\n";
+    LoadGameRecords(benchFile.c_str(), records);
+
+    TreeInit(tree, false);
+    TreeConfig(tree, depth, depth, 0, true, false, false);
+    for (size_t size : sizes)
+    {
+        double usedTime = 0;
+        uint64_t nodeCount = 0;
+#ifdef HASH_STATS_ENABLED
+        uint64_t nbProbe = 0, nbHit = 0, nbUsed = 0, nbCollide = 0;
+#endif
+
+        if (!HashTableResize(tree->nwsTable, size))
+        {
+            break;
+        }
+        for (vector<uint8> moves : records)
+        {
+            BoardReset(board);
+            for (uint8 move : moves)
+            {
+                BoardPutTT(board, move);
+            }
+            if (BoardGetMobility(board) == 0)
+            {
+                continue;
+            }
+            TreeReset(tree);
+            SearchWithSetup(tree, BoardGetOwn(board), BoardGetOpp(board), 0);
+
+            usedTime += tree->usedTime;
+            nodeCount += tree->nodeCount;
+#ifdef HASH_STATS_ENABLED
+            nbProbe += tree->nwsTable->nbProbe;
+            nbHit += tree->nwsTable->nbHit;
+            nbUsed += tree->nwsTable->nbUsed;
+            nbCollide += tree->nwsTable->nbCollide;
+#endif
+        }
+        logfile << size << ","
+                << size * sizeof(HashBucket) / (double)(1 << 20) << ","
+                << usedTime << ","
+                << nodeCount << ","
+                << nodeCount / usedTime << ",";
+#ifdef HASH_STATS_ENABLED
+        logfile << nbProbe << ","
+                << nbHit << ","
+                << nbHit / (double)nbProbe << ","
+                << nbUsed << ","
+                << nbCollide << "\n";
+        cout << size << " buckets: hit rate " << nbHit / (double)nbProbe << "\n";
+#else
+        logfile << ",,,,\n";
+        cout << size << " buckets: " << usedTime << " sec (HASH_STATS_ENABLED未定義のためヒット率は計測しない)\n";
+#endif
+    }
+    TreeDelete(tree);
+
+    logfile.unsetf(ios::floatfield);
+    logfile.close();
+}
+
+/**
+ * @brief 合法手・反転計算の実装ごとの速度を計測する
+ * 
+ * 棋譜の局面からランダムに終局まで打ち進めた全局面・全合法手について，
+ * 実行中のCPUが対応する命令セットの段階ごとに1回あたりの計算時間を出力する
+ * （SIMDなし：シフト演算，BMI2：PEXT/PDEPと表引き，AVX2・AVX-512：4方向同時）
+ * 
+ * @param nbRepeat 全局面を計算する回数
+ * @param benchFile 局面の棋譜ファイル
+ */
+void BenchBitKernels(int nbRepeat, string benchFile)
+{
+    struct FlipCase
+    {
+        uint64_t own, opp;
+        uint8 pos;
+    };
+    Board board[1];
+    vector<vector<uint8>> records;
+    vector<FlipCase> cases;
+    string logFileName;
+    chrono::system_clock::time_point start;
+    uint64_t refFlipSum = 0, refMobSum = 0;
+
+    cout << "ベンチマーク: ログファイルのファイル名を入力してください\n";
+    cin >> logFileName;
+
+    ofstream logfile(BENCH_LOG_DIR + logFileName + ".csv");
+    logfile.setf(ios::fixed, ios::floatfield);
+    logfile.precision(2);
+    logfile << "実装,反転計算[ns],着手可能位置計算[ns],計算結果\n";
+    LoadGameRecords(benchFile.c_str(), records);
+
+    for (vector<uint8> moves : records)
+    {
+        BoardReset(board);
+        for (uint8 move : moves)
+        {
+            BoardPutTT(board, move);
+        }
+        while (!BoardIsFinished(board))
+        {
+            uint64_t mob = BoardGetMobility(board);
+            if (mob == 0)
+            {
+                BoardSkip(board);
+                continue;
+            }
+            for (; mob != 0; mob &= mob - 1)
+            {
+                cases.push_back({BoardGetOwn(board), BoardGetOpp(board), PosIndexFromBit(mob)});
+            }
+            BoardPutTT(board, BoardGetRandomPosMoveable(board));
+        }
+    }
+
+    for (int level = CPU_LEVEL_SCALAR; level < NB_CPU_LEVEL; level++)
+    {
+        if (!BitKernelSelect((CpuLevel)level))
+        {
+            cout << CpuLevelName((CpuLevel)level) << ": 非対応\n";
+            continue;
+        }
+
+        uint64_t flipSum = 0, mobSum = 0;
+        start = chrono::system_clock::now();
+        for (int i = 0; i < nbRepeat; i++)
+        {
+            for (const FlipCase &c : cases)
+            {
+                flipSum += CalcFlip64(c.own, c.opp, c.pos);
+            }
+        }
+        double flipTime = chrono::duration<double, nano>(chrono::system_clock::now() - start).count();
+
+        start = chrono::system_clock::now();
+        for (int i = 0; i < nbRepeat; i++)
+        {
+            for (const FlipCase &c : cases)
+            {
+                mobSum += CalcMobility64(c.own, c.opp);
+            }
+        }
+        double mobTime = chrono::duration<double, nano>(chrono::system_clock::now() - start).count();
+
+        // 最初の実装(SIMDなし)の計算結果と比較
+        if (level == CPU_LEVEL_SCALAR)
+        {
+            refFlipSum = flipSum;
+            refMobSum = mobSum;
+        }
+        bool isSame = flipSum == refFlipSum && mobSum == refMobSum;
+
+        logfile << CpuLevelName((CpuLevel)level) << ","
+                << flipTime / nbRepeat / cases.size() << ","
+                << mobTime / nbRepeat / cases.size() << ","
+                << (isSame ? "OK" : "NG") << "\n";
+        cout << CpuLevelName((CpuLevel)level) << ": flip " << flipTime / nbRepeat / cases.size()
+             << "[ns] mobility " << mobTime / nbRepeat / cases.size() << "[ns] " << (isSame ? "OK" : "NG") << "\n";
+    }
+    // 自動選択に戻す
+    BitKernelInit();
 
     logfile.unsetf(ios::floatfield);
     logfile.close();
@@ -205,12 +418,16 @@ int main()
 {
     srand(GLOBAL_SEED);
     HashInit();
+    StabilityInit();
+    cout << "ビット演算の実装: " << CpuLevelName(BitKernelLevel()) << "\n";
 
     std::vector<unsigned char> depths = {11, 12, 13};
     //std::vector<unsigned char> depths = {22};
 
     BenchSearching(depths, /*useHash=*/true, /*useMPC=*/false, /*nestMPC=*/false, 4, 8, "./resources/bench/search2.txt");
     //MakeBench(2, 38);
+    //BenchBitKernels(100, "./resources/bench/search2.txt");
+    //BenchHashSize({1 << 10, 1 << 12, 1 << 14, 1 << 16, 1 << 18, 1 << 20}, 12, "./resources/bench/search2.txt");
 
     return 0;
 }
\ No newline at end of file
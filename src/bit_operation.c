@@ -10,6 +10,9 @@
  * ビット演算による高速な合法手・反転計算
  * 組み込み命令関数が利用可能な箇所についてはCPU命令を用いる
  * 
+ * 合法手・反転計算はSIMD命令の段階ごとに実装を持ち，
+ * 起動後に実行中のCPUが対応する実装を関数ポインタに設定する（初回呼び出し時に自動で選択）
+ * 
  */
 
 #ifdef USE_INTRIN
@@ -17,6 +20,7 @@
 #endif
 
 #include "bit_operation.h"
+#include "cpu_feature.h"
 #include <assert.h>
 
 /**
@@ -88,7 +92,8 @@ inline uint8 tzcnt(uint64_t x)
  */
 inline uint8 lzcnt(uint64_t x)
 {
-#ifdef USE_INTRIN
+    // LZCNTに非対応のCPUでは別命令(BSR)として実行されるので，AVX2向けにビルドしたときだけ使う
+#if defined(USE_INTRIN) && defined(__AVX2__)
     return (uint8)_lzcnt_u64(x);
 #else
     x = x | (x >> 1);
@@ -101,8 +106,6 @@ inline uint8 lzcnt(uint64_t x)
 #endif
 }
 
-// AVX2では全方向同時に計算できるので無効化
-#if !defined(__AVX2__) || !defined(USE_INTRIN)
 /**
  * @brief 左側のビットに対する着手可能位置の計算
  * 
@@ -144,18 +147,44 @@ uint64_t CalcMobilityR(uint64_t aly, uint64_t masked_opp, uint64_t empty,
     tmp |= masked_opp & (tmp >> dir);
     return empty & (tmp >> dir);
 }
-#endif
 
 /**
- * @brief 着手可能位置の計算
+ * @brief 着手可能位置の計算（SIMDなし）
  * 
  * @param aly 自分の石情報
  * @param opp 相手の石情報
  * @return uint64_t 着手可能位置ビット列
  */
-inline uint64_t CalcMobility64(const uint64_t aly, const uint64_t opp)
+static uint64_t CalcMobilityScalar(const uint64_t aly, const uint64_t opp)
+{
+    uint64_t empty = ~(aly | opp);
+    // 上下左右の壁をまたがないようにマスクをかける
+    uint64_t mask_rl = opp & 0x7e7e7e7e7e7e7e7e;
+    uint64_t mask_ud = opp & 0x00ffffffffffff00;
+    uint64_t mask_al = opp & 0x007e7e7e7e7e7e00;
+
+    // 8方向に対して着手可能位置を検索
+    uint64_t mobilty = CalcMobilityL(aly, mask_rl, empty, 1);
+    mobilty |= CalcMobilityL(aly, mask_ud, empty, 8);
+    mobilty |= CalcMobilityL(aly, mask_al, empty, 7);
+    mobilty |= CalcMobilityL(aly, mask_al, empty, 9);
+    mobilty |= CalcMobilityR(aly, mask_rl, empty, 1);
+    mobilty |= CalcMobilityR(aly, mask_ud, empty, 8);
+    mobilty |= CalcMobilityR(aly, mask_al, empty, 7);
+    mobilty |= CalcMobilityR(aly, mask_al, empty, 9);
+    return mobilty;
+}
+
+#ifdef USE_INTRIN
+/**
+ * @brief 着手可能位置の計算（AVX2で4方向同時）
+ * 
+ * @param aly 自分の石情報
+ * @param opp 相手の石情報
+ * @return uint64_t 着手可能位置ビット列
+ */
+TARGET_AVX2 static uint64_t CalcMobilityAVX2(const uint64_t aly, const uint64_t opp)
 {
-#if defined(__AVX2__) && defined(USE_INTRIN)
     __m256i PP, mOO, MM, flip_l, flip_r, pre_l, pre_r, shift2;
     __m128i M;
     const __m256i shift1897 = _mm256_set_epi64x(7, 9, 8, 1);
@@ -181,25 +210,8 @@ inline uint64_t CalcMobility64(const uint64_t aly, const uint64_t opp)
     M = _mm_or_si128(_mm256_castsi256_si128(MM), _mm256_extracti128_si256(MM, 1));
     M = _mm_or_si128(M, _mm_unpackhi_epi64(M, M));
     return _mm_cvtsi128_si64(M) & ~(aly | opp); // mask with empties
-#else
-    uint64_t empty = ~(aly | opp);
-    // 上下左右の壁をまたがないようにマスクをかける
-    uint64_t mask_rl = opp & 0x7e7e7e7e7e7e7e7e;
-    uint64_t mask_ud = opp & 0x00ffffffffffff00;
-    uint64_t mask_al = opp & 0x007e7e7e7e7e7e00;
-
-    // 8方向に対して着手可能位置を検索
-    uint64_t mobilty = CalcMobilityL(aly, mask_rl, empty, 1);
-    mobilty |= CalcMobilityL(aly, mask_ud, empty, 8);
-    mobilty |= CalcMobilityL(aly, mask_al, empty, 7);
-    mobilty |= CalcMobilityL(aly, mask_al, empty, 9);
-    mobilty |= CalcMobilityR(aly, mask_rl, empty, 1);
-    mobilty |= CalcMobilityR(aly, mask_ud, empty, 8);
-    mobilty |= CalcMobilityR(aly, mask_al, empty, 7);
-    mobilty |= CalcMobilityR(aly, mask_al, empty, 9);
-    return mobilty;
-#endif
 }
+#endif
 
 /**
  * @brief 石情報から着手可能位置を計算
@@ -271,7 +283,7 @@ uint64_t CalcFlipR(uint64_t aly, uint64_t masked_empty, uint64_t pos,
 */
 
 /**
- * @brief 反転位置を計算
+ * @brief 反転位置を計算（SIMDなし）
  * 
  * 参考 FlipGenerator
  * https://primenumber.hatenadiary.jp/entry/2016/12/26/063226
@@ -281,7 +293,7 @@ uint64_t CalcFlipR(uint64_t aly, uint64_t masked_empty, uint64_t pos,
  * @param pos 着手位置番号
  * @return uint64_t 反転位置bit
  */
-inline uint64_t CalcFlip64(const uint64_t own, const uint64_t opp, const uint8 pos)
+static uint64_t CalcFlipScalar(const uint64_t own, const uint64_t opp, const uint8 pos)
 {
     uint64_t flipped[4];
     uint64_t oppM[4];
@@ -344,6 +356,194 @@ inline uint64_t CalcFlip64(const uint64_t own, const uint64_t opp, const uint8 p
     */
 }
 
+#ifdef USE_INTRIN
+/**
+ * @brief 反転位置を計算（AVX2で4方向同時）
+ * 
+ * CalcFlipScalarの4方向分を1つのレジスタで計算する。
+ * 着手位置より下位側で最も近い相手の石以外のマス（最上位ビット）は，
+ * 列の方向に倍々にビットを広げてから取り出す
+ * 
+ * @param own 自身の石情報
+ * @param opp 相手の石情報
+ * @param pos 着手位置番号
+ * @return uint64_t 反転位置bit
+ */
+TARGET_AVX2 static uint64_t CalcFlipAVX2(const uint64_t own, const uint64_t opp, const uint8 pos)
+{
+    const __m256i PP = _mm256_broadcastq_epi64(_mm_cvtsi64_si128(own));
+    const __m256i OO = _mm256_broadcastq_epi64(_mm_cvtsi64_si128(opp));
+    const __m256i OM = _mm256_and_si256(OO, _mm256_set_epi64x(0x7e7e7e7e7e7e7e7e, 0x7e7e7e7e7e7e7e7e, 0x7e7e7e7e7e7e7e7e, -1));
+    const __m256i shift8179 = _mm256_set_epi64x(9, 7, 1, 8);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i mask, outflank, flip, line;
+    __m128i F;
+
+    // 着手位置より下位ビット側
+    mask = _mm256_srlv_epi64(_mm256_set_epi64x(0x0040201008040201, 0x0102040810204000, 0x7f00000000000000, 0x0080808080808080),
+                             _mm256_set1_epi64x(63 - pos));
+    line = _mm256_andnot_si256(OM, mask);
+    line = _mm256_or_si256(line, _mm256_srlv_epi64(line, shift8179));
+    line = _mm256_or_si256(line, _mm256_srlv_epi64(line, _mm256_slli_epi64(shift8179, 1)));
+    line = _mm256_or_si256(line, _mm256_srlv_epi64(line, _mm256_slli_epi64(shift8179, 2)));
+    line = _mm256_and_si256(line, mask);
+    outflank = _mm256_and_si256(_mm256_andnot_si256(_mm256_srlv_epi64(line, shift8179), line), PP);
+    flip = _mm256_and_si256(_mm256_slli_epi64(_mm256_sub_epi64(zero, outflank), 1), mask);
+
+    // 着手位置より上位ビット側
+    mask = _mm256_sllv_epi64(_mm256_set_epi64x(0x8040201008040200, 0x0002040810204080, 0x00000000000000fe, 0x0101010101010100),
+                             _mm256_set1_epi64x(pos));
+    outflank = _mm256_add_epi64(_mm256_or_si256(OM, _mm256_andnot_si256(mask, _mm256_set1_epi64x(-1))), _mm256_set1_epi64x(1));
+    outflank = _mm256_and_si256(_mm256_and_si256(outflank, mask), PP);
+    outflank = _mm256_andnot_si256(_mm256_cmpeq_epi64(outflank, zero), _mm256_sub_epi64(outflank, _mm256_set1_epi64x(1)));
+    flip = _mm256_or_si256(flip, _mm256_and_si256(outflank, mask));
+
+    F = _mm_or_si128(_mm256_castsi256_si128(flip), _mm256_extracti128_si256(flip, 1));
+    F = _mm_or_si128(F, _mm_unpackhi_epi64(F, F));
+    return _mm_cvtsi128_si64(F);
+}
+
+/**
+ * @brief 反転位置を計算（AVX-512で4方向同時）
+ * 
+ * CalcFlipScalarの4方向分を1つのレジスタで計算する。
+ * 先頭0の数はAVX-512CDの命令で各方向まとめて求める
+ * 
+ * @param own 自身の石情報
+ * @param opp 相手の石情報
+ * @param pos 着手位置番号
+ * @return uint64_t 反転位置bit
+ */
+TARGET_AVX512 static uint64_t CalcFlipAVX512(const uint64_t own, const uint64_t opp, const uint8 pos)
+{
+    const __m256i PP = _mm256_broadcastq_epi64(_mm_cvtsi64_si128(own));
+    const __m256i OO = _mm256_broadcastq_epi64(_mm_cvtsi64_si128(opp));
+    const __m256i OM = _mm256_and_si256(OO, _mm256_set_epi64x(0x7e7e7e7e7e7e7e7e, 0x7e7e7e7e7e7e7e7e, 0x7e7e7e7e7e7e7e7e, -1));
+    __m256i mask, outflank, flip;
+    __m128i F;
+
+    // 着手位置より下位ビット側
+    mask = _mm256_srlv_epi64(_mm256_set_epi64x(0x0040201008040201, 0x0102040810204000, 0x7f00000000000000, 0x0080808080808080),
+                             _mm256_set1_epi64x(63 - pos));
+    outflank = _mm256_srlv_epi64(_mm256_set1_epi64x(0x8000000000000000), _mm256_lzcnt_epi64(_mm256_andnot_si256(OM, mask)));
+    outflank = _mm256_and_si256(outflank, PP);
+    flip = _mm256_and_si256(_mm256_slli_epi64(_mm256_sub_epi64(_mm256_setzero_si256(), outflank), 1), mask);
+
+    // 着手位置より上位ビット側
+    mask = _mm256_sllv_epi64(_mm256_set_epi64x(0x8040201008040200, 0x0002040810204080, 0x00000000000000fe, 0x0101010101010100),
+                             _mm256_set1_epi64x(pos));
+    outflank = _mm256_add_epi64(_mm256_ternarylogic_epi64(OM, mask, mask, 0xf3), _mm256_set1_epi64x(1));
+    outflank = _mm256_and_si256(_mm256_and_si256(outflank, mask), PP);
+    outflank = _mm256_maskz_sub_epi64(_mm256_test_epi64_mask(outflank, outflank), outflank, _mm256_set1_epi64x(1));
+    flip = _mm256_or_si256(flip, _mm256_and_si256(outflank, mask));
+
+    F = _mm_or_si128(_mm256_castsi256_si128(flip), _mm256_extracti128_si256(flip, 1));
+    F = _mm_or_si128(F, _mm_unpackhi_epi64(F, F));
+    return _mm_cvtsi128_si64(F);
+}
+
+// 1列(8bit)のうちx番目に打ったとき，[x][相手の石の配置] = 相手の石が続いた先のマス（挟む石を置けるマス）
+static uint8 PEXT_OUTFLANK[8][256];
+// 1列(8bit)のうちx番目に打ったとき，[x][挟んだ自分の石] = 反転するマス
+static uint8 PEXT_FLIPPED[8][256];
+// [位置番号] = 着手位置を通るヨコ・タテ・ナナメ2本の列（着手位置を含む）
+static uint64_t PEXT_LINE[64][4];
+// [位置番号] = 各列の中での着手位置の番号
+static uint8 PEXT_LINE_INDEX[64][4];
+static bool PextTableInitialized = false;
+
+/**
+ * @brief PEXTを使った反転計算の表を初期化
+ */
+static void PextFlipInit()
+{
+    // ヨコ・タテ・ナナメ(右下がり)・ナナメ(左下がり)の方向
+    const int dx[4] = {1, 0, 1, -1};
+    const int dy[4] = {0, 1, 1, 1};
+    int x, y, pos, dir, i, pattern, run;
+    uint64_t line;
+
+    if (PextTableInitialized)
+        return;
+
+    for (x = 0; x < 8; x++)
+    {
+        for (pattern = 0; pattern < 256; pattern++)
+        {
+            PEXT_OUTFLANK[x][pattern] = 0;
+            // 上位側
+            for (run = x + 1; run < 8 && (pattern & (1 << run)); run++)
+                ;
+            if (run > x + 1 && run < 8)
+                PEXT_OUTFLANK[x][pattern] |= 1 << run;
+            // 下位側
+            for (run = x - 1; run >= 0 && (pattern & (1 << run)); run--)
+                ;
+            if (run < x - 1 && run >= 0)
+                PEXT_OUTFLANK[x][pattern] |= 1 << run;
+
+            PEXT_FLIPPED[x][pattern] = 0;
+            for (i = x + 1; i < 8 && !(pattern & (1 << i)); i++)
+                ;
+            if (i < 8)
+                PEXT_FLIPPED[x][pattern] |= ((1 << i) - 1) & ~((2 << x) - 1);
+            for (i = x - 1; i >= 0 && !(pattern & (1 << i)); i--)
+                ;
+            if (i >= 0)
+                PEXT_FLIPPED[x][pattern] |= ((1 << x) - 1) & ~((2 << i) - 1);
+        }
+    }
+
+    for (pos = 0; pos < 64; pos++)
+    {
+        for (dir = 0; dir < 4; dir++)
+        {
+            // 列の端まで戻ってから，もう一方の端まで列のマスを集める
+            x = pos & 7;
+            y = pos >> 3;
+            while (x - dx[dir] >= 0 && x - dx[dir] < 8 && y - dy[dir] >= 0)
+            {
+                x -= dx[dir];
+                y -= dy[dir];
+            }
+            line = 0;
+            for (; x >= 0 && x < 8 && y < 8; x += dx[dir], y += dy[dir])
+            {
+                line |= (uint64_t)1 << (y * 8 + x);
+            }
+            PEXT_LINE[pos][dir] = line;
+            PEXT_LINE_INDEX[pos][dir] = popcnt(line & (((uint64_t)1 << pos) - 1));
+        }
+    }
+    PextTableInitialized = true;
+}
+
+/**
+ * @brief 反転位置を計算（BMI2）
+ * 
+ * 着手位置を通る4本の列の石をPEXTで8bitに詰めて表を引き，
+ * 反転するマスをPDEPで盤面に戻す
+ * 
+ * @param own 自身の石情報
+ * @param opp 相手の石情報
+ * @param pos 着手位置番号
+ * @return uint64_t 反転位置bit
+ */
+TARGET_BMI2 static uint64_t CalcFlipPEXT(const uint64_t own, const uint64_t opp, const uint8 pos)
+{
+    const uint64_t *line = PEXT_LINE[pos];
+    const uint8 *x = PEXT_LINE_INDEX[pos];
+    uint64_t flip;
+
+    flip = _pdep_u64(PEXT_FLIPPED[x[0]][PEXT_OUTFLANK[x[0]][_pext_u64(opp, line[0])] & _pext_u64(own, line[0])], line[0]);
+    flip |= _pdep_u64(PEXT_FLIPPED[x[1]][PEXT_OUTFLANK[x[1]][_pext_u64(opp, line[1])] & _pext_u64(own, line[1])], line[1]);
+    flip |= _pdep_u64(PEXT_FLIPPED[x[2]][PEXT_OUTFLANK[x[2]][_pext_u64(opp, line[2])] & _pext_u64(own, line[2])], line[2]);
+    flip |= _pdep_u64(PEXT_FLIPPED[x[3]][PEXT_OUTFLANK[x[3]][_pext_u64(opp, line[3])] & _pext_u64(own, line[3])], line[3]);
+
+    return flip;
+}
+#endif
+
 /**
  * @brief 石情報と着手位置から反転位置を計算
  * 
@@ -356,6 +556,570 @@ uint64_t CalcFlip(const Stones *stones, const uint8 pos)
     return CalcFlip64(stones->own, stones->opp, pos);
 }
 
+/**
+ * @brief 着手可能位置を着手位置のビット・位置番号の配列に展開
+ * 
+ * @param mob 着手可能位置
+ * @param width 同時に反転位置を計算する着手数（端数は着手位置なしで埋める）
+ * @param posBits 出力：着手位置のビットの配列
+ * @param posIdx 出力：着手位置番号の配列
+ * @return int 着手数
+ */
+static inline int ExpandMoves(uint64_t mob, const int width, uint64_t posBits[MAX_MOVES], uint8 posIdx[MAX_MOVES])
+{
+    int nbMoves = 0;
+    int i;
+
+    for (; mob != 0; mob &= mob - 1)
+    {
+        posBits[nbMoves] = GetLSB(mob);
+        posIdx[nbMoves] = tzcnt(mob);
+        nbMoves++;
+    }
+    assert(nbMoves <= MAX_MOVES);
+    // SIMD幅の端数は着手位置なし（反転位置も0になる）
+    for (i = nbMoves; i % width != 0; i++)
+    {
+        posBits[i] = 0;
+    }
+    return nbMoves;
+}
+
+/**
+ * @brief すべての合法手の着手位置・反転位置を計算（SIMDなし，1手ずつ）
+ * 
+ * @param own 自分の石
+ * @param opp 相手の石
+ * @param posIdx 出力：着手位置番号の配列
+ * @param flips 出力：posIdxと同じ順の反転位置の配列
+ * @return uint64_t 着手可能位置
+ */
+static uint64_t CalcFlipBatchScalar(const uint64_t own, const uint64_t opp, uint8 posIdx[MAX_MOVES], uint64_t flips[MAX_MOVES])
+{
+    const uint64_t mob = CalcMobilityScalar(own, opp);
+    int i = 0;
+    uint64_t bits;
+
+    for (bits = mob; bits != 0; bits &= bits - 1, i++)
+    {
+        posIdx[i] = tzcnt(bits);
+        flips[i] = CalcFlipScalar(own, opp, posIdx[i]);
+    }
+    return mob;
+}
+
+#ifdef USE_INTRIN
+/**
+ * @brief すべての合法手の着手位置・反転位置を計算（BMI2，1手ずつ）
+ * 
+ * @param own 自分の石
+ * @param opp 相手の石
+ * @param posIdx 出力：着手位置番号の配列
+ * @param flips 出力：posIdxと同じ順の反転位置の配列
+ * @return uint64_t 着手可能位置
+ */
+TARGET_BMI2 static uint64_t CalcFlipBatchBMI2(const uint64_t own, const uint64_t opp, uint8 posIdx[MAX_MOVES], uint64_t flips[MAX_MOVES])
+{
+    const uint64_t mob = CalcMobilityScalar(own, opp);
+    int i = 0;
+    uint64_t bits;
+
+    for (bits = mob; bits != 0; bits &= bits - 1, i++)
+    {
+        posIdx[i] = tzcnt(bits);
+        flips[i] = CalcFlipPEXT(own, opp, posIdx[i]);
+    }
+    return mob;
+}
+
+/**
+ * @brief 4つの着手位置について，1方向の反転位置をまとめて計算
+ * 
+ * 着手位置から相手の石が続く範囲を広げていき（Kogge-Stoneの塗りつぶし），
+ * その先に自分の石があれば範囲内の相手の石を反転位置とする
+ * 
+ * @param P 自分の石（全要素同じ）
+ * @param pro 盤端をまたがないようにマスクした相手の石（全要素同じ）
+ * @param pos 着手位置（要素ごとに1つ）
+ * @param shift 方向のシフト量
+ * @param isLeft 上位ビット方向か
+ * @return __m256i 反転位置
+ */
+TARGET_AVX2 static inline __m256i FlipBatchDirAVX2(const __m256i P, __m256i pro, const __m256i pos, const int shift, const bool isLeft)
+{
+    __m128i s1 = _mm_cvtsi32_si128(shift);
+    __m128i s2 = _mm_cvtsi32_si128(shift * 2);
+    __m128i s4 = _mm_cvtsi32_si128(shift * 4);
+    __m256i gen = pos;
+    __m256i outflank, isNotFlipped;
+
+    if (isLeft)
+    {
+        gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_sll_epi64(gen, s1)));
+        pro = _mm256_and_si256(pro, _mm256_sll_epi64(pro, s1));
+        gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_sll_epi64(gen, s2)));
+        pro = _mm256_and_si256(pro, _mm256_sll_epi64(pro, s2));
+        gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_sll_epi64(gen, s4)));
+        outflank = _mm256_and_si256(P, _mm256_sll_epi64(gen, s1));
+    }
+    else
+    {
+        gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_srl_epi64(gen, s1)));
+        pro = _mm256_and_si256(pro, _mm256_srl_epi64(pro, s1));
+        gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_srl_epi64(gen, s2)));
+        pro = _mm256_and_si256(pro, _mm256_srl_epi64(pro, s2));
+        gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_srl_epi64(gen, s4)));
+        outflank = _mm256_and_si256(P, _mm256_srl_epi64(gen, s1));
+    }
+    isNotFlipped = _mm256_cmpeq_epi64(outflank, _mm256_setzero_si256());
+    return _mm256_andnot_si256(isNotFlipped, _mm256_xor_si256(gen, pos));
+}
+
+/**
+ * @brief すべての合法手の着手位置・反転位置を計算（AVX2で4手ずつ）
+ * 
+ * @param own 自分の石
+ * @param opp 相手の石
+ * @param posIdx 出力：着手位置番号の配列
+ * @param flips 出力：posIdxと同じ順の反転位置の配列
+ * @return uint64_t 着手可能位置
+ */
+TARGET_AVX2 static uint64_t CalcFlipBatchAVX2(const uint64_t own, const uint64_t opp, uint8 posIdx[MAX_MOVES], uint64_t flips[MAX_MOVES])
+{
+    const uint64_t mob = CalcMobilityAVX2(own, opp);
+    const __m256i P = _mm256_set1_epi64x((long long)own);
+    const __m256i O = _mm256_set1_epi64x((long long)opp);
+    const __m256i OM = _mm256_and_si256(O, _mm256_set1_epi64x(0x7e7e7e7e7e7e7e7eLL));
+    uint64_t posBits[MAX_MOVES];
+    const int nbMoves = ExpandMoves(mob, 4, posBits, posIdx);
+    __m256i pos, flip;
+    int i;
+
+    for (i = 0; i < nbMoves; i += 4)
+    {
+        pos = _mm256_loadu_si256((const __m256i *)(posBits + i));
+        flip = FlipBatchDirAVX2(P, OM, pos, 1, true);
+        flip = _mm256_or_si256(flip, FlipBatchDirAVX2(P, OM, pos, 1, false));
+        flip = _mm256_or_si256(flip, FlipBatchDirAVX2(P, O, pos, 8, true));
+        flip = _mm256_or_si256(flip, FlipBatchDirAVX2(P, O, pos, 8, false));
+        flip = _mm256_or_si256(flip, FlipBatchDirAVX2(P, OM, pos, 7, true));
+        flip = _mm256_or_si256(flip, FlipBatchDirAVX2(P, OM, pos, 7, false));
+        flip = _mm256_or_si256(flip, FlipBatchDirAVX2(P, OM, pos, 9, true));
+        flip = _mm256_or_si256(flip, FlipBatchDirAVX2(P, OM, pos, 9, false));
+        _mm256_storeu_si256((__m256i *)(flips + i), flip);
+    }
+    return mob;
+}
+
+/**
+ * @brief 8つの着手位置について，1方向の反転位置をまとめて計算
+ * 
+ * FlipBatchDirAVX2の8手版
+ * 
+ * @param P 自分の石（全要素同じ）
+ * @param pro 盤端をまたがないようにマスクした相手の石（全要素同じ）
+ * @param pos 着手位置（要素ごとに1つ）
+ * @param shift 方向のシフト量
+ * @param isLeft 上位ビット方向か
+ * @return __m512i 反転位置
+ */
+TARGET_AVX512 static inline __m512i FlipBatchDirAVX512(const __m512i P, __m512i pro, const __m512i pos, const int shift, const bool isLeft)
+{
+    __m128i s1 = _mm_cvtsi32_si128(shift);
+    __m128i s2 = _mm_cvtsi32_si128(shift * 2);
+    __m128i s4 = _mm_cvtsi32_si128(shift * 4);
+    __m512i gen = pos;
+    __m512i outflank;
+    __mmask8 isFlipped;
+
+    if (isLeft)
+    {
+        gen = _mm512_or_si512(gen, _mm512_and_si512(pro, _mm512_sll_epi64(gen, s1)));
+        pro = _mm512_and_si512(pro, _mm512_sll_epi64(pro, s1));
+        gen = _mm512_or_si512(gen, _mm512_and_si512(pro, _mm512_sll_epi64(gen, s2)));
+        pro = _mm512_and_si512(pro, _mm512_sll_epi64(pro, s2));
+        gen = _mm512_or_si512(gen, _mm512_and_si512(pro, _mm512_sll_epi64(gen, s4)));
+        outflank = _mm512_and_si512(P, _mm512_sll_epi64(gen, s1));
+    }
+    else
+    {
+        gen = _mm512_or_si512(gen, _mm512_and_si512(pro, _mm512_srl_epi64(gen, s1)));
+        pro = _mm512_and_si512(pro, _mm512_srl_epi64(pro, s1));
+        gen = _mm512_or_si512(gen, _mm512_and_si512(pro, _mm512_srl_epi64(gen, s2)));
+        pro = _mm512_and_si512(pro, _mm512_srl_epi64(pro, s2));
+        gen = _mm512_or_si512(gen, _mm512_and_si512(pro, _mm512_srl_epi64(gen, s4)));
+        outflank = _mm512_and_si512(P, _mm512_srl_epi64(gen, s1));
+    }
+    isFlipped = _mm512_test_epi64_mask(outflank, outflank);
+    return _mm512_maskz_xor_epi64(isFlipped, gen, pos);
+}
+
+/**
+ * @brief すべての合法手の着手位置・反転位置を計算（AVX-512で8手ずつ）
+ * 
+ * @param own 自分の石
+ * @param opp 相手の石
+ * @param posIdx 出力：着手位置番号の配列
+ * @param flips 出力：posIdxと同じ順の反転位置の配列
+ * @return uint64_t 着手可能位置
+ */
+TARGET_AVX512 static uint64_t CalcFlipBatchAVX512(const uint64_t own, const uint64_t opp, uint8 posIdx[MAX_MOVES], uint64_t flips[MAX_MOVES])
+{
+    const uint64_t mob = CalcMobilityAVX2(own, opp);
+    const __m512i P = _mm512_set1_epi64((long long)own);
+    const __m512i O = _mm512_set1_epi64((long long)opp);
+    const __m512i OM = _mm512_and_si512(O, _mm512_set1_epi64(0x7e7e7e7e7e7e7e7eLL));
+    uint64_t posBits[MAX_MOVES];
+    const int nbMoves = ExpandMoves(mob, 8, posBits, posIdx);
+    __m512i pos, flip;
+    int i;
+
+    for (i = 0; i < nbMoves; i += 8)
+    {
+        pos = _mm512_loadu_si512((const void *)(posBits + i));
+        flip = FlipBatchDirAVX512(P, OM, pos, 1, true);
+        flip = _mm512_or_si512(flip, FlipBatchDirAVX512(P, OM, pos, 1, false));
+        flip = _mm512_or_si512(flip, FlipBatchDirAVX512(P, O, pos, 8, true));
+        flip = _mm512_or_si512(flip, FlipBatchDirAVX512(P, O, pos, 8, false));
+        flip = _mm512_or_si512(flip, FlipBatchDirAVX512(P, OM, pos, 7, true));
+        flip = _mm512_or_si512(flip, FlipBatchDirAVX512(P, OM, pos, 7, false));
+        flip = _mm512_or_si512(flip, FlipBatchDirAVX512(P, OM, pos, 9, true));
+        flip = _mm512_or_si512(flip, FlipBatchDirAVX512(P, OM, pos, 9, false));
+        _mm512_storeu_si512((void *)(flips + i), flip);
+    }
+    return mob;
+}
+#endif
+
+// 1列8マスのうちx番目に打ったときの反転数（インデックスは列上の自分の石の配置，他のマスは相手の石）
+static const uint8 COUNT_FLIP[8][256] = {
+    {
+        0, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 3, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0,
+        4, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 3, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0,
+        5, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 3, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0,
+        4, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 3, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0,
+        6, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 3, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0,
+        4, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 3, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0,
+        5, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 3, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0,
+        4, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 3, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0
+    },
+    {
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 2, 2, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0,
+        3, 3, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 2, 2, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0,
+        4, 4, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 2, 2, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0,
+        3, 3, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 2, 2, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0,
+        5, 5, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 2, 2, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0,
+        3, 3, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 2, 2, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0,
+        4, 4, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 2, 2, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0,
+        3, 3, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 2, 2, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0
+    },
+    {
+        0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 2, 1, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0,
+        2, 3, 2, 2, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 2, 1, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0,
+        3, 4, 3, 3, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 2, 1, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0,
+        2, 3, 2, 2, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 2, 1, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0,
+        4, 5, 4, 4, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 2, 1, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0,
+        2, 3, 2, 2, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 2, 1, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0,
+        3, 4, 3, 3, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 2, 1, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0,
+        2, 3, 2, 2, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 2, 1, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0
+    },
+    {
+        0, 2, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 3, 2, 2, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        2, 4, 3, 3, 2, 2, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 3, 2, 2, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        3, 5, 4, 4, 3, 3, 3, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 3, 2, 2, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        2, 4, 3, 3, 2, 2, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 3, 2, 2, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+    },
+    {
+        0, 3, 2, 2, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 3, 2, 2, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 4, 3, 3, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 3, 2, 2, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        2, 5, 4, 4, 3, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 3, 2, 2, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 4, 3, 3, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 3, 2, 2, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+    },
+    {
+        0, 4, 3, 3, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 4, 3, 3, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 5, 4, 4, 3, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 4, 3, 3, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+    },
+    {
+        0, 5, 4, 4, 3, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 5, 4, 4, 3, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+    },
+    {
+        0, 6, 5, 5, 4, 4, 4, 4, 3, 3, 3, 3, 3, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+    }
+};
+
+// 各マスを通るタテ・ナナメ・逆ナナメの列（自マスを除く，4番目はAVX2でのロード用の0）
+static const uint64_t LINE_MASK[64][4] = {
+    {0x0101010101010100ULL, 0x8040201008040200ULL, 0x0000000000000000ULL, 0},
+    {0x0202020202020200ULL, 0x0080402010080400ULL, 0x0000000000000100ULL, 0},
+    {0x0404040404040400ULL, 0x0000804020100800ULL, 0x0000000000010200ULL, 0},
+    {0x0808080808080800ULL, 0x0000008040201000ULL, 0x0000000001020400ULL, 0},
+    {0x1010101010101000ULL, 0x0000000080402000ULL, 0x0000000102040800ULL, 0},
+    {0x2020202020202000ULL, 0x0000000000804000ULL, 0x0000010204081000ULL, 0},
+    {0x4040404040404000ULL, 0x0000000000008000ULL, 0x0001020408102000ULL, 0},
+    {0x8080808080808000ULL, 0x0000000000000000ULL, 0x0102040810204000ULL, 0},
+    {0x0101010101010001ULL, 0x4020100804020000ULL, 0x0000000000000002ULL, 0},
+    {0x0202020202020002ULL, 0x8040201008040001ULL, 0x0000000000010004ULL, 0},
+    {0x0404040404040004ULL, 0x0080402010080002ULL, 0x0000000001020008ULL, 0},
+    {0x0808080808080008ULL, 0x0000804020100004ULL, 0x0000000102040010ULL, 0},
+    {0x1010101010100010ULL, 0x0000008040200008ULL, 0x0000010204080020ULL, 0},
+    {0x2020202020200020ULL, 0x0000000080400010ULL, 0x0001020408100040ULL, 0},
+    {0x4040404040400040ULL, 0x0000000000800020ULL, 0x0102040810200080ULL, 0},
+    {0x8080808080800080ULL, 0x0000000000000040ULL, 0x0204081020400000ULL, 0},
+    {0x0101010101000101ULL, 0x2010080402000000ULL, 0x0000000000000204ULL, 0},
+    {0x0202020202000202ULL, 0x4020100804000100ULL, 0x0000000001000408ULL, 0},
+    {0x0404040404000404ULL, 0x8040201008000201ULL, 0x0000000102000810ULL, 0},
+    {0x0808080808000808ULL, 0x0080402010000402ULL, 0x0000010204001020ULL, 0},
+    {0x1010101010001010ULL, 0x0000804020000804ULL, 0x0001020408002040ULL, 0},
+    {0x2020202020002020ULL, 0x0000008040001008ULL, 0x0102040810004080ULL, 0},
+    {0x4040404040004040ULL, 0x0000000080002010ULL, 0x0204081020008000ULL, 0},
+    {0x8080808080008080ULL, 0x0000000000004020ULL, 0x0408102040000000ULL, 0},
+    {0x0101010100010101ULL, 0x1008040200000000ULL, 0x0000000000020408ULL, 0},
+    {0x0202020200020202ULL, 0x2010080400010000ULL, 0x0000000100040810ULL, 0},
+    {0x0404040400040404ULL, 0x4020100800020100ULL, 0x0000010200081020ULL, 0},
+    {0x0808080800080808ULL, 0x8040201000040201ULL, 0x0001020400102040ULL, 0},
+    {0x1010101000101010ULL, 0x0080402000080402ULL, 0x0102040800204080ULL, 0},
+    {0x2020202000202020ULL, 0x0000804000100804ULL, 0x0204081000408000ULL, 0},
+    {0x4040404000404040ULL, 0x0000008000201008ULL, 0x0408102000800000ULL, 0},
+    {0x8080808000808080ULL, 0x0000000000402010ULL, 0x0810204000000000ULL, 0},
+    {0x0101010001010101ULL, 0x0804020000000000ULL, 0x0000000002040810ULL, 0},
+    {0x0202020002020202ULL, 0x1008040001000000ULL, 0x0000010004081020ULL, 0},
+    {0x0404040004040404ULL, 0x2010080002010000ULL, 0x0001020008102040ULL, 0},
+    {0x0808080008080808ULL, 0x4020100004020100ULL, 0x0102040010204080ULL, 0},
+    {0x1010100010101010ULL, 0x8040200008040201ULL, 0x0204080020408000ULL, 0},
+    {0x2020200020202020ULL, 0x0080400010080402ULL, 0x0408100040800000ULL, 0},
+    {0x4040400040404040ULL, 0x0000800020100804ULL, 0x0810200080000000ULL, 0},
+    {0x8080800080808080ULL, 0x0000000040201008ULL, 0x1020400000000000ULL, 0},
+    {0x0101000101010101ULL, 0x0402000000000000ULL, 0x0000000204081020ULL, 0},
+    {0x0202000202020202ULL, 0x0804000100000000ULL, 0x0001000408102040ULL, 0},
+    {0x0404000404040404ULL, 0x1008000201000000ULL, 0x0102000810204080ULL, 0},
+    {0x0808000808080808ULL, 0x2010000402010000ULL, 0x0204001020408000ULL, 0},
+    {0x1010001010101010ULL, 0x4020000804020100ULL, 0x0408002040800000ULL, 0},
+    {0x2020002020202020ULL, 0x8040001008040201ULL, 0x0810004080000000ULL, 0},
+    {0x4040004040404040ULL, 0x0080002010080402ULL, 0x1020008000000000ULL, 0},
+    {0x8080008080808080ULL, 0x0000004020100804ULL, 0x2040000000000000ULL, 0},
+    {0x0100010101010101ULL, 0x0200000000000000ULL, 0x0000020408102040ULL, 0},
+    {0x0200020202020202ULL, 0x0400010000000000ULL, 0x0100040810204080ULL, 0},
+    {0x0400040404040404ULL, 0x0800020100000000ULL, 0x0200081020408000ULL, 0},
+    {0x0800080808080808ULL, 0x1000040201000000ULL, 0x0400102040800000ULL, 0},
+    {0x1000101010101010ULL, 0x2000080402010000ULL, 0x0800204080000000ULL, 0},
+    {0x2000202020202020ULL, 0x4000100804020100ULL, 0x1000408000000000ULL, 0},
+    {0x4000404040404040ULL, 0x8000201008040201ULL, 0x2000800000000000ULL, 0},
+    {0x8000808080808080ULL, 0x0000402010080402ULL, 0x4000000000000000ULL, 0},
+    {0x0001010101010101ULL, 0x0000000000000000ULL, 0x0002040810204080ULL, 0},
+    {0x0002020202020202ULL, 0x0001000000000000ULL, 0x0004081020408000ULL, 0},
+    {0x0004040404040404ULL, 0x0002010000000000ULL, 0x0008102040800000ULL, 0},
+    {0x0008080808080808ULL, 0x0004020100000000ULL, 0x0010204080000000ULL, 0},
+    {0x0010101010101010ULL, 0x0008040201000000ULL, 0x0020408000000000ULL, 0},
+    {0x0020202020202020ULL, 0x0010080402010000ULL, 0x0040800000000000ULL, 0},
+    {0x0040404040404040ULL, 0x0020100804020100ULL, 0x0080000000000000ULL, 0},
+    {0x0080808080808080ULL, 0x0040201008040201ULL, 0x0000000000000000ULL, 0}
+};
+
+/**
+ * @brief 最後の空きマスに打ったときの反転数を計算（SIMDなし）
+ * 
+ * 盤面が着手位置以外すべて埋まっている（自分の石以外はすべて相手の石）ことを利用して，
+ * 着手位置を通る4本の列の自分の石の配置から，表引きで反転数だけを求める。
+ * 
+ * @param own 着手する側の石情報
+ * @param pos 最後の空きマスの位置番号
+ * @return uint8 反転数
+ */
+static uint8 CountFlipLastScalar(const uint64_t own, const uint8 pos)
+{
+    const uint8 x = pos & 7;
+    const uint8 y = pos >> 3;
+    uint8 nbFlips;
+
+    // タテは行番号，ナナメは列番号のビット列に乗算で集める
+    nbFlips = COUNT_FLIP[y][(((own & LINE_MASK[pos][0]) >> x) * 0x0102040810204080ULL) >> 56];
+    nbFlips += COUNT_FLIP[x][((own & LINE_MASK[pos][1]) * 0x0101010101010101ULL) >> 56];
+    nbFlips += COUNT_FLIP[x][((own & LINE_MASK[pos][2]) * 0x0101010101010101ULL) >> 56];
+    // ヨコ
+    nbFlips += COUNT_FLIP[x][(own >> (y * 8)) & 0xff];
+
+    return nbFlips;
+}
+
+#ifdef USE_INTRIN
+/**
+ * @brief 最後の空きマスに打ったときの反転数を計算（AVX2）
+ * 
+ * @param own 着手する側の石情報
+ * @param pos 最後の空きマスの位置番号
+ * @return uint8 反転数
+ */
+TARGET_AVX2 static uint8 CountFlipLastAVX2(const uint64_t own, const uint8 pos)
+{
+    const uint8 x = pos & 7;
+    const uint8 y = pos >> 3;
+    uint8 nbFlips;
+
+    // タテ・ナナメの列は1行に1マスなので，各バイトの非0判定で行番号のビット列になる
+    const __m256i PP = _mm256_broadcastq_epi64(_mm_cvtsi64_si128(own));
+    const __m256i lines = _mm256_and_si256(PP, _mm256_loadu_si256((const __m256i *)LINE_MASK[pos]));
+    const uint32_t rows = (uint32_t)_mm256_movemask_epi8(_mm256_sub_epi8(_mm256_setzero_si256(), lines));
+
+    nbFlips = COUNT_FLIP[y][rows & 0xff];
+    nbFlips += COUNT_FLIP[y][(rows >> 8) & 0xff];
+    nbFlips += COUNT_FLIP[y][(rows >> 16) & 0xff];
+    // ヨコ
+    nbFlips += COUNT_FLIP[x][(own >> (y * 8)) & 0xff];
+
+    return nbFlips;
+}
+#endif
+
+static uint64_t CalcMobility64Resolve(const uint64_t aly, const uint64_t opp);
+static uint64_t CalcFlip64Resolve(const uint64_t own, const uint64_t opp, const uint8 pos);
+static uint8 CountFlipLastResolve(const uint64_t own, const uint8 pos);
+static uint64_t CalcFlipBatchResolve(const uint64_t own, const uint64_t opp, uint8 posIdx[MAX_MOVES], uint64_t flips[MAX_MOVES]);
+
+// 選択中の実装（初回呼び出し時にCPUに合わせて設定される）
+uint64_t (*CalcMobility64)(const uint64_t aly, const uint64_t opp) = CalcMobility64Resolve;
+uint64_t (*CalcFlip64)(const uint64_t own, const uint64_t opp, const uint8 pos) = CalcFlip64Resolve;
+uint8 (*CountFlipLast)(const uint64_t own, const uint8 pos) = CountFlipLastResolve;
+uint64_t (*CalcFlipBatch)(const uint64_t own, const uint64_t opp, uint8 posIdx[MAX_MOVES], uint64_t flips[MAX_MOVES]) = CalcFlipBatchResolve;
+static CpuLevel BitKernelCurrentLevel = CPU_LEVEL_SCALAR;
+
+/**
+ * @brief 合法手・反転計算の実装を指定の命令セットのものに切り替える
+ * 
+ * ベンチマークや検証用。実行中のCPUが対応していない段階は選べない。
+ * 探索中に呼び出さないこと
+ * 
+ * @param level 命令セットの段階
+ * @return bool 切り替えたか
+ */
+bool BitKernelSelect(CpuLevel level)
+{
+#ifdef USE_INTRIN
+    if (level >= NB_CPU_LEVEL || level > CpuDetectLevel())
+        return false;
+#else
+    // 組み込み命令を使わないビルドではSIMDなしのみ
+    if (level != CPU_LEVEL_SCALAR)
+        return false;
+#endif
+
+    switch (level)
+    {
+#ifdef USE_INTRIN
+    case CPU_LEVEL_AVX512:
+        CalcMobility64 = CalcMobilityAVX2;
+        CalcFlip64 = CalcFlipAVX512;
+        CountFlipLast = CountFlipLastAVX2;
+        CalcFlipBatch = CalcFlipBatchAVX512;
+        break;
+    case CPU_LEVEL_AVX2:
+        CalcMobility64 = CalcMobilityAVX2;
+        CalcFlip64 = CalcFlipAVX2;
+        CountFlipLast = CountFlipLastAVX2;
+        CalcFlipBatch = CalcFlipBatchAVX2;
+        break;
+    case CPU_LEVEL_BMI2:
+        PextFlipInit();
+        CalcMobility64 = CalcMobilityScalar;
+        CalcFlip64 = CalcFlipPEXT;
+        CountFlipLast = CountFlipLastScalar;
+        CalcFlipBatch = CalcFlipBatchBMI2;
+        break;
+#endif
+    default:
+        CalcMobility64 = CalcMobilityScalar;
+        CalcFlip64 = CalcFlipScalar;
+        CountFlipLast = CountFlipLastScalar;
+        CalcFlipBatch = CalcFlipBatchScalar;
+        break;
+    }
+    BitKernelCurrentLevel = level;
+    return true;
+}
+
+/**
+ * @brief 実行中のCPUで使える最も高速な実装を選択する
+ * 
+ * 各関数の初回呼び出し時に自動で呼ばれる（複数スレッドから同時に呼ばれても同じ結果を書き込むだけ）
+ * AVX2以上ではSIMDの反転計算の方がPEXTより速い（BenchBitKernelsで計測）ので，
+ * PEXTはAVXが使えない環境でのみ使う
+ */
+void BitKernelInit()
+{
+#ifdef USE_INTRIN
+    CpuLevel level = CpuDetectLevel();
+    if (level == CPU_LEVEL_BMI2 && !CpuHasFastPEXT())
+        level = CPU_LEVEL_SCALAR;
+    BitKernelSelect(level);
+#else
+    BitKernelSelect(CPU_LEVEL_SCALAR);
+#endif
+}
+
+/**
+ * @brief 選択中の実装の命令セットの段階
+ * 
+ * @return CpuLevel 命令セットの段階
+ */
+CpuLevel BitKernelLevel()
+{
+    if (CalcMobility64 == CalcMobility64Resolve)
+        BitKernelInit();
+    return BitKernelCurrentLevel;
+}
+
+// 以下は関数ポインタの初期値：実装を選択してから呼び出し直す
+static uint64_t CalcMobility64Resolve(const uint64_t aly, const uint64_t opp)
+{
+    BitKernelInit();
+    return CalcMobility64(aly, opp);
+}
+
+static uint64_t CalcFlip64Resolve(const uint64_t own, const uint64_t opp, const uint8 pos)
+{
+    BitKernelInit();
+    return CalcFlip64(own, opp, pos);
+}
+
+static uint8 CountFlipLastResolve(const uint64_t own, const uint8 pos)
+{
+    BitKernelInit();
+    return CountFlipLast(own, pos);
+}
+
+static uint64_t CalcFlipBatchResolve(const uint64_t own, const uint64_t opp, uint8 posIdx[MAX_MOVES], uint64_t flips[MAX_MOVES])
+{
+    BitKernelInit();
+    return CalcFlipBatch(own, opp, posIdx, flips);
+}
+
 /**
  * @brief 立っているビット数を数える
  * 
@@ -5,14 +5,22 @@
 #include <stdint.h>
 #include "stones.h"
 #include "const.h"
+#include "cpu_feature.h"
 
 #define MIN(a, b) (((a) < (b)) ? (a) : (b))
 #define MAX(a, b) (((a) > (b)) ? (a) : (b))
 
-inline uint64_t CalcMobility64(const uint64_t aly, const uint64_t opp);
-uint64_t CalcMobility(const Stones *stones);
+// 合法手・反転計算（実行中のCPUに合わせて選択した実装を呼び出す）
+extern uint64_t (*CalcMobility64)(const uint64_t aly, const uint64_t opp);
+extern uint64_t (*CalcFlip64)(const uint64_t own, const uint64_t opp, const uint8 pos);
+extern uint8 (*CountFlipLast)(const uint64_t own, const uint8 pos);
+extern uint64_t (*CalcFlipBatch)(const uint64_t own, const uint64_t opp, uint8 posIdx[MAX_MOVES], uint64_t flips[MAX_MOVES]);
+
+void BitKernelInit();
+bool BitKernelSelect(CpuLevel level);
+CpuLevel BitKernelLevel();
 
-inline uint64_t CalcFlip64(const uint64_t own, const uint64_t opp, const uint8 pos);
+uint64_t CalcMobility(const Stones *stones);
 uint64_t CalcFlip(const Stones *stones, const uint8 pos);
 
 uint8 CountBits(uint64_t stone);
@@ -29,6 +37,33 @@ inline unsigned char AntiColor(unsigned char color)
     return color ^ 1;
 }
 
+/**
+ * @brief マスが属する4x4の象限のビット
+ * 
+ * @param pos 位置番号
+ * @return uint8 象限ビット(1, 2, 4, 8)
+ */
+inline uint8 QuadrantBit(const uint8 pos)
+{
+    return (uint8)(1 << (((pos >> 2) & 1) | ((pos >> 4) & 2)));
+}
+
+/**
+ * @brief 空きマスが奇数個の象限のビットを計算
+ * 
+ * @param empty 空きマス
+ * @return uint8 象限ビットの論理和
+ */
+inline uint8 QuadrantParity(uint64_t empty)
+{
+    uint8 parity = 0;
+    for (; empty != 0; empty &= empty - 1)
+    {
+        parity ^= QuadrantBit(PosIndexFromBit(empty));
+    }
+    return parity;
+}
+
 #pragma warning(push)
 #pragma warning(disable : 4146)
 inline uint64_t GetLSB(uint64_t bits)
@@ -216,6 +216,7 @@ int main()
 
     srand(GLOBAL_SEED);
     HashInit();
+    StabilityInit();
 
     printf("Mid:%d MPC:%d", MID_DEPTH, USE_MPC);
 
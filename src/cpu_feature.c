@@ -0,0 +1,189 @@
+/**
+ * @file cpu_feature.c
+ * @author Daichi Sato
+ * @brief 実行中のCPUが対応する命令セットの判定
+ * @version 1.0
+ * @date 2021-03-01
+ * 
+ * @copyright Copyright (c) 2021 Daichi Sato
+ * 
+ * 世代の異なるCPUで同じ実行ファイルを使えるように，
+ * 起動後にCPUIDを調べてビット演算などのカーネルを選択する。
+ * AVX系の命令はOSがレジスタの退避に対応しているか（XGETBV）も確認する。
+ * PEXT/PDEPはZen2以前のAMD製CPUではマイクロコード実行で非常に遅いので，別途判定する。
+ * 
+ */
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+#include "cpu_feature.h"
+
+// CPUID.(EAX=1):ECX
+#define CPUID1_ECX_OSXSAVE (1u << 27)
+#define CPUID1_ECX_AVX (1u << 28)
+// CPUID.(EAX=7,ECX=0):EBX
+#define CPUID7_EBX_BMI1 (1u << 3)
+#define CPUID7_EBX_AVX2 (1u << 5)
+#define CPUID7_EBX_BMI2 (1u << 8)
+#define CPUID7_EBX_AVX512F (1u << 16)
+#define CPUID7_EBX_AVX512DQ (1u << 17)
+#define CPUID7_EBX_AVX512CD (1u << 28)
+#define CPUID7_EBX_AVX512BW (1u << 30)
+#define CPUID7_EBX_AVX512VL (1u << 31)
+// CPUID.(EAX=80000001H):ECX
+#define CPUIDX1_ECX_LZCNT (1u << 5)
+// XCR0（OSが退避するレジスタ）
+#define XCR0_AVX 0x06u
+#define XCR0_AVX512 0xe0u
+
+// PEXT/PDEPが高速になったAMD製CPUのファミリー（Zen3）
+#define AMD_FAMILY_FAST_PEXT 0x19
+
+#define CPUID7_EBX_LEVEL_BMI2 (CPUID7_EBX_BMI1 | CPUID7_EBX_BMI2)
+#define CPUID7_EBX_LEVEL_AVX512 (CPUID7_EBX_AVX512F | CPUID7_EBX_AVX512DQ | CPUID7_EBX_AVX512CD | \
+                                 CPUID7_EBX_AVX512BW | CPUID7_EBX_AVX512VL)
+
+/**
+ * @brief CPUIDの実行
+ * 
+ * @param leaf 機能番号(EAX)
+ * @param subleaf 副機能番号(ECX)
+ * @param regs 出力：EAX, EBX, ECX, EDX
+ */
+static void CpuId(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuidex(info, (int)leaf, (int)subleaf);
+    regs[0] = (uint32_t)info[0];
+    regs[1] = (uint32_t)info[1];
+    regs[2] = (uint32_t)info[2];
+    regs[3] = (uint32_t)info[3];
+#else
+    if (!__get_cpuid_count(leaf, subleaf, &regs[0], &regs[1], &regs[2], &regs[3]))
+    {
+        regs[0] = regs[1] = regs[2] = regs[3] = 0;
+    }
+#endif
+}
+
+/**
+ * @brief OSが有効にしているレジスタ状態(XCR0)の取得
+ * 
+ * OSXSAVEが立っているときだけ呼び出すこと
+ * 
+ * @return uint32_t XCR0の下位32bit
+ */
+static uint32_t ReadXCR0()
+{
+#ifdef _MSC_VER
+    return (uint32_t)_xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv"
+                     : "=a"(eax), "=d"(edx)
+                     : "c"(0));
+    return eax;
+#endif
+}
+
+/**
+ * @brief 実行中のCPU・OSで使える命令セットの段階を判定
+ * 
+ * @return CpuLevel 使える最も高い段階
+ */
+CpuLevel CpuDetectLevel()
+{
+    uint32_t regs[4];
+    uint32_t maxLeaf, maxExtLeaf, ecx1, ebx7, xcr0;
+
+    CpuId(0, 0, regs);
+    maxLeaf = regs[0];
+    if (maxLeaf < 7)
+        return CPU_LEVEL_SCALAR;
+
+    CpuId(0x80000000, 0, regs);
+    maxExtLeaf = regs[0];
+    if (maxExtLeaf < 0x80000001)
+        return CPU_LEVEL_SCALAR;
+    CpuId(0x80000001, 0, regs);
+    if (!(regs[2] & CPUIDX1_ECX_LZCNT))
+        return CPU_LEVEL_SCALAR;
+
+    CpuId(7, 0, regs);
+    ebx7 = regs[1];
+    if ((ebx7 & CPUID7_EBX_LEVEL_BMI2) != CPUID7_EBX_LEVEL_BMI2)
+        return CPU_LEVEL_SCALAR;
+
+    CpuId(1, 0, regs);
+    ecx1 = regs[2];
+    if ((ecx1 & (CPUID1_ECX_OSXSAVE | CPUID1_ECX_AVX)) != (CPUID1_ECX_OSXSAVE | CPUID1_ECX_AVX))
+        return CPU_LEVEL_BMI2;
+
+    xcr0 = ReadXCR0();
+    if ((xcr0 & XCR0_AVX) != XCR0_AVX || !(ebx7 & CPUID7_EBX_AVX2))
+        return CPU_LEVEL_BMI2;
+
+    if ((ebx7 & CPUID7_EBX_LEVEL_AVX512) != CPUID7_EBX_LEVEL_AVX512 || (xcr0 & XCR0_AVX512) != XCR0_AVX512)
+        return CPU_LEVEL_AVX2;
+
+    return CPU_LEVEL_AVX512;
+}
+
+/**
+ * @brief PEXT/PDEPが高速に実行できるか
+ * 
+ * Zen2以前のAMD製CPU（Hygonを含む）はBMI2に対応していても遅いので除く
+ * 
+ * @return bool 高速に実行できるか
+ */
+bool CpuHasFastPEXT()
+{
+    uint32_t regs[4];
+    uint32_t family;
+    bool isAMD;
+
+    CpuId(0, 0, regs);
+    if (regs[0] < 7)
+        return false;
+    // ベンダー名 "AuthenticAMD" / "HygonGenuine" の先頭4文字(EBX)
+    isAMD = regs[1] == 0x68747541 || regs[1] == 0x6f677948;
+
+    CpuId(7, 0, regs);
+    if (!(regs[1] & CPUID7_EBX_BMI2))
+        return false;
+
+    CpuId(1, 0, regs);
+    family = (regs[0] >> 8) & 0xf;
+    if (family == 0xf)
+        family += (regs[0] >> 20) & 0xff;
+
+    return !isAMD || family >= AMD_FAMILY_FAST_PEXT;
+}
+
+/**
+ * @brief 命令セットの段階の表示名
+ * 
+ * @param level 命令セットの段階
+ * @return const char* 表示名
+ */
+const char *CpuLevelName(CpuLevel level)
+{
+    switch (level)
+    {
+    case CPU_LEVEL_SCALAR:
+        return "scalar";
+    case CPU_LEVEL_BMI2:
+        return "BMI2";
+    case CPU_LEVEL_AVX2:
+        return "AVX2";
+    case CPU_LEVEL_AVX512:
+        return "AVX-512";
+    default:
+        return "unknown";
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef CPU_FEATURE_DEFINED
+#define CPU_FEATURE_DEFINED
+
+#include "const.h"
+
+// 実行時に使い分ける命令セットの段階
+typedef enum CpuLevel
+{
+    // x86-64の基本命令のみ（POPCNTは使用）
+    CPU_LEVEL_SCALAR,
+    // BMI1/BMI2 + LZCNT（AVXをOSが無効にしている環境など）
+    CPU_LEVEL_BMI2,
+    // AVX2 + BMI1/BMI2 + LZCNT（Haswell以降）
+    CPU_LEVEL_AVX2,
+    // AVX2に加えてAVX-512 F/CD/DQ/BW/VL（Skylake-SP以降）
+    CPU_LEVEL_AVX512,
+    NB_CPU_LEVEL
+} CpuLevel;
+
+// 各段階の命令セットを関数単位で有効化する（MSVCは組み込み命令をどこでも使えるので不要）
+#if defined(__GNUC__)
+#define TARGET_BMI2 __attribute__((target("bmi,bmi2,lzcnt,popcnt")))
+#define TARGET_AVX2 __attribute__((target("avx2,bmi,bmi2,lzcnt,popcnt")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx512cd,avx512dq,avx512bw,avx512vl,avx2,bmi,bmi2,lzcnt,popcnt")))
+#else
+#define TARGET_BMI2
+#define TARGET_AVX2
+#define TARGET_AVX512
+#endif
+
+CpuLevel CpuDetectLevel();
+bool CpuHasFastPEXT();
+const char *CpuLevelName(CpuLevel level);
+
+#endif
@@ -47,6 +47,8 @@ static uint8 aiColor;
 
 DLLAPI void DllInit();
 DLLAPI void DllConfigureSearch(int color, unsigned char midDepth, unsigned char endDepth, int oneMoveTime, bool useTimer, bool useMPC, bool enablePreSearch);
+DLLAPI int DllConfigureHash(unsigned int hashSizeMB);
+DLLAPI void DllConfigureHelpers(int numHelpers, bool useLazySmp);
 DLLAPI int DllSearch(double *value);
 
 DLLAPI void DllBoardReset();
@@ -80,6 +82,7 @@ void DllInit()
 
     srand(GLOBAL_SEED);
     HashInit();
+    StabilityInit();
     //TreeInit(dllTree);
     BoardReset(dllBoard);
     SearchManagerInit(sManager, 4, true);
@@ -103,6 +106,32 @@ void DllConfigureSearch(int color, unsigned char midDepth, unsigned char endDept
     sManager->enableAsyncPreSearching = enablePreSearch;
 }
 
+/**
+ * @brief 置換表サイズの設定を行う
+ * 
+ * 置換表は確保し直されるので，対局開始前に呼び出すこと
+ * 
+ * @param hashSizeMB 置換表のサイズ[MB]
+ * @return int 設定できたか(1:成功, 0:失敗，確保できなければ元のサイズのまま)
+ */
+int DllConfigureHash(unsigned int hashSizeMB)
+{
+    return SearchManagerConfigureHashSize(sManager, hashSizeMB) ? 1 : 0;
+}
+
+/**
+ * @brief 補助探索スレッド数の設定を行う
+ * 
+ * 事前探索用のBranchを使い回すので，最大でBranch数-1
+ * 
+ * @param numHelpers 補助探索スレッド数（0で無効）
+ * @param useLazySmp 中盤でルートの分割探索の代わりにLazy SMPを使うか
+ */
+void DllConfigureHelpers(int numHelpers, bool useLazySmp)
+{
+    SearchManagerConfigureHelpers(sManager, numHelpers, useLazySmp);
+}
+
 /**
  * @brief 予想最善手の探索を行う
  * 
@@ -275,6 +275,7 @@ double LearnFromAscii(SearchTree trees[2], string recordFileName, vector<Feature
         string modelDir = modelFolder + modelName + "Ascii" + to_string(fileCnt) + "_Loss" + to_string((int)(loss * 100)) + "/";
         _mkdir(modelDir.c_str());
         RegrSave(trees[1].eval->regr, modelDir.c_str());
+        RegrSaveModel(trees[1].eval->regr, modelDir.c_str());
         // 旧ツリーに新Weightを上書きコピー
         RegrCopyWeight(trees[1].eval->regr, trees[0].eval->regr);
         /*
@@ -360,6 +361,7 @@ void LearnFromAsciiAllFileInDir(bool resetWeight, string folder)
     string modelDir = modelFolder + modelName + "Ascii" + to_string(fileCnt) + "_Loss" + to_string((int)(loss * 100)) + "_Last/";
     _mkdir(modelDir.c_str());
     RegrSave(trees[1].eval->regr, modelDir.c_str());
+    RegrSaveModel(trees[1].eval->regr, modelDir.c_str());
 
     TreeDelete(&trees[0]);
     TreeDelete(&trees[1]);
@@ -368,6 +370,7 @@ void LearnFromAsciiAllFileInDir(bool resetWeight, string folder)
 int main(int argc, char **argv)
 {
     HashInit();
+    StabilityInit();
     srand(GLOBAL_SEED);
 
     //LearnFromAsciiAllFileInDir(true, "./resources/record/correctbk/");
@@ -375,6 +378,10 @@ int main(int argc, char **argv)
     vector<FeatureRecord> testRecord;
     GetTestData(testRecord);
     SelfPlay(4, 16, false, testRecord);
+    // 探索用のモデルファイルを作る
+    //ConvertRegrModel("resources/regressor/best/", "resources/regressor/best/");
+    // 探索用に量子化したモデルを作る
+    //ConvertNNetModel("resources/model/model_2003-epoch1/", "resources/model/model_2003-epoch1/", testRecord.data(), testRecord.size());
 
     //MPCSampling(nbPlay, 6, 4.0 / 60.0, 1, idxShift);
     /*
@@ -429,6 +436,7 @@ int main(int argc, char **argv)
         SaveNets(tree.eval->net, modelDir.c_str());
 #elif USE_REGRESSION
         RegrSave(tree.eval->regr, modelDir.c_str());
+        RegrSaveModel(tree.eval->regr, modelDir.c_str());
 #endif
 
 #ifdef USE_NN
@@ -110,6 +110,7 @@ void MPCSampling(int nbPlay, int randomTurns, double randMoveRatio, bool enableL
 int main(int argc, char **argv)
 {
     HashInit();
+    StabilityInit();
     srand(GLOBAL_SEED);
 
     int idxShift;
@@ -297,4 +297,53 @@ float TrainNN(NNet *net, FeatureRecord *featRecords, FeatureRecord *testRecords,
         free(tests[phase]);
     }
     return (float)totalLoss / totalCnt;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief floatのモデルファイルを量子化したモデルファイル（MODEL_FILE_NAME）へ変換する
+ * 
+ * フェーズごとに読み込み・量子化を行い，テストデータでfloatとの予測の差（石数）を表示する
+ * 
+ * @param srcFolder floatのモデルのフォルダ
+ * @param dstFolder 量子化したモデルファイルの書き込み先フォルダ
+ * @param testRecords 予測の差を測るデータ
+ * @param nbTests データ数
+ * @return float 予測の差の平均（石数）
+ */
+float ConvertNNetModel(const char *srcFolder, const char *dstFolder, FeatureRecord *testRecords, size_t nbTests)
+{
+    NNet *net = (NNet *)malloc(sizeof(NNet));
+    // 構造体のパディングも0にしておく（チェックサムを変換ごとに変えない）
+    QNNet *qnet = (QNNet *)calloc(NB_PHASE, sizeof(QNNet));
+    double diff, totalDiff = 0, maxDiff;
+    int phase, totalCnt = 0;
+
+    for (phase = 0; phase < NB_PHASE; phase++)
+    {
+        if (!LoadNet(net, srcFolder, phase))
+        {
+            break;
+        }
+        QuantizeNet(net, &qnet[phase]);
+
+        maxDiff = 0;
+        for (size_t i = 0; i < nbTests; i++)
+        {
+            if (PHASE(testRecords[i].nbEmpty) != phase)
+                continue;
+            diff = fabs(Predict(net, testRecords[i].featStats[0]) - QPredict(&qnet[phase], testRecords[i].featStats[0])) * 128.0;
+            totalDiff += diff;
+            maxDiff = (diff > maxDiff) ? diff : maxDiff;
+            totalCnt++;
+        }
+        printf("NN quantize phase%d: scale %.1f/%.1f/%.1f max diff %.4f\n",
+               phase, qnet[phase].scale1, qnet[phase].scale2, qnet[phase].scale3, maxDiff);
+    }
+    if (phase == NB_PHASE)
+    {
+        SaveQNetModel(qnet, dstFolder);
+    }
+    free(net);
+    free(qnet);
+    return (totalCnt > 0) ? (float)(totalDiff / totalCnt) : 0.0f;
+}
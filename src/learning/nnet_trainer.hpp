@@ -11,5 +11,6 @@ extern "C"
 void InitWeight(NNet *net);
 void DecreaseNNlr(NNet *net);
 float TrainNN(NNet *net, FeatureRecord *featRecords, FeatureRecord *testRecords, size_t nbRecords, size_t nbTests);
+float ConvertNNetModel(const char *srcFolder, const char *dstFolder, FeatureRecord *testRecords, size_t nbTests);
 
 #endif // _NNET_TRAINER_H_
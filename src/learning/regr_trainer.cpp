@@ -380,4 +380,25 @@ double RegrTrain(Regressor regr[NB_PHASE], vector<FeatureRecord> &featRecords, F
     phaseInputs.clear();
     return (double)totalLoss / totalCnt;
 }
+
+/**
+ * @brief フェーズごとのファイル(phase*)を探索用のモデルファイル（MODEL_FILE_NAME）へ変換する
+ * 
+ * 探索時はモデルファイルがあればそちらを使うので，フェーズごとのファイルを差し替えたら変換し直すこと
+ * 
+ * @param srcFolder フェーズごとのファイルのフォルダ
+ * @param dstFolder モデルファイルの書き込み先フォルダ
+ * @return bool 変換できたか
+ */
+bool ConvertRegrModel(const char *srcFolder, const char *dstFolder)
+{
+    Regressor *regr = (Regressor *)malloc(sizeof(Regressor) * NB_PHASE);
+    bool isSucceeded;
+
+    InitRegr(regr);
+    isSucceeded = RegrLoad(regr, srcFolder) && RegrSaveModel(regr, dstFolder);
+    DelRegr(regr);
+    free(regr);
+    return isSucceeded;
+}
 #endif
\ No newline at end of file
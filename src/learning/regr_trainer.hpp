@@ -9,5 +9,6 @@ void RegrTrainInit(Regressor regr[NB_PHASE]);
 void RegrInitBeta(Regressor regr[NB_PHASE]);
 double RegrTrain(Regressor regr[NB_PHASE], vector<FeatureRecord> &featRecords, FeatureRecord *testRecords, size_t nbTests);
 void RegrDecreaseBeta(Regressor regr[NB_PHASE], double mul);
+bool ConvertRegrModel(const char *srcFolder, const char *dstFolder);
 
 #endif // _REGR_TRAINER_H_
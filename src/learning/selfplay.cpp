@@ -273,6 +273,7 @@ void SelfPlay(uint8 midDepth, uint8 endDepth, bool resetWeight, vector<FeatureRe
             }
 #elif USE_REGRESSION
             RegrSave(trees[1].eval->regr, modelDir.c_str());
+            RegrSaveModel(trees[1].eval->regr, modelDir.c_str());
             // 旧ツリーに新Weightを上書きコピー
             RegrCopyWeight(trees[1].eval->regr, trees[0].eval->regr);
             /*
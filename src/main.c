@@ -10,21 +10,55 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 #include <stdlib.h>
 #include "bit_operation.h"
 
 #include "game.h"
 
-int main()
+/**
+ * @brief CUIプレイ
+ * 
+ * オプション:
+ *   --hash <MB>  置換表のサイズ[MB]
+ *   --helpers <N>  メインルート探索を手伝う補助探索スレッド数
+ *   --lazy-smp  中盤でルートの分割探索の代わりにLazy SMPを使う
+ */
+int main(int argc, char *argv[])
 {
+    unsigned int hashSizeMB = DEFAULT_OPTION.hashSizeMB;
+    int numHelpers = DEFAULT_PROCESS_NUM - 1;
+    bool useLazySmp = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--hash") == 0 && i + 1 < argc)
+        {
+            hashSizeMB = (unsigned int)atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--helpers") == 0 && i + 1 < argc)
+        {
+            numHelpers = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--lazy-smp") == 0)
+        {
+            useLazySmp = true;
+        }
+    }
+
     srand(GLOBAL_SEED);
     HashInit();
+    StabilityInit();
     Game game[1];
 
     // 現状ソースコードで先行/後攻切り替え
     GameInit(game, GM_CPU_WHITE, 12, 20);
     //GameInit(game, GM_CPU_BLACK, 12, 18);
+    if (!SearchManagerConfigureHashSize(game->sManager, hashSizeMB))
+    {
+        printf("置換表を%u[MB]にできませんでした。%u[MB]で探索します。\n", hashSizeMB, game->sManager->masterOption.hashSizeMB);
+    }
+    SearchManagerConfigureHelpers(game->sManager, numHelpers, useLazySmp);
     GameStart(game);
 
     // ベンチマークの名残
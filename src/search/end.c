@@ -24,15 +24,22 @@
 #include "search.h"
 #include "hash.h"
 #include "moves.h"
+#include "search_pool.h"
+#include "stability.h"
 #include "../ai/eval.h"
 #include "../bit_operation.h"
 #include "../const.h"
 #include <assert.h>
 #include <math.h>
 
+// 専用の関数で解く残り空きマス数
+#define SOLVE_LAST_DEPTH 4
+
 /**
  * @brief 石差を計算する
  * 
+ * 終盤探索のスコアは石差そのもの（SolveLast系と同じ単位）
+ * 
  * @param tree 探索木
  * @return score_t 石差
  */
@@ -40,7 +47,55 @@ inline score_t Judge(const SearchTree *tree)
 {
     const uint8 nbOwn = CountBits(tree->stones->own);
     const uint8 nbOpp = 64 - tree->nbEmpty - nbOwn;
-    return (score_t)((nbOwn - nbOpp) * STONE_VALUE);
+    return (score_t)(nbOwn - nbOpp);
+}
+
+/**
+ * @brief 石情報から石差を計算する
+ * 
+ * @param own 手番側の石
+ * @param opp 相手の石
+ * @return score_t 石差
+ */
+inline score_t JudgeStones(const uint64_t own, const uint64_t opp)
+{
+    return (score_t)(CountBits(own) - CountBits(opp));
+}
+
+/**
+ * @brief 空きマスを偶数理論で並べ替える
+ * 
+ * 空きマスが奇数個の象限のマスを先に打つ（最後の1マスを自分が打てる可能性が高い）。
+ * 同じ優先度のマスは元の順番を保つ。
+ * 
+ * @param empties 空きマスの位置番号
+ * @param nbEmpties 空きマス数
+ */
+inline void SortEmptiesByParity(uint8 *empties, const int nbEmpties)
+{
+    uint8 parity = 0;
+    uint8 sorted[SOLVE_LAST_DEPTH];
+    int nbSorted = 0;
+    int i;
+
+    for (i = 0; i < nbEmpties; i++)
+    {
+        parity ^= QuadrantBit(empties[i]);
+    }
+    for (i = 0; i < nbEmpties; i++)
+    {
+        if (parity & QuadrantBit(empties[i]))
+            sorted[nbSorted++] = empties[i];
+    }
+    for (i = 0; i < nbEmpties; i++)
+    {
+        if (!(parity & QuadrantBit(empties[i])))
+            sorted[nbSorted++] = empties[i];
+    }
+    for (i = 0; i < nbEmpties; i++)
+    {
+        empties[i] = sorted[i];
+    }
 }
 
 /**
@@ -60,22 +115,19 @@ inline score_t Judge(const SearchTree *tree)
  * @param alpha 
  * @return score_t 石差
  */
-inline score_t SolveLast1(Stones *stones, const score_t alpha)
+inline score_t SolveLast1(const uint64_t own, const uint64_t opp, const uint8 pos, const score_t alpha)
 {
     score_t ownScore;
-    uint64_t flips;
-    uint64_t posBit = ~(stones->own | stones->opp);
-    uint8 pos = PosIndexFromBit(posBit);
     uint8 nbFlips;
-    assert(CountBits(posBit) == 1);
+    assert(CountBits(~(own | opp)) == 1);
 
     // [2*nbOwn - 64]
-    ownScore = 2 * CountBits(stones->own) - 64 + 1;
+    ownScore = 2 * CountBits(own) - 64 + 1;
 
-    flips = CalcFlip64(stones->own, stones->opp, pos);
-    if (flips != 0)
+    // 反転位置は不要なので反転数だけ計算
+    nbFlips = CountFlipLast(own, pos);
+    if (nbFlips != 0)
     {
-        nbFlips = CountBits(flips);
         // -[2*nbFlip]
         ownScore += 2 * nbFlips + 1;
     }
@@ -87,10 +139,9 @@ inline score_t SolveLast1(Stones *stones, const score_t alpha)
         }
         else
         {
-            flips = CalcFlip64(stones->opp, stones->own, pos);
-            if (flips != 0)
+            nbFlips = CountFlipLast(opp, pos);
+            if (nbFlips != 0)
             {
-                nbFlips = CountBits(flips);
                 ownScore -= 2 * nbFlips + 1;
             }
         }
@@ -98,6 +149,253 @@ inline score_t SolveLast1(Stones *stones, const score_t alpha)
     return ownScore;
 }
 
+/**
+ * @brief 残り2マス状態で最終石差を計算する
+ * 
+ * 着手リスト・評価関数の更新を行わず，石情報だけで解く
+ * 
+ * @param tree 探索木（ノード数の記録用）
+ * @param own 手番側の石
+ * @param opp 相手の石
+ * @param alpha アルファ値
+ * @param beta ベータ値
+ * @param empties 空きマスの位置番号（着手順）
+ * @param passed パスされたか
+ * @return score_t 石差
+ */
+static score_t SolveLast2(SearchTree *tree, const uint64_t own, const uint64_t opp, const score_t alpha, const score_t beta, const uint8 *empties, const bool passed)
+{
+    const uint8 x1 = empties[0], x2 = empties[1];
+    score_t score, bestScore = -MAX_VALUE;
+    uint64_t flip;
+
+    flip = CalcFlip64(own, opp, x1);
+    if (flip != 0)
+    {
+        tree->nodeCount++;
+        bestScore = -SolveLast1(opp ^ flip, own ^ flip ^ CalcPosBit(x1), x2, -beta);
+        if (bestScore >= beta)
+        {
+            return bestScore;
+        }
+    }
+
+    flip = CalcFlip64(own, opp, x2);
+    if (flip != 0)
+    {
+        tree->nodeCount++;
+        score = -SolveLast1(opp ^ flip, own ^ flip ^ CalcPosBit(x2), x1, -beta);
+        if (score > bestScore)
+        {
+            bestScore = score;
+        }
+    }
+
+    if (bestScore == -MAX_VALUE)
+    {
+        // 2連続パスなら終了
+        if (passed)
+        {
+            return JudgeStones(own, opp);
+        }
+        tree->nodeCount++;
+        return -SolveLast2(tree, opp, own, -beta, -alpha, empties, true);
+    }
+    return bestScore;
+}
+
+/**
+ * @brief 残り3マス状態で最終石差を計算する
+ * 
+ * @param tree 探索木（ノード数の記録用）
+ * @param own 手番側の石
+ * @param opp 相手の石
+ * @param alpha アルファ値
+ * @param beta ベータ値
+ * @param empties 空きマスの位置番号（偶数理論で並べ替える）
+ * @param passed パスされたか
+ * @return score_t 石差
+ */
+static score_t SolveLast3(SearchTree *tree, const uint64_t own, const uint64_t opp, score_t alpha, const score_t beta, uint8 *empties, const bool passed)
+{
+    uint8 rest[2];
+    score_t score, bestScore = -MAX_VALUE;
+    uint64_t flip;
+    int i, j, k;
+
+    if (!passed)
+    {
+        SortEmptiesByParity(empties, 3);
+    }
+
+    for (i = 0; i < 3; i++)
+    {
+        flip = CalcFlip64(own, opp, empties[i]);
+        if (flip == 0)
+            continue;
+
+        for (j = 0, k = 0; j < 3; j++)
+        {
+            if (j != i)
+                rest[k++] = empties[j];
+        }
+        tree->nodeCount++;
+        score = -SolveLast2(tree, opp ^ flip, own ^ flip ^ CalcPosBit(empties[i]), -beta, -alpha, rest, false);
+        if (score > bestScore)
+        {
+            bestScore = score;
+            if (score >= beta)
+            {
+                return bestScore;
+            }
+            if (score > alpha)
+            {
+                alpha = score;
+            }
+        }
+    }
+
+    if (bestScore == -MAX_VALUE)
+    {
+        // 2連続パスなら終了
+        if (passed)
+        {
+            return JudgeStones(own, opp);
+        }
+        tree->nodeCount++;
+        return -SolveLast3(tree, opp, own, -beta, -alpha, empties, true);
+    }
+    return bestScore;
+}
+
+/**
+ * @brief 残り4マス状態で最終石差を計算する
+ * 
+ * @param tree 探索木（ノード数の記録用）
+ * @param own 手番側の石
+ * @param opp 相手の石
+ * @param alpha アルファ値
+ * @param beta ベータ値
+ * @param empties 空きマスの位置番号（偶数理論で並べ替える）
+ * @param passed パスされたか
+ * @return score_t 石差
+ */
+static score_t SolveLast4(SearchTree *tree, const uint64_t own, const uint64_t opp, score_t alpha, const score_t beta, uint8 *empties, const bool passed)
+{
+    uint8 rest[3];
+    score_t score, bestScore = -MAX_VALUE;
+    uint64_t flip;
+    int i, j, k;
+
+    if (!passed)
+    {
+        SortEmptiesByParity(empties, 4);
+    }
+
+    for (i = 0; i < 4; i++)
+    {
+        flip = CalcFlip64(own, opp, empties[i]);
+        if (flip == 0)
+            continue;
+
+        for (j = 0, k = 0; j < 4; j++)
+        {
+            if (j != i)
+                rest[k++] = empties[j];
+        }
+        tree->nodeCount++;
+        score = -SolveLast3(tree, opp ^ flip, own ^ flip ^ CalcPosBit(empties[i]), -beta, -alpha, rest, false);
+        if (score > bestScore)
+        {
+            bestScore = score;
+            if (score >= beta)
+            {
+                return bestScore;
+            }
+            if (score > alpha)
+            {
+                alpha = score;
+            }
+        }
+    }
+
+    if (bestScore == -MAX_VALUE)
+    {
+        // 2連続パスなら終了
+        if (passed)
+        {
+            return JudgeStones(own, opp);
+        }
+        tree->nodeCount++;
+        return -SolveLast4(tree, opp, own, -beta, -alpha, empties, true);
+    }
+    return bestScore;
+}
+
+/**
+ * @brief 残りSOLVE_LAST_DEPTHマス以下の状態を専用の関数で解く
+ * 
+ * @param tree 探索木
+ * @param alpha アルファ値
+ * @param beta ベータ値
+ * @return score_t 石差
+ */
+static inline score_t SolveLast(SearchTree *tree, const score_t alpha, const score_t beta)
+{
+    const uint64_t own = tree->stones->own;
+    const uint64_t opp = tree->stones->opp;
+    uint64_t emptyBits = ~(own | opp);
+    uint8 empties[SOLVE_LAST_DEPTH];
+    int nbEmpties = 0;
+
+    assert(tree->nbEmpty <= SOLVE_LAST_DEPTH);
+    while (emptyBits != 0)
+    {
+        empties[nbEmpties++] = PosIndexFromBit(GetLSB(emptyBits));
+        emptyBits &= emptyBits - 1;
+    }
+
+    switch (nbEmpties)
+    {
+    case 4:
+        return SolveLast4(tree, own, opp, alpha, beta, empties, false);
+    case 3:
+        return SolveLast3(tree, own, opp, alpha, beta, empties, false);
+    case 2:
+        return SolveLast2(tree, own, opp, alpha, beta, empties, false);
+    case 1:
+        return SolveLast1(own, opp, empties[0], alpha);
+    default:
+        return JudgeStones(own, opp);
+    }
+}
+
+// 確定石カットを試すα値の下限 = 2 * 空きマス数 - STABILITY_THRESHOLD_MARGIN
+// 空きマスが多いと確定石は少ないので，αが高いときだけ確定石を数える
+#define STABILITY_THRESHOLD_MARGIN 12
+
+/**
+ * @brief 相手の確定石によってαを超えられないか判定する
+ * 
+ * @param tree 探索木
+ * @param alpha アルファ値
+ * @param score 出力：カットされた場合のスコア（上限値）
+ * @return bool カットできるか
+ */
+inline bool IsStabilityCut(const SearchTree *tree, const score_t alpha, score_t *score)
+{
+    if (alpha >= 2 * tree->nbEmpty - STABILITY_THRESHOLD_MARGIN)
+    {
+        // 相手の確定石以外はすべて自分の石になっても 64 - 2 * 相手の確定石数
+        *score = 64 - 2 * CountStableDiscs(tree->stones->opp, tree->stones->own);
+        if (*score <= alpha)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 inline uint8 CalcCost(uint64_t nbNodes)
 {
     return (uint8)log2l((long double)nbNodes);
@@ -116,11 +414,11 @@ inline uint8 CalcCost(uint64_t nbNodes)
 score_t EndAlphaBeta(SearchTree *tree, score_t alpha, score_t beta, unsigned char depth, bool passed)
 {
     uint8 bestMove;
-    uint64_t hashCode;
+    const uint64_t hashCode = tree->hashCode[0];
     SearchFunc_t NextSearch;
     MoveList moveList;
     Move *move;
-    HashData *hashData = NULL;
+    HashData hashEntry[1], *hashData = NULL;
     score_t score, maxScore, lower;
 
     // 子ノード数（スタート時点でのノード数で初期化）
@@ -134,9 +432,9 @@ score_t EndAlphaBeta(SearchTree *tree, score_t alpha, score_t beta, unsigned cha
         //return EvalPosTable(own, opp);
         return Judge(tree);
     }
-    if (depth == 1)
+    if (depth <= SOLVE_LAST_DEPTH)
     {
-        return SolveLast1(tree->stones, alpha);
+        return SolveLast(tree, alpha, beta);
     }
 
     CreateMoveList(&moveList, tree->stones);
@@ -164,7 +462,7 @@ score_t EndAlphaBeta(SearchTree *tree, score_t alpha, score_t beta, unsigned cha
     {
         if (tree->option.usePvHash == 1 && depth >= tree->pvHashDepth)
         {
-            hashData = HashTableGetData(tree->pvTable, tree->stones, depth, &hashCode);
+            hashData = HashTableGetData(tree->pvTable, hashCode, depth, hashEntry);
             if (hashData != NULL && IsHashCut(hashData, depth, &alpha, &beta, &score))
                 return score;
         }
@@ -216,7 +514,7 @@ score_t EndAlphaBeta(SearchTree *tree, score_t alpha, score_t beta, unsigned cha
 
     if (tree->option.usePvHash == 1 && depth >= tree->pvHashDepth)
     {
-        HashTableRegist(tree->pvTable, hashCode, tree->stones, bestMove, cost, depth, alpha, beta, maxScore);
+        HashTableRegist(tree->pvTable, hashCode, bestMove, cost, depth, alpha, beta, maxScore);
     }
     return maxScore;
 }
@@ -239,10 +537,11 @@ score_t EndAlphaBetaDeep(SearchTree *tree, score_t alpha, score_t beta, unsigned
 
     assert(depth <= tree->orderDepth);
 
-    uint64_t mob, pos, flip, hashCode;
+    uint64_t mob, pos, flip;
+    const uint64_t hashCode = tree->hashCode[0];
     uint8 posIdx;
     uint8 bestMove;
-    HashData *hashData = NULL;
+    HashData hashEntry[1], *hashData = NULL;
     score_t score, maxScore, lower;
 
     // 子ノード数（スタート時点でのノード数で初期化）
@@ -257,14 +556,14 @@ score_t EndAlphaBetaDeep(SearchTree *tree, score_t alpha, score_t beta, unsigned
         //return EvalTinyDnn(tree, tree->nbEmpty);
         return Judge(tree);
     }
-    if (depth == 1)
+    if (depth <= SOLVE_LAST_DEPTH)
     {
-        return SolveLast1(tree->stones, alpha);
+        return SolveLast(tree, alpha, beta);
     }
 
     if (tree->option.usePvHash == 1 && depth >= tree->pvHashDepth)
     {
-        hashData = HashTableGetData(tree->pvTable, tree->stones, depth, &hashCode);
+        hashData = HashTableGetData(tree->pvTable, hashCode, depth, hashEntry);
         if (hashData != NULL && IsHashCut(hashData, depth, &alpha, &beta, &score))
             return score;
     }
@@ -336,7 +635,7 @@ score_t EndAlphaBetaDeep(SearchTree *tree, score_t alpha, score_t beta, unsigned
 
     if (tree->option.usePvHash == 1 && depth >= tree->pvHashDepth)
     {
-        HashTableRegist(tree->pvTable, hashCode, tree->stones, bestMove, cost, depth, alpha, beta, maxScore);
+        HashTableRegist(tree->pvTable, hashCode, bestMove, cost, depth, alpha, beta, maxScore);
     }
     return maxScore;
 }
@@ -358,8 +657,9 @@ score_t EndAlphaBetaDeep(SearchTree *tree, score_t alpha, score_t beta, unsigned
 score_t EndNullWindowDeep(SearchTree *tree, const score_t beta, unsigned char depth, bool passed)
 {
     const score_t alpha = beta - 1;
-    HashData *hashData = NULL;
-    uint64_t mob, pos, flip, hashCode;
+    HashData hashEntry[1], *hashData = NULL;
+    uint64_t mob, pos, flip;
+    const uint64_t hashCode = tree->hashCode[0];
     score_t score, bestScore;
     uint8 posIdx;
     uint8 bestMove;
@@ -374,14 +674,18 @@ score_t EndNullWindowDeep(SearchTree *tree, const score_t beta, unsigned char de
     {
         return Judge(tree);
     }
-    if (depth == 1)
+    if (depth <= SOLVE_LAST_DEPTH)
+    {
+        return SolveLast(tree, alpha, beta);
+    }
+    if (IsStabilityCut(tree, alpha, &score))
     {
-        return SolveLast1(tree->stones, alpha);
+        return score;
     }
 
     if (tree->option.useHash == 1 && depth >= tree->hashDepth)
     {
-        hashData = HashTableGetData(tree->nwsTable, tree->stones, depth, &hashCode);
+        hashData = HashTableGetData(tree->nwsTable, hashCode, depth, hashEntry);
         if (hashData != NULL && IsHashCutNullWindow(hashData, depth, alpha, &score))
             return score;
     }
@@ -438,7 +742,7 @@ score_t EndNullWindowDeep(SearchTree *tree, const score_t beta, unsigned char de
 
     if (tree->option.useHash == 1 && depth >= tree->hashDepth)
     {
-        HashTableRegist(tree->nwsTable, hashCode, tree->stones, bestMove, cost, depth, alpha, beta, bestScore);
+        HashTableRegist(tree->nwsTable, hashCode, bestMove, cost, depth, alpha, beta, bestScore);
     }
     return bestScore;
 }
@@ -458,10 +762,10 @@ score_t EndNullWindowDeep(SearchTree *tree, const score_t beta, unsigned char de
 score_t EndNullWindow(SearchTree *tree, const score_t beta, unsigned char depth, bool passed)
 {
     SearchFuncNullWindow_t NextNullSearch;
-    HashData *hashData = NULL;
+    HashData hashEntry[1], *hashData = NULL;
     MoveList moveList;
     Move *move;
-    uint64_t hashCode;
+    const uint64_t hashCode = tree->hashCode[0];
     uint8 bestMove;
     score_t score, bestScore;
     const score_t alpha = beta - 1;
@@ -476,14 +780,18 @@ score_t EndNullWindow(SearchTree *tree, const score_t beta, unsigned char depth,
     {
         return Judge(tree);
     }
-    if (depth == 1)
+    if (depth <= SOLVE_LAST_DEPTH)
     {
-        return SolveLast1(tree->stones, alpha);
+        return SolveLast(tree, alpha, beta);
+    }
+    if (IsStabilityCut(tree, alpha, &score))
+    {
+        return score;
     }
 
     if (tree->option.useHash == 1 && depth >= tree->hashDepth)
     {
-        hashData = HashTableGetData(tree->nwsTable, tree->stones, depth, &hashCode);
+        hashData = HashTableGetData(tree->nwsTable, hashCode, depth, hashEntry);
         if (hashData != NULL && IsHashCutNullWindow(hashData, depth, alpha, &score))
             return score;
     }
@@ -515,13 +823,19 @@ score_t EndNullWindow(SearchTree *tree, const score_t beta, unsigned char depth,
     }
     else
     {
+        // 子ノードの置換表でカット
+        if (tree->option.useHash == 1 && depth >= tree->option.endEtcDepth && SearchEnhancedTransCut(tree, &moveList, depth, beta, &score))
+        {
+            return score;
+        }
 
-        EvaluateMoveList(tree, &moveList, tree->stones, alpha, hashData);
+        EvaluateMoveListEnd(tree, &moveList, hashData);
 
         bestScore = -MAX_VALUE;
 
         for (move = NextBestMoveWithSwap(moveList.moves); move != NULL; move = NextBestMoveWithSwap(move))
         {
+            SearchPrefetchChild(tree, move, depth - 1, false);
             SearchUpdateEnd(tree, move);
             { // 子ノードを探索
                 score = -NextNullSearch(tree, -alpha, depth - 1, false);
@@ -537,16 +851,49 @@ score_t EndNullWindow(SearchTree *tree, const score_t beta, unsigned char depth,
                     break; //探索終了
                 }
             }
+
+            if (SplitIsAborted(tree))
+            {
+                break;
+            }
+
+            // 長男の探索後，残りの着手を待機中のスレッドと分担
+            if (tree->pool && depth >= SPLIT_MIN_DEPTH && HasNextMove(move))
+            {
+                SplitPoint sp[1];
+                sp->Search = EndSplitPointSearch;
+                sp->cursor = move;
+                sp->depth = depth;
+                sp->isPv = false;
+                sp->scoreMap = NULL;
+                sp->secondMove = NOMOVE_INDEX;
+                sp->alpha = alpha;
+                sp->beta = beta;
+                sp->bestScore = bestScore;
+                sp->bestMove = bestMove;
+                if (SearchPoolSplit(tree, sp))
+                {
+                    bestScore = sp->bestScore;
+                    bestMove = sp->bestMove;
+                    break;
+                }
+            }
         }
     } // end of if(moveList.nbMoves > 0)
 
+    // 打ち切られた探索のスコアは登録しない
+    if (SplitIsAborted(tree))
+    {
+        return bestScore;
+    }
+
     // 「現在のノード数」と「スタート時点でのノード数」の差分＝子ノード数
     nbChildNode = tree->nodeCount - nbChildNode;
     cost = CalcCost(nbChildNode);
 
     if (tree->option.useHash == 1 && depth >= tree->hashDepth)
     {
-        HashTableRegist(tree->nwsTable, hashCode, tree->stones, bestMove, cost, depth, alpha, beta, bestScore);
+        HashTableRegist(tree->nwsTable, hashCode, bestMove, cost, depth, alpha, beta, bestScore);
     }
     return bestScore;
 }
@@ -568,10 +915,10 @@ score_t EndNullWindow(SearchTree *tree, const score_t beta, unsigned char depth,
 score_t EndPVS(SearchTree *tree, const score_t in_alpha, const score_t in_beta, const unsigned char depth, const bool passed)
 {
     SearchFunc_t NextSearch;
-    HashData *hashData = NULL;
+    HashData hashEntry[1], *hashData = NULL;
     MoveList moveList;
     Move *move;
-    uint64_t hashCode;
+    const uint64_t hashCode = tree->hashCode[0];
     uint8 bestMove;
     score_t score, alpha, beta;
     score_t bestScore;
@@ -586,16 +933,20 @@ score_t EndPVS(SearchTree *tree, const score_t in_alpha, const score_t in_beta,
     {
         return Judge(tree);
     }
-    if (depth == 1)
+    if (depth <= SOLVE_LAST_DEPTH)
     {
-        return SolveLast1(tree->stones, in_alpha);
+        return SolveLast(tree, in_alpha, in_beta);
+    }
+    if (IsStabilityCut(tree, in_alpha, &score))
+    {
+        return score;
     }
 
     alpha = in_alpha;
     beta = in_beta;
     if (tree->option.usePvHash == 1 && depth >= tree->hashDepth)
     { // ハッシュの記録をもとにカット/探索範囲の縮小
-        hashData = HashTableGetData(tree->pvTable, tree->stones, depth, &hashCode);
+        hashData = HashTableGetData(tree->pvTable, hashCode, depth, hashEntry);
         if (hashData != NULL && IsHashCut(hashData, depth, &alpha, &beta, &score))
             return score;
     }
@@ -631,10 +982,11 @@ score_t EndPVS(SearchTree *tree, const score_t in_alpha, const score_t in_beta,
         bestScore = -MAX_VALUE;
 
         // 着手の事前評価
-        EvaluateMoveList(tree, &moveList, tree->stones, alpha, hashData);
+        EvaluateMoveListEnd(tree, &moveList, hashData);
 
         for (move = NextBestMoveWithSwap(moveList.moves); move != NULL; move = NextBestMoveWithSwap(move))
         { // すべての着手についてループ
+            SearchPrefetchChild(tree, move, depth - 1, bestScore == -MAX_VALUE);
             SearchUpdateEnd(tree, move);
             if (bestScore == -MAX_VALUE)
             {                                                               // PVが見つかっていない
@@ -665,20 +1017,137 @@ score_t EndPVS(SearchTree *tree, const score_t in_alpha, const score_t in_beta,
                     alpha = bestScore;
                 }
             }
+
+            if (SplitIsAborted(tree))
+            {
+                break;
+            }
+
+            // 長男の探索後，残りの着手を待機中のスレッドと分担
+            if (tree->pool && depth >= SPLIT_MIN_DEPTH && HasNextMove(move))
+            {
+                SplitPoint sp[1];
+                sp->Search = EndSplitPointSearch;
+                sp->cursor = move;
+                sp->depth = depth;
+                sp->isPv = true;
+                sp->scoreMap = NULL;
+                sp->secondMove = NOMOVE_INDEX;
+                sp->alpha = alpha;
+                sp->beta = beta;
+                sp->bestScore = bestScore;
+                sp->bestMove = bestMove;
+                if (SearchPoolSplit(tree, sp))
+                {
+                    bestScore = sp->bestScore;
+                    bestMove = sp->bestMove;
+                    if (bestScore >= beta)
+                    {
+                        tree->nbCut++;
+                    }
+                    break;
+                }
+            }
         } // end of moves loop
     }
 
+    // 打ち切られた探索のスコアは登録しない
+    if (SplitIsAborted(tree))
+    {
+        return bestScore;
+    }
+
     // 「現在のノード数」と「スタート時点でのノード数」の差分＝子ノード数
     nbChildNode = tree->nodeCount - nbChildNode;
     cost = CalcCost(nbChildNode);
 
     if (tree->option.usePvHash == 1 && depth >= tree->hashDepth)
     {
-        HashTableRegist(tree->pvTable, hashCode, tree->stones, bestMove, cost, depth, in_alpha, in_beta, bestScore);
+        HashTableRegist(tree->pvTable, hashCode, bestMove, cost, depth, in_alpha, in_beta, bestScore);
     }
     return bestScore;
 }
 
+/**
+ * @brief 分割点の残りの着手を探索する（YBWC）
+ * 
+ * 分割したスレッド・補助スレッドが同時に呼び出し，着手を1つずつ取り出して探索する。
+ * 探索窓は他のスレッドの結果で狭まっていく。βカットが起きたら残りの着手は探索しない。
+ * 
+ * @param tree 探索木（分割点の盤面に設定済み）
+ * @param sp 分割点
+ */
+void EndSplitPointSearch(SearchTree *tree, SplitPoint *sp)
+{
+    Move *move;
+    score_t score, alpha, beta;
+    bool isResearched;
+
+    while (true)
+    {
+        // 次の着手と現在の探索窓を取得
+        SpinLockAcquire(&sp->lock);
+        if (SplitIsAborted(tree))
+        {
+            SpinLockRelease(&sp->lock);
+            break;
+        }
+        move = NextBestMoveWithSwap(sp->cursor);
+        if (move == NULL)
+        {
+            SpinLockRelease(&sp->lock);
+            break;
+        }
+        sp->cursor = move;
+        alpha = sp->alpha;
+        beta = sp->beta;
+        SpinLockRelease(&sp->lock);
+
+        SearchUpdateEnd(tree, move);
+        score = -EndNullWindow(tree, -alpha, sp->depth - 1, false);
+        // ルートノードではカットしないので，βを超えても再探索して正確なスコアを求める
+        isResearched = sp->isPv && score > alpha && (score < beta || sp->scoreMap != NULL);
+        if (isResearched) // 予想が外れていたら
+        {
+            score = -EndPVS(tree, -beta, -alpha, sp->depth - 1, false); // 通常のWindowで再探索
+        }
+        SearchRestoreEnd(tree, move);
+
+        // ルートノードでは探索の中断を確認（途中のノードで中断すると置換表が壊れるのでルートのみ）
+        if (sp->scoreMap != NULL && AtomicLoad32(&sp->master->killFlag))
+        {
+            AtomicStore32(&sp->isAborted, true);
+        }
+        if (SplitIsAborted(tree))
+        {
+            break;
+        }
+
+        // 結果を分割点に反映
+        SpinLockAcquire(&sp->lock);
+        if (sp->scoreMap != NULL)
+        {
+            // カットされたときは最高スコアより低スコアで記録
+            sp->scoreMap[move->posIdx] = isResearched ? score : score - 1;
+        }
+        if (score > sp->bestScore)
+        {
+            sp->bestScore = score;
+            sp->secondMove = sp->bestMove;
+            sp->bestMove = move->posIdx;
+            if (score >= sp->beta && sp->scoreMap == NULL)
+            {
+                AtomicStore32(&sp->isAborted, true);
+            }
+            else if (score > sp->alpha)
+            {
+                sp->alpha = score;
+            }
+        }
+        SpinLockRelease(&sp->lock);
+    }
+}
+
 /**
  * @brief 終盤探索のルートノード処理
  * 
@@ -713,11 +1182,11 @@ uint8 EndRoot(SearchTree *tree, bool choiceSecond)
     bestScore = -MAX_VALUE;
 
     // ハッシュによる探索の効率化
-    HashData *hashData = NULL;
-    uint64_t hashCode;
+    HashData hashEntry[1], *hashData = NULL;
+    const uint64_t hashCode = tree->hashCode[0];
     if (tree->option.usePvHash)
     {
-        hashData = HashTableGetData(tree->pvTable, tree->stones, depth, &hashCode);
+        hashData = HashTableGetData(tree->pvTable, hashCode, depth, hashEntry);
         if (hashData != NULL)
         {
             IsHashCut(hashData, depth, &alpha, &beta, &score);
@@ -758,6 +1227,7 @@ uint8 EndRoot(SearchTree *tree, bool choiceSecond)
         if (score > bestScore)
         {
             bestScore = score;
+            secondMove = bestMove;
             bestMove = move->posIdx;
             if (bestScore > alpha)
             {
@@ -766,11 +1236,39 @@ uint8 EndRoot(SearchTree *tree, bool choiceSecond)
         }
 
         // 探索の中断
-        if (tree->killFlag)
+        if (AtomicLoad32(&tree->killFlag))
         {
             tree->isIntrrupted = true;
             return NOMOVE_INDEX;
         }
+
+        // 最善手の探索後，残りの着手の検証を待機中のスレッドと分担
+        if (tree->pool && depth >= SPLIT_MIN_DEPTH && HasNextMove(move))
+        {
+            SplitPoint sp[1];
+            sp->Search = EndSplitPointSearch;
+            sp->cursor = move;
+            sp->depth = depth;
+            sp->isPv = true;
+            sp->scoreMap = latestScoreMap;
+            sp->alpha = alpha;
+            sp->beta = beta;
+            sp->bestScore = bestScore;
+            sp->bestMove = bestMove;
+            sp->secondMove = secondMove;
+            if (SearchPoolSplit(tree, sp))
+            {
+                if (AtomicLoad32(&sp->isAborted))
+                {
+                    tree->isIntrrupted = true;
+                    return NOMOVE_INDEX;
+                }
+                bestScore = sp->bestScore;
+                bestMove = sp->bestMove;
+                secondMove = sp->secondMove;
+                break;
+            }
+        }
     } // end of moves loop
 
     if (tree->isIntrrupted)
@@ -4,10 +4,13 @@
 #include "../const.h"
 struct SearchTree;
 typedef struct SearchTree SearchTree;
+struct SplitPoint;
+typedef struct SplitPoint SplitPoint;
 
 score_t EndAlphaBetaDeep(SearchTree *tree, score_t alpha, score_t beta, unsigned char depth, bool passed);
 score_t EndAlphaBeta(SearchTree *tree, score_t alpha, score_t beta, unsigned char depth, bool passed);
 score_t EndPVS(SearchTree *tree, const score_t alpha, const score_t beta, const unsigned char depth, const bool passed);
 uint8 EndRoot(SearchTree *tree, bool choiceSecond);
+void EndSplitPointSearch(SearchTree *tree, SplitPoint *sp);
 
 #endif // END_H_
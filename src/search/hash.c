@@ -12,46 +12,132 @@
  * 有効に再利用することができる。
  * 
  * ハッシュ関数：
- * 64x2bit盤面を1byteごとに分割し，
- * それぞれに対して乱数を振り分け（起動時に各バイト値(0-255)に乱数振り分けをしておく），
- * 取得された16個の乱数をXORで統合することでハッシュ値を生成。
+ * 手番側・相手側の石が置かれたマスごとに乱数を振り分け，XORで統合することでハッシュ値を生成。
+ * 盤面から直接計算する場合は64x2bit盤面を1byteごとに分割し，
+ * 各バイト値(0-255)に対応する乱数（マスの乱数のXOR）を起動時に用意しておいて16回の参照で求める。
+ * 探索中は着手位置と反転位置の乱数だけを適用して差分更新する。
+ * 盤面は手番側から見た石情報なので，手番を入れ替えた盤面のハッシュコードも組で保持し，
+ * 着手・パスのたびに組を入れ替えることで手番の交代を表す。
+ * 
+ * データ配置：
+ * キャッシュライン(64byte)ごとに1バケットとし，1バケットに5データを格納する。
+ * 盤面そのものではなくハッシュコードの上位32bitを照合に使うことでデータを12byteに抑え，
+ * 1回の検索で触れるキャッシュラインを1本にしている。
+ * 大きな表ではTLBミスが支配的になるため，メモリはラージページ(2MB)での確保を試み，
+ * 使えない環境では通常のページで確保する。
+ * バケットが埋まっている場合は，経過バージョン・探索コスト・探索深度から優先度の低いデータを置き換える。
+ * 
+ * キャッシュファイル：
+ * 同じ局面を繰り返し解析する用途向けに，一定深度以上のデータをファイルへ保存し，
+ * 次回の探索開始前に読み込めるようにしている。
+ * ファイルは形式バージョンと評価モデルのチェックサムで照合し，一致しない場合は読み込まない。
+ * 読み込みはファイルをメモリにマップして行う。
+ * 
+ * 並列探索：
+ * 置換表は複数の探索スレッドから同時に参照・登録される。
+ * 各バケットはシーケンスカウンタ(seq)を持ち，書き込み中は奇数となる。
+ * 読み込み側はseqが前後で変化していないことを確認したコピーのみを使い，
+ * 書き込み側はseqを奇数へ取得できなかった場合，登録を諦める（ロック待ちはしない）。
  * 
  */
 
+#define _CRT_SECURE_NO_WARNINGS
+#ifdef _WIN32
+#include <Windows.h>
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include "hash.h"
 #include "random_util.h"
 #include "../bit_operation.h"
 #include "../const.h"
 
-// データ位置再探索（偶奇反転）
-#define RETRY_HASH(h) ((h) ^ 1)
+// キャッシュラインのサイズ
+#define CACHE_LINE_SIZE (64)
+// ラージページのサイズ
+#define LARGE_PAGE_SIZE ((size_t)2 << 20)
+// ハッシュコードのうち照合に使う部分
+#define HASH_SIGNATURE(h) ((uint32_t)((h) >> 32))
+
+// キャッシュファイルの識別子("MRHT")
+#define HASH_FILE_MAGIC (0x5448524D)
 
 #define HASH_SEED (160510)
 #define RAWHASH_MIN_TRUE_BITS (8)
 
 // 統計マクロ　有効/無効
+#ifdef HASH_STATS_ENABLED
 #define HASH_STATS(x) x
+#else
+#define HASH_STATS(x)
+#endif
 
 // RawHash[8行x2色][列内8石のパターン]
 uint64_t RawHash[8 * 2][1 << 8];
+// HashSquareKey[2色][マス]
+uint64_t HashSquareKey[2][64];
+// HashFlipKey[8行][列内8石のパターン]
+uint64_t HashFlipKey[8][1 << 8];
+
+// キャッシュファイルのヘッダ
+typedef struct HashFileHeader
+{
+    // 識別子
+    uint32_t magic;
+    // 形式バージョン
+    uint32_t version;
+    // HashDataのサイズ（構造の変化検出用）
+    uint32_t dataSize;
+    // 評価モデルのチェックサム
+    uint32_t modelChecksum;
+    // 終盤探索のスコア（石差）か
+    uint32_t isEndScore;
+    // 保存したデータの最小探索深度
+    uint32_t minDepth;
+    // 保存時のバケット数
+    uint64_t nwsSize, pvSize;
+    // 保存したデータ数
+    uint64_t nbNwsEntries, nbPvEntries;
+} HashFileHeader;
+
+// キャッシュファイルに保存されるデータ
+typedef struct HashFileEntry
+{
+    // 保存時のバケット位置（ハッシュコードの下位bit）
+    uint32_t bucketIndex;
+    HashData data;
+} HashFileEntry;
+
+// 読み込み用にマップしたファイル
+typedef struct HashFileMap
+{
+    const uint8 *view;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+} HashFileMap;
 
 // 空ハッシュデータ
 static const HashData EMPTY_HASH_DATA = {
-    0, 0, // stones
-    0,    // latestUsedTurn
-    0,    // cost
-    0,    // depth
+    0,           // signature
+    -MAX_VALUE,  // lower
+    MAX_VALUE,   // upper
     {
         NOMOVE_INDEX, // 1st move
-        NOMOVE_INDEX, // 2nd move
-        NOMOVE_INDEX, // 3rd move
-        NOMOVE_INDEX  // 4th move
+        NOMOVE_INDEX  // 2nd move
     },
-    -MAX_VALUE,
-    MAX_VALUE // scores
+    0, // depth
+    0, // cost
+    0  // latestUsedVersion
 };
 
 /**
@@ -59,37 +145,228 @@ static const HashData EMPTY_HASH_DATA = {
  */
 void HashInit()
 {
-    for (int row = 0; row < 8 * 2; row++)
+    for (int color = 0; color < 2; color++)
     {
-        for (int b = 0; b < (1 << 8); b++)
+        for (int pos = 0; pos < 64; pos++)
         {
             do
             {
-                RawHash[row][b] = rand64();
-            } while (CountBits(RawHash[row][b]) < RAWHASH_MIN_TRUE_BITS);
+                HashSquareKey[color][pos] = rand64();
+            } while (CountBits(HashSquareKey[color][pos]) < RAWHASH_MIN_TRUE_BITS);
+        }
+    }
+
+    // バイト値ごとの乱数は，含まれるマスの乱数のXORにしておく（差分更新と結果を一致させるため）
+    for (int row = 0; row < 8; row++)
+    {
+        for (int b = 0; b < (1 << 8); b++)
+        {
+            RawHash[row][b] = 0;
+            RawHash[8 + row][b] = 0;
+            for (int col = 0; col < 8; col++)
+            {
+                if (b & (1 << col))
+                {
+                    RawHash[row][b] ^= HashSquareKey[0][row * 8 + col];
+                    RawHash[8 + row][b] ^= HashSquareKey[1][row * 8 + col];
+                }
+            }
+            HashFlipKey[row][b] = RawHash[row][b] ^ RawHash[8 + row][b];
         }
     }
 }
 
+#ifdef _WIN32
+/**
+ * @brief ラージページの利用に必要な権限(SeLockMemoryPrivilege)を有効にする
+ * 
+ * @return bool 有効にできたか
+ */
+static bool EnableLockMemoryPrivilege()
+{
+    HANDLE token;
+    TOKEN_PRIVILEGES privileges;
+    bool enabled;
+
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+    {
+        return false;
+    }
+    privileges.PrivilegeCount = 1;
+    privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    enabled = LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid) &&
+              AdjustTokenPrivileges(token, FALSE, &privileges, 0, NULL, NULL) &&
+              GetLastError() == ERROR_SUCCESS;
+    CloseHandle(token);
+    return enabled;
+}
+#endif
+
+/**
+ * @brief ハッシュ表用のメモリを確保する
+ * 
+ * ラージページでの確保を試し，失敗したら通常ページで確保する。
+ * 確保したメモリはページ境界に整列され，0で初期化されている。
+ * 
+ * @param table 確保先のハッシュ表(memorySizeに確保するサイズを設定しておく)
+ * @return void* 確保したメモリ(失敗時はNULL)
+ */
+static void *HashMemoryAlloc(HashTable *table)
+{
+    void *memory = NULL;
+    table->isLargePage = false;
+
+#ifdef _WIN32
+    SIZE_T largePageSize = GetLargePageMinimum();
+    if (largePageSize > 0 && table->memorySize % largePageSize == 0 && EnableLockMemoryPrivilege())
+    {
+        memory = VirtualAlloc(NULL, table->memorySize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        table->isLargePage = (memory != NULL);
+    }
+    if (memory == NULL)
+    {
+        memory = VirtualAlloc(NULL, table->memorySize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+#else
+#ifdef MAP_HUGETLB
+    // 予約済みのラージページがあれば使う
+    if (table->memorySize % LARGE_PAGE_SIZE == 0)
+    {
+        memory = mmap(NULL, table->memorySize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory == MAP_FAILED)
+        {
+            memory = NULL;
+        }
+        table->isLargePage = (memory != NULL);
+    }
+#endif
+    if (memory == NULL)
+    {
+        // 通常ページで確保して，Transparent Huge Pageの利用をカーネルに依頼する
+        // THPは2MB境界から割り当てられるので，余分に確保して先頭を揃える
+        size_t mapSize = table->memorySize;
+        if (mapSize >= LARGE_PAGE_SIZE)
+        {
+            mapSize += LARGE_PAGE_SIZE;
+        }
+        uint8 *raw = (uint8 *)mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED)
+        {
+            return NULL;
+        }
+        memory = raw;
+        if (mapSize != table->memorySize)
+        {
+            uint8 *aligned = (uint8 *)(((uintptr_t)raw + LARGE_PAGE_SIZE - 1) & ~(uintptr_t)(LARGE_PAGE_SIZE - 1));
+            if (aligned != raw)
+            {
+                munmap(raw, aligned - raw);
+            }
+            if (raw + mapSize != aligned + table->memorySize)
+            {
+                munmap(aligned + table->memorySize, (raw + mapSize) - (aligned + table->memorySize));
+            }
+            memory = aligned;
+        }
+#ifdef MADV_HUGEPAGE
+        madvise(memory, table->memorySize, MADV_HUGEPAGE);
+#endif
+    }
+#endif
+    return memory;
+}
+
+/**
+ * @brief メモリサイズ[MB]に収まる最大のバケット数を計算
+ * 
+ * @param sizeMB メモリサイズ[MB]
+ * @return uint64_t バケット数(2のべき乗)
+ */
+uint64_t HashTableSizeFromMB(size_t sizeMB)
+{
+    uint64_t nbBuckets = ((uint64_t)sizeMB << 20) / sizeof(HashBucket);
+    uint64_t size = 1;
+    while (size * 2 <= nbBuckets)
+    {
+        size *= 2;
+    }
+    return size;
+}
+
 /**
  * @brief ハッシュ表のメモリ確保
  * 
+ * 確保できなければ半分のサイズで確保し直す（表が空のままにならないように）。
+ * 
  * @param table 初期化するハッシュ表
- * @param size ハッシュ表の要素数
+ * @param size ハッシュ表のバケット数
+ * @return bool 指定サイズで確保できたか
  */
-void HashTableInit(HashTable *table, uint64_t size)
+bool HashTableInit(HashTable *table, uint64_t size)
 {
-    table->size = size;
+    assert(sizeof(HashBucket) == CACHE_LINE_SIZE);
     table->version = 0;
-    table->data = (HashData *)calloc(table->size, sizeof(HashData));
-    if (table->data == NULL)
+    for (table->size = size; table->size > 0; table->size /= 2)
+    {
+        table->memorySize = table->size * sizeof(HashBucket);
+        table->buckets = (HashBucket *)HashMemoryAlloc(table);
+        if (table->buckets != NULL)
+        {
+            break;
+        }
+    }
+    if (table->buckets == NULL)
     {
         printf("ハッシュデータ配列のメモリ確保失敗\n");
-        return;
+        table->size = 0;
+        table->memorySize = 0;
+        return false;
+    }
+    if (table->size != size)
+    {
+        printf("ハッシュデータ配列のメモリ確保失敗: %u[MB]に縮小しました\n", (unsigned int)(table->memorySize >> 20));
     }
     // 2の冪乗サイズにすることでモジュロ演算をビットマスクに省略
     // indexを求めるとき，2の冪乗サイズで次式が同じ値を返す (code % size == code & (size-1))
     assert(CountBits(table->size) == 1);
+    return table->size == size;
+}
+
+/**
+ * @brief ハッシュ表のサイズ変更
+ * 
+ * 新しい表を確保できてから古い表を解放するので，確保に失敗しても古い表をそのまま使い続けられる。
+ * 確保し直した表は空になる。探索スレッドが停止している間に呼び出すこと。
+ * 
+ * @param table ハッシュ表
+ * @param size 新しいバケット数
+ * @return bool 指定サイズにできたか（失敗時は古い表のまま）
+ */
+bool HashTableResize(HashTable *table, uint64_t size)
+{
+    HashTable resized[1];
+
+    if (size == table->size && table->buckets != NULL)
+    {
+        return true;
+    }
+    assert(sizeof(HashBucket) == CACHE_LINE_SIZE);
+    resized->size = size;
+    resized->memorySize = size * sizeof(HashBucket);
+    resized->buckets = (HashBucket *)HashMemoryAlloc(resized);
+    if (resized->buckets == NULL)
+    {
+        printf("ハッシュデータ配列のメモリ確保失敗: サイズを変更しません\n");
+        return false;
+    }
+
+    HashTableFree(table);
+    table->buckets = resized->buckets;
+    table->memorySize = resized->memorySize;
+    table->isLargePage = resized->isLargePage;
+    table->size = resized->size;
+    HashTableReset(table);
+    return true;
 }
 
 /**
@@ -99,36 +376,98 @@ void HashTableInit(HashTable *table, uint64_t size)
  */
 void HashTableFree(HashTable *table)
 {
-    free(table->data);
+    if (table->buckets != NULL)
+    {
+#ifdef _WIN32
+        VirtualFree(table->buckets, 0, MEM_RELEASE);
+#else
+        munmap(table->buckets, table->memorySize);
+#endif
+    }
+    table->buckets = NULL;
+    table->memorySize = 0;
     table->size = 0;
 }
 
 /**
- * @brief ハッシュ表の複製
+ * @brief バケットへの書き込み権を取得する
  * 
- * @param src 複製元のハッシュ表
- * @param dst 上書きされるハッシュ表
+ * 他スレッドが書き込み中の場合は待たずに失敗する。
+ * 
+ * @param bucket 書き込むバケット
+ * @return bool 取得できたか
  */
-void HashTableClone(HashTable *src, HashTable *dst)
+static bool HashBucketTryLock(HashBucket *bucket)
 {
-    dst->size = src->size;
-    for (size_t i = 0; i < src->size; i++)
+    int32_t seq = AtomicLoad32(&bucket->seq);
+    if (seq & 1)
     {
-        dst->data[i] = src->data[i];
+        return false;
     }
-    dst->version = src->version;
+    return AtomicCompareExchange32(&bucket->seq, seq + 1, seq) == seq;
+}
+
+/**
+ * @brief バケットへの書き込み権を開放する
+ * 
+ * @param bucket 書き込みを終えたバケット
+ */
+static void HashBucketUnlock(HashBucket *bucket)
+{
+    AtomicIncrement32(&bucket->seq);
+}
+
+/**
+ * @brief バケット内から指定シグネチャのデータを探してコピーする
+ * 
+ * 書き込み途中のバケットや，読み込み中に書き換えられたバケットは見つからなかったものとして扱う
+ * 
+ * @param bucket 検索するバケット
+ * @param signature ハッシュコードのシグネチャ
+ * @param copy コピー先
+ * @return int 見つかったデータのバケット内位置(見つからなければ-1)
+ */
+static int HashBucketLoad(const HashBucket *bucket, const uint32_t signature, HashData *copy)
+{
+    int found = -1;
+    int32_t seq = AtomicLoad32(&bucket->seq);
+    if (seq & 1)
+    {
+        return -1;
+    }
+    for (int i = 0; i < HASH_BUCKET_NB_DATA; i++)
+    {
+        if (bucket->data[i].signature == signature && bucket->data[i].depth != 0)
+        {
+            *copy = bucket->data[i];
+            found = i;
+            break;
+        }
+    }
+    AtomicFenceAcquire();
+    if (seq != AtomicLoad32(&bucket->seq))
+    {
+        return -1;
+    }
+    return found;
 }
 
 /**
  * @brief ハッシュ表のリセット
  * 
+ * 探索スレッドが停止している間に呼び出すこと
+ * 
  * @param table リセットするハッシュ表
  */
 void HashTableReset(HashTable *table)
 {
     for (size_t i = 0; i < table->size; i++)
     {
-        table->data[i] = EMPTY_HASH_DATA;
+        table->buckets[i].seq = 0;
+        for (int j = 0; j < HASH_BUCKET_NB_DATA; j++)
+        {
+            table->buckets[i].data[j] = EMPTY_HASH_DATA;
+        }
     }
     table->version = 0;
     HASH_STATS(HashTableResetStats(table);)
@@ -137,30 +476,35 @@ void HashTableReset(HashTable *table)
 /**
  * @brief ハッシュ表のバージョンアップ
  * 
+ * データには下位bitのみ記録し，表のバージョンとの差(mod 16)を経過時間とみなす
+ * 
  * @param table ハッシュ表
  */
 void HashTableVersionUp(HashTable *table)
 {
     table->version++;
-    if (table->version >= 255)
-    {
-        HashTableReset(table);
-    }
 }
 
 /**
  * @brief 中盤 ⇔ 終盤切替時，予想最善手を残してスコアのみをリセット
  * 
+ * 探索スレッドが停止している間に呼び出すこと
+ * 
  * @param table スコアをリセットするハッシュ表
  */
 void HashTableResetScoreWindows(HashTable *table)
 {
+    HashData *data;
     for (size_t i = 0; i < table->size; i++)
     {
-        if (table->data[i].depth != 0)
+        for (int j = 0; j < HASH_BUCKET_NB_DATA; j++)
         {
-            table->data[i].lower = -MAX_VALUE;
-            table->data[i].upper = MAX_VALUE;
+            data = &table->buckets[i].data[j];
+            if (data->depth != 0)
+            {
+                data->lower = -MAX_VALUE;
+                data->upper = MAX_VALUE;
+            }
         }
     }
 }
@@ -172,24 +516,35 @@ void HashTableResetScoreWindows(HashTable *table)
  */
 void HashTableResetStats(HashTable *table)
 {
+#ifdef HASH_STATS_ENABLED
+    table->nbProbe = 0;
+    table->nbHit = 0;
     table->nbUsed = 0;
-    table->nb2ndUsed = 0;
     table->nbCollide = 0;
-    table->nbHit = 0;
-    table->nb2ndHit = 0;
+#else
+    (void)table;
+#endif
 }
 
 /**
  * @brief ハッシュデータの優先度を計算
  * 
+ * 最近使われたデータほど，次に探索コストが大きいほど，次に探索深度が深いほど優先度が高い。
+ * 空データは常に最低の優先度。
+ * 
  * @param data ハッシュデータ
- * @return uint64_t 優先度
+ * @param version ハッシュ表のバージョン
+ * @return uint32_t 優先度
  */
-uint64_t HashDataCalcPriority(HashData *data)
+static uint32_t HashDataCalcPriority(const HashData *data, const uint8 version)
 {
-    // TODO: 探索コストを優先度計算に含める
-    uint64_t priority = (uint64_t)data->latestUsedVersion << 56ULL | (uint64_t)data->cost << 48ULL | (uint64_t)data->depth << 40ULL;
-    return priority;
+    if (data->depth == 0)
+    {
+        return 0;
+    }
+    uint32_t age = (version - data->latestUsedVersion) & HASH_VERSION_MASK;
+    uint32_t priority = (HASH_VERSION_MASK - age) << 16 | (uint32_t)data->cost << 8 | (uint32_t)data->depth;
+    return priority + 1;
 }
 
 /**
@@ -227,42 +582,58 @@ inline uint64_t GetHashCode(Stones *stones)
     return code;
 }
 
+/**
+ * @brief 盤面からハッシュコードの組を計算する
+ * 
+ * 探索開始時に一度だけ計算し，以降はHashCodeUpdate/HashCodeSwapで差分更新する
+ * 
+ * @param hashCode ハッシュコードの組（[0]:盤面，[1]:手番を入れ替えた盤面）
+ * @param stones 盤面の石情報
+ */
+void HashCodeInit(uint64_t hashCode[2], Stones *stones)
+{
+    Stones swapped[1] = {*stones};
+    StonesSwap(swapped);
+    hashCode[0] = GetHashCode(stones);
+    hashCode[1] = GetHashCode(swapped);
+}
+
 /**
  * @brief ハッシュ表内から，指定盤面のハッシュデータを取得
  * 
+ * 他スレッドに書き換えられても良いように，見つかったデータはhashDataへコピーして返す
+ * 
  * @param table ハッシュ表
- * @param stones 盤面情報
+ * @param hashCode 盤面のハッシュコード
  * @param depth 探索深度
- * @param hashCode ハッシュコード
- * @return HashData* 取得したハッシュデータ
+ * @param hashData 取得したデータのコピー先
+ * @return HashData* 取得したハッシュデータ(hashData)，見つからなければNULL
  */
-HashData *HashTableGetData(HashTable *table, Stones *stones, uint8 depth, uint64_t *hashCode)
+HashData *HashTableGetData(HashTable *table, uint64_t hashCode, uint8 depth, HashData *hashData)
 {
-    // ハッシュコード取得
-    *hashCode = GetHashCode(stones);
     // サイズでモジュロ演算(code % size)
-    uint64_t index = *hashCode & (table->size - 1);
-    HashData *data = &table->data[index];
-    HashData *secondData;
+    HashBucket *bucket = &table->buckets[hashCode & (table->size - 1)];
+    uint8 version = table->version & HASH_VERSION_MASK;
+    int found;
 
-    // データの衝突チェック（同じ盤面かどうかで確認）
-    if (data->own == stones->own && data->opp == stones->opp)
+    HASH_STATS(table->nbProbe++;)
+    found = HashBucketLoad(bucket, HASH_SIGNATURE(hashCode), hashData);
+    if (found < 0)
     {
-        HASH_STATS(table->nbHit++;)
-        data->latestUsedVersion = table->version;
-        return data;
+        return NULL;
     }
+    HASH_STATS(table->nbHit++;)
 
-    // インデックスを再計算して再取得を試す
-    secondData = &table->data[RETRY_HASH(index)];
-    if (secondData->own == stones->own && secondData->opp == stones->opp)
+    // 最終使用バージョンを更新（書き込み権が取れなければ優先度が少し古くなるだけなので諦める）
+    if (hashData->latestUsedVersion != version && HashBucketTryLock(bucket))
     {
-        HASH_STATS(table->nb2ndHit++;)
-        secondData->latestUsedVersion = table->version;
-        return secondData;
+        if (bucket->data[found].signature == hashData->signature)
+        {
+            bucket->data[found].latestUsedVersion = version;
+        }
+        HashBucketUnlock(bucket);
     }
-
-    return NULL;
+    return hashData;
 }
 
 /**
@@ -276,21 +647,8 @@ bool IsHashTableContains(HashTable *table, Stones *stones)
 {
     // ハッシュコード取得
     uint64_t hashCode = GetHashCode(stones);
-    // サイズでモジュロ演算(code % size)
-    uint64_t index = hashCode & (table->size - 1);
-
-    HashData *data = &table->data[index];
-    if (data->own == stones->own && data->opp == stones->opp)
-    {
-        return true;
-    }
-
-    data = &table->data[RETRY_HASH(index)];
-    if (data->own == stones->own && data->opp == stones->opp)
-    {
-        return true;
-    }
-    return false;
+    HashData data;
+    return HashBucketLoad(&table->buckets[hashCode & (table->size - 1)], HASH_SIGNATURE(hashCode), &data) >= 0;
 }
 
 /**
@@ -367,7 +725,7 @@ bool IsHashCutNullWindow(HashData *hashData, const uint8 depth, const score_t al
  * @brief ハッシュデータを新しいデータで上書きする
  * 
  * @param data 上書きするデータ
- * @param stones 盤面石情報
+ * @param signature ハッシュコードのシグネチャ
  * @param bestMove 予測される最善手
  * @param version ハッシュ表のバージョン
  * @param cost 探索コスト
@@ -376,7 +734,7 @@ bool IsHashCutNullWindow(HashData *hashData, const uint8 depth, const score_t al
  * @param beta ベータ値
  * @param maxScore 最大探索スコア
  */
-void HashDataSaveNew(HashData *data, const Stones *stones, const uint8 bestMove, const uint8 version, const uint8 cost, const uint8 depth, const score_t alpha, const score_t beta, const score_t maxScore)
+void HashDataSaveNew(HashData *data, const uint32_t signature, const uint8 bestMove, const uint8 version, const uint8 cost, const uint8 depth, const score_t alpha, const score_t beta, const score_t maxScore)
 {
     if (maxScore < beta)
         data->upper = maxScore;
@@ -393,11 +751,8 @@ void HashDataSaveNew(HashData *data, const Stones *stones, const uint8 bestMove,
     else
         data->bestMoves[0] = NOMOVE_INDEX;
 
-    data->own = stones->own;
-    data->opp = stones->opp;
+    data->signature = signature;
     data->bestMoves[1] = NOMOVE_INDEX;
-    data->bestMoves[2] = NOMOVE_INDEX;
-    data->bestMoves[3] = NOMOVE_INDEX;
     data->latestUsedVersion = version;
     data->cost = cost;
     data->depth = depth;
@@ -411,7 +766,6 @@ void HashDataSaveNew(HashData *data, const Stones *stones, const uint8 bestMove,
  * @param bestMove 見つかった最善手
  * @param version ハッシュ表のバージョン
  * @param cost 探索コスト
- * @param depth 探索深度
  * @param alpha アルファ値
  * @param beta ベータ値
  * @param maxScore 最善手のスコア
@@ -426,8 +780,6 @@ void HashDataUpdate(HashData *data, const uint8 bestMove, const uint8 version, c
 
     if ((maxScore > alpha || maxScore == -MAX_VALUE) && data->bestMoves[0] != bestMove)
     {
-        data->bestMoves[3] = data->bestMoves[2];
-        data->bestMoves[2] = data->bestMoves[1];
         data->bestMoves[1] = data->bestMoves[0];
         data->bestMoves[0] = bestMove;
     }
@@ -461,15 +813,11 @@ void HashDataLevelUP(HashData *data, const uint8 bestMove, const uint8 version,
 
     if (maxScore > alpha || maxScore == -MAX_VALUE)
     {
-        data->bestMoves[3] = data->bestMoves[2];
-        data->bestMoves[2] = data->bestMoves[1];
         data->bestMoves[1] = data->bestMoves[0];
         data->bestMoves[0] = bestMove;
     }
     else
     {
-        data->bestMoves[3] = NOMOVE_INDEX;
-        data->bestMoves[2] = NOMOVE_INDEX;
         data->bestMoves[1] = NOMOVE_INDEX;
         data->bestMoves[0] = NOMOVE_INDEX;
     }
@@ -484,7 +832,6 @@ void HashDataLevelUP(HashData *data, const uint8 bestMove, const uint8 version,
  * @brief ハッシュ表内の特定データを更新
  * 
  * @param hashData ハッシュデータ
- * @param stones 盤面石情報
  * @param bestMove 予想最善手
  * @param version ハッシュ表のバージョン
  * @param cost 探索コスト
@@ -492,38 +839,33 @@ void HashDataLevelUP(HashData *data, const uint8 bestMove, const uint8 version,
  * @param alpha アルファ値
  * @param beta ベータ値
  * @param maxScore 予想最善スコア
- * @return bool 更新できたか
  */
-bool HashTableUpdateData(HashData *hashData, const Stones *stones, const uint8 bestMove, const uint8 version, const uint8 cost, const uint8 depth, const score_t alpha, const score_t beta, const score_t maxScore)
+void HashTableUpdateData(HashData *hashData, const uint8 bestMove, const uint8 version, const uint8 cost, const uint8 depth, const score_t alpha, const score_t beta, const score_t maxScore)
 {
-    if (hashData->own == stones->own && hashData->opp == stones->opp)
+    if (depth == hashData->depth)
     {
-        if (depth == hashData->depth)
-        {
-            HashDataUpdate(hashData, bestMove, version, cost, alpha, beta, maxScore);
-            if (hashData->lower > hashData->upper)
-            {
-                HashDataSaveNew(hashData, stones, bestMove, version, cost, depth, alpha, beta, maxScore);
-            }
-        }
-        else
+        HashDataUpdate(hashData, bestMove, version, cost, alpha, beta, maxScore);
+        if (hashData->lower > hashData->upper)
         {
-            HashDataLevelUP(hashData, bestMove, version, cost, depth, alpha, beta, maxScore);
+            HashDataSaveNew(hashData, hashData->signature, bestMove, version, cost, depth, alpha, beta, maxScore);
         }
-        return true;
     }
-    return false;
+    else
+    {
+        HashDataLevelUP(hashData, bestMove, version, cost, depth, alpha, beta, maxScore);
+    }
 }
 
 /**
  * @brief ハッシュ表に探索情報を記録する
  * 
- * 探索情報によって優先度付けを行い，衝突した際は優先度の高い方を記録する。
+ * 同じ盤面のデータがバケット内にあれば更新し，
+ * なければバケット内で最も優先度の低いデータを上書きする。
  * 新しいデータは必ず記録される。
+ * ただし，他スレッドが書き込み中のバケットに当たった場合は記録を諦める。
  * 
  * @param table ハッシュ表
  * @param hashCode ハッシュコード
- * @param stones 盤面石情報
  * @param bestMove 予測される最善手
  * @param cost 探索コスト
  * @param depth 探索深度
@@ -531,43 +873,334 @@ bool HashTableUpdateData(HashData *hashData, const Stones *stones, const uint8 b
  * @param in_beta ベータ値
  * @param maxScore 最大スコア
  */
-void HashTableRegist(HashTable *table, uint64_t hashCode, Stones *stones, uint8 bestMove, uint8 cost, uint8 depth, score_t in_alpha, score_t in_beta, score_t maxScore)
+void HashTableRegist(HashTable *table, uint64_t hashCode, uint8 bestMove, uint8 cost, uint8 depth, score_t in_alpha, score_t in_beta, score_t maxScore)
 {
-    uint64_t index = hashCode & (table->size - 1);
-    HashData *secondData, *dataToUpdate;
-    uint8 version = table->version;
+    HashBucket *bucket = &table->buckets[hashCode & (table->size - 1)];
+    const uint32_t signature = HASH_SIGNATURE(hashCode);
+    const uint8 version = table->version & HASH_VERSION_MASK;
+    HashData *data, *dataToUpdate;
+    uint32_t priority, minPriority;
 
-    // ハッシュの更新を試す
-    HashData *hashData = &table->data[index];
-    if (HashTableUpdateData(hashData, stones, bestMove, version, cost, depth, in_alpha, in_beta, maxScore))
+    if (!HashBucketTryLock(bucket))
     {
         return;
     }
 
-    // 更新できなかったらインデックスを再計算
-    secondData = &table->data[RETRY_HASH(index)];
-    if (HashTableUpdateData(secondData, stones, bestMove, version, cost, depth, in_alpha, in_beta, maxScore))
+    // 同じ盤面のデータがあれば更新，なければ優先度の最も低いデータを探す
+    dataToUpdate = NULL;
+    minPriority = UINT32_MAX;
+    for (int i = 0; i < HASH_BUCKET_NB_DATA; i++)
+    {
+        data = &bucket->data[i];
+        if (data->signature == signature && data->depth != 0)
+        {
+            HashTableUpdateData(data, bestMove, version, cost, depth, in_alpha, in_beta, maxScore);
+            HashBucketUnlock(bucket);
+            return;
+        }
+        priority = HashDataCalcPriority(data, version);
+        if (priority < minPriority)
+        {
+            minPriority = priority;
+            dataToUpdate = data;
+        }
+    }
+
+    HASH_STATS(
+        if (dataToUpdate->depth == 0) {
+            table->nbUsed++;
+        } else {
+            table->nbCollide++;
+        } //
+    )
+    HashDataSaveNew(dataToUpdate, signature, bestMove, version, cost, depth, in_alpha, in_beta, maxScore);
+    HashBucketUnlock(bucket);
+}
+
+/**
+ * @brief 指定深度以上のデータをファイルへ書き出す
+ * 
+ * @param table ハッシュ表(NULLなら何も書き出さない)
+ * @param fp 書き込み先
+ * @param minDepth 書き出すデータの最小探索深度
+ * @return uint64_t 書き出したデータ数
+ */
+static uint64_t HashTableWriteEntries(HashTable *table, FILE *fp, uint8 minDepth)
+{
+    HashFileEntry entry;
+    uint64_t nbEntries = 0;
+
+    if (table == NULL || table->buckets == NULL)
+    {
+        return 0;
+    }
+    for (uint64_t i = 0; i < table->size; i++)
+    {
+        for (int j = 0; j < HASH_BUCKET_NB_DATA; j++)
+        {
+            const HashData *data = &table->buckets[i].data[j];
+            if (data->depth == 0 || data->depth < minDepth)
+            {
+                continue;
+            }
+            entry.bucketIndex = (uint32_t)i;
+            entry.data = *data;
+            if (fwrite(&entry, sizeof(HashFileEntry), 1, fp) != 1)
+            {
+                return nbEntries;
+            }
+            nbEntries++;
+        }
+    }
+    return nbEntries;
+}
+
+/**
+ * @brief ハッシュ表の内容をファイルへ保存する
+ * 
+ * 浅いデータは再探索のほうが安いので，minDepth以上のデータのみ保存する
+ * 
+ * @param file 保存先のファイル名
+ * @param nwsTable NWS用ハッシュ表(NULLなら保存しない)
+ * @param pvTable PV用ハッシュ表(NULLなら保存しない)
+ * @param modelChecksum 評価モデルのチェックサム
+ * @param isEndScore 終盤探索のスコアか
+ * @param minDepth 保存するデータの最小探索深度
+ * @return bool 保存できたか
+ */
+bool HashTableSaveFile(const char *file, HashTable *nwsTable, HashTable *pvTable, uint32_t modelChecksum, bool isEndScore, uint8 minDepth)
+{
+    HashFileHeader header;
+    bool succeeded;
+    FILE *fp = fopen(file, "wb");
+    if (fp == NULL)
+    {
+        fputs("置換表キャッシュファイルのオープンに失敗しました。\n", stderr);
+        return false;
+    }
+
+    header.magic = HASH_FILE_MAGIC;
+    header.version = HASH_FILE_VERSION;
+    header.dataSize = sizeof(HashData);
+    header.modelChecksum = modelChecksum;
+    header.isEndScore = isEndScore;
+    header.minDepth = minDepth;
+    header.nwsSize = (nwsTable != NULL) ? nwsTable->size : 0;
+    header.pvSize = (pvTable != NULL) ? pvTable->size : 0;
+    header.nbNwsEntries = 0;
+    header.nbPvEntries = 0;
+
+    // データ数は書き出した後にヘッダを書き直して記録する
+    succeeded = fwrite(&header, sizeof(HashFileHeader), 1, fp) == 1;
+    if (succeeded)
+    {
+        header.nbNwsEntries = HashTableWriteEntries(nwsTable, fp, minDepth);
+        header.nbPvEntries = HashTableWriteEntries(pvTable, fp, minDepth);
+        succeeded = !ferror(fp) &&
+                    fseek(fp, 0, SEEK_SET) == 0 &&
+                    fwrite(&header, sizeof(HashFileHeader), 1, fp) == 1;
+    }
+    if (fclose(fp) == EOF || !succeeded)
+    {
+        fputs("置換表キャッシュファイルへの書き込みに失敗しました。\n", stderr);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief ファイルを読み込み専用でメモリにマップする
+ * 
+ * @param map マップ情報の格納先
+ * @param file ファイル名
+ * @return bool マップできたか
+ */
+static bool HashFileMapOpen(HashFileMap *map, const char *file)
+{
+    map->view = NULL;
+    map->size = 0;
+#ifdef _WIN32
+    LARGE_INTEGER fileSize;
+    map->mapping = NULL;
+    map->file = CreateFileA(file, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (map->file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    if (GetFileSizeEx(map->file, &fileSize) && fileSize.QuadPart > 0)
+    {
+        map->mapping = CreateFileMappingA(map->file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (map->mapping != NULL)
+        {
+            map->view = (const uint8 *)MapViewOfFile(map->mapping, FILE_MAP_READ, 0, 0, 0);
+            map->size = (size_t)fileSize.QuadPart;
+        }
+    }
+    if (map->view == NULL)
+    {
+        if (map->mapping != NULL)
+        {
+            CloseHandle(map->mapping);
+        }
+        CloseHandle(map->file);
+        return false;
+    }
+#else
+    struct stat fileStat;
+    int fd = open(file, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0)
+    {
+        void *view = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED)
+        {
+            map->view = (const uint8 *)view;
+            map->size = (size_t)fileStat.st_size;
+        }
+    }
+    close(fd);
+    if (map->view == NULL)
+    {
+        return false;
+    }
+#endif
+    return true;
+}
+
+/**
+ * @brief マップしたファイルを閉じる
+ * 
+ * @param map マップ情報
+ */
+static void HashFileMapClose(HashFileMap *map)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(map->view);
+    CloseHandle(map->mapping);
+    CloseHandle(map->file);
+#else
+    munmap((void *)map->view, map->size);
+#endif
+    map->view = NULL;
+    map->size = 0;
+}
+
+/**
+ * @brief 保存されていたデータをバケットへ格納する
+ * 
+ * 同じ盤面のデータがあれば深いほうを残し，なければ優先度の最も低いデータを置き換える
+ * 
+ * @param bucket 格納先のバケット
+ * @param newData 保存されていたデータ
+ * @param version ハッシュ表のバージョン
+ */
+static void HashBucketStore(HashBucket *bucket, const HashData *newData, const uint8 version)
+{
+    HashData *data, *dataToUpdate = NULL;
+    uint32_t priority, minPriority = UINT32_MAX;
+
+    if (!HashBucketTryLock(bucket))
     {
         return;
     }
-    else
+    for (int i = 0; i < HASH_BUCKET_NB_DATA; i++)
     {
-        // 更新できなかったら優先度の低い方に上書き
-        if (HashDataCalcPriority(hashData) <= HashDataCalcPriority(secondData))
+        data = &bucket->data[i];
+        if (data->signature == newData->signature && data->depth != 0)
         {
-            dataToUpdate = hashData;
+            dataToUpdate = (newData->depth > data->depth) ? data : NULL;
+            break;
         }
-        else
+        priority = HashDataCalcPriority(data, version);
+        if (priority < minPriority)
         {
-            dataToUpdate = secondData;
+            minPriority = priority;
+            dataToUpdate = data;
         }
-        HASH_STATS(
-            if (dataToUpdate->depth == 0) {
-                table->nbUsed++;
-            } else {
-                table->nbCollide++;
-            } //
-        )
-        HashDataSaveNew(dataToUpdate, stones, bestMove, version, cost, depth, in_alpha, in_beta, maxScore);
     }
+    if (dataToUpdate != NULL)
+    {
+        *dataToUpdate = *newData;
+        dataToUpdate->latestUsedVersion = version;
+    }
+    HashBucketUnlock(bucket);
+}
+
+/**
+ * @brief 保存されていたデータをハッシュ表へ格納する
+ * 
+ * バケット位置は保存時の下位bitしか分からないので，保存時より大きな表には読み込まない
+ * 
+ * @param table 格納先のハッシュ表(NULLなら何もしない)
+ * @param entries 保存されていたデータ
+ * @param nbEntries データ数
+ * @param savedSize 保存時のバケット数
+ * @return bool 読み込んだか
+ */
+static bool HashTableReadEntries(HashTable *table, const HashFileEntry *entries, uint64_t nbEntries, uint64_t savedSize)
+{
+    if (table == NULL || table->buckets == NULL || table->size > savedSize)
+    {
+        return false;
+    }
+    const uint8 version = table->version & HASH_VERSION_MASK;
+    for (uint64_t i = 0; i < nbEntries; i++)
+    {
+        HashBucketStore(&table->buckets[entries[i].bucketIndex & (table->size - 1)], &entries[i].data, version);
+    }
+    return true;
+}
+
+/**
+ * @brief ファイルに保存されたハッシュ表の内容を読み込む
+ * 
+ * 形式バージョン・評価モデルが一致しないファイルは読み込まない
+ * 
+ * @param file 読み込むファイル名
+ * @param nwsTable NWS用ハッシュ表(NULLなら読み込まない)
+ * @param pvTable PV用ハッシュ表(NULLなら読み込まない)
+ * @param modelChecksum 評価モデルのチェックサム
+ * @param isEndScore 終盤探索のスコアだったかの格納先
+ * @return bool 読み込めたか
+ */
+bool HashTableLoadFile(const char *file, HashTable *nwsTable, HashTable *pvTable, uint32_t modelChecksum, bool *isEndScore)
+{
+    HashFileMap map;
+    const HashFileHeader *header;
+    const HashFileEntry *entries;
+    uint64_t maxEntries;
+    bool loaded;
+
+    if (!HashFileMapOpen(&map, file))
+    {
+        return false;
+    }
+
+    header = (const HashFileHeader *)map.view;
+    // ファイルに収まる要素数（要素数の積・和が桁あふれしないよう，掛ける前にこれと比べる）
+    maxEntries = (map.size < sizeof(HashFileHeader)) ? 0 : (map.size - sizeof(HashFileHeader)) / sizeof(HashFileEntry);
+    if (map.size < sizeof(HashFileHeader) ||
+        header->magic != HASH_FILE_MAGIC ||
+        header->version != HASH_FILE_VERSION ||
+        header->dataSize != sizeof(HashData) ||
+        header->modelChecksum != modelChecksum ||
+        header->nbNwsEntries > maxEntries ||
+        header->nbPvEntries > maxEntries ||
+        header->nbPvEntries > maxEntries - header->nbNwsEntries)
+    {
+        fputs("置換表キャッシュファイルの形式・評価モデルが一致しないため読み込みません。\n", stderr);
+        HashFileMapClose(&map);
+        return false;
+    }
+
+    entries = (const HashFileEntry *)(map.view + sizeof(HashFileHeader));
+    loaded = HashTableReadEntries(nwsTable, entries, header->nbNwsEntries, header->nwsSize);
+    loaded |= HashTableReadEntries(pvTable, entries + header->nbNwsEntries, header->nbPvEntries, header->pvSize);
+    *isEndScore = header->isEndScore != 0;
+
+    HashFileMapClose(&map);
+    return loaded;
 }
@@ -1,85 +1,221 @@
 ﻿#ifndef HASH_DEFINED
 #define HASH_DEFINED
 
+#include <xmmintrin.h>
 #include "../stones.h"
 #include "../const.h"
+#include "thread_util.h"
 
-#define NWS_TABLE_SIZE (1 << 20)
-#define PV_TABLE_SIZE (1 << 12)
-#define SHALLOW_NWS_TABLE_SIZE (1 << 12)
-#define SHALLOW_PV_TABLE_SIZE (1 << 8)
+// ハッシュ表のサイズ（バケット数，64byte/バケット）
+// NWS用ハッシュ表のサイズはSearchOption.hashSizeMBで指定する
+#define PV_TABLE_SIZE (1 << 11)
+#define SHALLOW_NWS_TABLE_SIZE (1 << 11)
+#define SHALLOW_PV_TABLE_SIZE (1 << 7)
+
+// 1エントリで保持する予想最善手の数
+#define HASH_NB_BEST_MOVES 2
+// 最終使用バージョンのビット数（表のバージョンとの差を経過時間として使う）
+#define HASH_VERSION_BITS 4
+#define HASH_VERSION_MASK ((1 << HASH_VERSION_BITS) - 1)
+
+// 置換表の利用状況の統計を取る（デバッグ用）
+// 置換表は全スレッドで共有するので，有効にすると検索のたびに同じキャッシュラインへの書き込みが競合する
+//#define HASH_STATS_ENABLED
 
 // ハッシュテーブルに格納されるデータ
-// 8x2 + 3 + 1*4 + 2x2 = 27[byte]
+// 4 + 2x2 + 1x2 + 2 = 12[byte]
 typedef struct HashData
 {
-    // 石情報(8x2[byte])
-    uint64_t own, opp;
-    // 最終使用時のハッシュ表バージョン(過去の盤面が消えていくように)
-    // 1byte
-    uint8 latestUsedVersion;
-    // 探索コスト(depthと統合したい・・・)depthは0~64, costを0~64としても127余る
-    // 25->24[byte]になればパディング含めメモリ最適化が期待できる(はず？)
-    // 1byte
-    uint8 cost;
-    // 探索深度(1byte)
-    uint8 depth;
-    // 予想最善手履歴(4byte)
-    uint8 bestMoves[4];
+    // ハッシュコードの上位32bit(盤面の照合用)(4byte)
+    // 下位bitはバケット位置に使われるので，合わせて盤面を識別する
+    uint32_t signature;
     // スコアwindow(下限値，上限値)(2x2byte)
     score_strict_t lower, upper;
+    // 予想最善手履歴(2byte)
+    uint8 bestMoves[HASH_NB_BEST_MOVES];
+    // 探索深度(0~60: 6bit)
+    uint16_t depth : 6;
+    // 探索コスト(log2(ノード数): 6bit)
+    uint16_t cost : 6;
+    // 最終使用時のハッシュ表バージョン(下位4bit，過去の盤面が消えていくように)
+    uint16_t latestUsedVersion : HASH_VERSION_BITS;
 } HashData;
 
+// 置換表キャッシュファイルの形式バージョン（HashDataやファイル構造を変えたら上げる）
+#define HASH_FILE_VERSION 1
+
+// 1バケットに格納されるデータ数
+#define HASH_BUCKET_NB_DATA 5
+
+// キャッシュライン(64byte)1本に収まるデータのまとまり
+// 4 + 12x5 = 64[byte]
+typedef struct HashBucket
+{
+    // 書き込み中は奇数になるシーケンスカウンタ(4byte)
+    // 複数スレッドで共有する置換表をロック無しで読み書きするために使う
+    atomic32_t seq;
+    HashData data[HASH_BUCKET_NB_DATA];
+} HashBucket;
+
 // ハッシュテーブル
 typedef struct HashTable
 {
-    // ハッシュデータの配列
-    HashData *data;
-    // サイズは2のべき乗
+    // バケットの配列(ページ境界に整列)
+    HashBucket *buckets;
+    // 確保したメモリのサイズ[byte]
+    size_t memorySize;
+    // ラージページで確保できたか
+    bool isLargePage;
+    // バケット数: 2のべき乗
     size_t size;
 
     // バージョン: ハッシュ表が使用された探索実行数
     uint8 version;
 
-    /* 計測用 */
-    uint64_t nbUsed;
-    uint64_t nb2ndUsed;
+#ifdef HASH_STATS_ENABLED
+    /* 計測用（スレッド間で同期しないので概算値） */
+    uint64_t nbProbe;
     uint64_t nbHit;
-    uint64_t nb2ndHit;
+    uint64_t nbUsed;
     uint64_t nbCollide;
+#endif
 } HashTable;
 
+// マスごとのハッシュ乱数[0:手番側の石, 1:相手側の石][マス]
+extern uint64_t HashSquareKey[2][64];
+// 反転石用のハッシュ乱数（手番側と相手側の乱数のXOR）[8行][列内8石のパターン]
+extern uint64_t HashFlipKey[8][1 << 8];
+
 // ハッシュキー生成用の乱数ビット列を初期化
 void HashInit();
 
-// ハッシュテーブルの初期化
-void HashTableInit(HashTable *table, uint64_t size);
+// 盤面からハッシュコードの組を計算する
+void HashCodeInit(uint64_t hashCode[2], Stones *stones);
+
+/**
+ * @brief 反転位置に対応するハッシュ乱数を取得
+ * 
+ * @param flip 反転位置
+ * @return uint64_t 反転した石のハッシュ乱数
+ */
+inline uint64_t HashFlipCode(uint64_t flip)
+{
+    const uint8 *cursor = (uint8 *)(&flip);
+    return HashFlipKey[0][cursor[0]] ^ HashFlipKey[1][cursor[1]] ^
+           HashFlipKey[2][cursor[2]] ^ HashFlipKey[3][cursor[3]] ^
+           HashFlipKey[4][cursor[4]] ^ HashFlipKey[5][cursor[5]] ^
+           HashFlipKey[6][cursor[6]] ^ HashFlipKey[7][cursor[7]];
+}
+
+/**
+ * @brief 着手に合わせてハッシュコードを差分更新する
+ * 
+ * hashCode[0]は現在の盤面，hashCode[1]は手番を入れ替えた盤面のハッシュコード。
+ * 着手後は手番が入れ替わるので，互いの値を元に差分を適用して入れ替える。
+ * 
+ * @param hashCode ハッシュコードの組
+ * @param posIdx 着手位置
+ * @param flip 反転位置
+ */
+inline void HashCodeUpdate(uint64_t hashCode[2], uint8 posIdx, uint64_t flip)
+{
+    const uint64_t flipCode = HashFlipCode(flip);
+    const uint64_t code = hashCode[0];
+    hashCode[0] = hashCode[1] ^ flipCode ^ HashSquareKey[1][posIdx];
+    hashCode[1] = code ^ flipCode ^ HashSquareKey[0][posIdx];
+}
+
+/**
+ * @brief 着手前のハッシュコードに戻す
+ * 
+ * @param hashCode ハッシュコードの組
+ * @param posIdx 着手位置
+ * @param flip 反転位置
+ */
+inline void HashCodeRestore(uint64_t hashCode[2], uint8 posIdx, uint64_t flip)
+{
+    const uint64_t flipCode = HashFlipCode(flip);
+    const uint64_t code = hashCode[0];
+    hashCode[0] = hashCode[1] ^ flipCode ^ HashSquareKey[0][posIdx];
+    hashCode[1] = code ^ flipCode ^ HashSquareKey[1][posIdx];
+}
+
+/**
+ * @brief 着手後の盤面のハッシュコードを計算する（盤面は更新しない）
+ * 
+ * @param hashCode ハッシュコードの組
+ * @param posIdx 着手位置
+ * @param flip 反転位置
+ * @return uint64_t 着手後の盤面のハッシュコード
+ */
+inline uint64_t HashCodeChild(const uint64_t hashCode[2], uint8 posIdx, uint64_t flip)
+{
+    return hashCode[1] ^ HashFlipCode(flip) ^ HashSquareKey[1][posIdx];
+}
+
+/**
+ * @brief パスに合わせてハッシュコードを入れ替える
+ * 
+ * @param hashCode ハッシュコードの組
+ */
+inline void HashCodeSwap(uint64_t hashCode[2])
+{
+    const uint64_t code = hashCode[0];
+    hashCode[0] = hashCode[1];
+    hashCode[1] = code;
+}
+
+// メモリサイズ[MB]に収まる最大のバケット数
+uint64_t HashTableSizeFromMB(size_t sizeMB);
+
+// ハッシュテーブルの初期化(sizeはバケット数)
+bool HashTableInit(HashTable *table, uint64_t size);
+
+// ハッシュテーブルのサイズ変更（確保に失敗したら元の表のまま）
+bool HashTableResize(HashTable *table, uint64_t size);
 
 // ハッシュテーブルの開放
 void HashTableFree(HashTable *table);
 
-void HashTableClone(HashTable *src, HashTable *dst);
-
-// ハッシュテーブル内のデータをリセット
+// ハッシュテーブル内のデータをリセット（探索スレッド停止中のみ）
 void HashTableReset(HashTable *table);
 
+// ハッシュテーブルの内容をファイルへ保存（探索スレッド停止中のみ）
+bool HashTableSaveFile(const char *file, HashTable *nwsTable, HashTable *pvTable, uint32_t modelChecksum, bool isEndScore, uint8 minDepth);
+
+// ファイルに保存されたハッシュテーブルの内容を読み込む（探索スレッド停止中のみ）
+bool HashTableLoadFile(const char *file, HashTable *nwsTable, HashTable *pvTable, uint32_t modelChecksum, bool *isEndScore);
+
+// ハッシュテーブルのバージョンを進める（探索スレッド停止中のみ）
 void HashTableVersionUp(HashTable *table);
 
+// スコアのみをリセット（探索スレッド停止中のみ）
 void HashTableResetScoreWindows(HashTable *table);
 
 // ハッシュテーブル内の統計情報をリセット
 void HashTableResetStats(HashTable *table);
 
-//inline uint64_t GetHashCode(uint64_t own, uint64_t opp);
+/**
+ * @brief ハッシュコードに対応するバケットをキャッシュへ先読みする
+ * 
+ * 子ノードの探索前に呼んでおくことで，メモリの読み込みを盤面更新などの処理と並行させる
+ * 
+ * @param table ハッシュ表
+ * @param hashCode 先読みする盤面のハッシュコード
+ */
+inline void HashTablePrefetch(HashTable *table, uint64_t hashCode)
+{
+    _mm_prefetch((const char *)&table->buckets[hashCode & (table->size - 1)], _MM_HINT_T0);
+}
 
-// ハッシュテーブル内を検索
-HashData *HashTableGetData(HashTable *table, Stones *stones, uint8 depth, uint64_t *hashCode);
+// ハッシュテーブル内を検索（見つかったデータはhashDataへコピーされる）
+HashData *HashTableGetData(HashTable *table, uint64_t hashCode, uint8 depth, HashData *hashData);
 
 // ハッシュ内に含まれているか
 bool IsHashTableContains(HashTable *table, Stones *stones);
 
 // ハッシュテーブルに追加
-void HashTableRegist(HashTable *table, uint64_t hashCode, Stones *stones, uint8 bestMove, uint8 cost, uint8 depth, score_t in_alpha, score_t in_beta, score_t maxScore);
+void HashTableRegist(HashTable *table, uint64_t hashCode, uint8 bestMove, uint8 cost, uint8 depth, score_t in_alpha, score_t in_beta, score_t maxScore);
 
 // ハッシュによる枝刈りが起こるかを返し，ハッシュテーブルに登録されている情報をalpha・beta値などに適用する
 bool IsHashCut(HashData *hashData, const uint8 depth, score_t *alpha, score_t *beta, score_t *score);
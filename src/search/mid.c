@@ -33,6 +33,7 @@
 #include "mpc.h"
 #include "hash.h"
 #include "moves.h"
+#include "search_pool.h"
 #include "../ai/eval.h"
 #include "../bit_operation.h"
 
@@ -164,9 +165,9 @@ score_t MidAlphaBetaDeep(SearchTree *tree, score_t alpha, score_t beta, unsigned
     assert(depth <= tree->orderDepth);
 
     // 盤面に対応するハッシュデータ
-    HashData *hashData = NULL;
+    HashData hashEntry[1], *hashData = NULL;
     // 盤面に対応するハッシュコード
-    uint64_t hashCode;
+    const uint64_t hashCode = tree->hashCode[0];
     // 盤面更新用のビット列
     uint64_t mob, pos, flip;
     // 一時スコア
@@ -217,7 +218,7 @@ score_t MidAlphaBetaDeep(SearchTree *tree, score_t alpha, score_t beta, unsigned
         // ハッシュを使って探索範囲を狭める・カットする
         if (tree->option.usePvHash == 1 && depth >= tree->pvHashDepth)
         {
-            hashData = HashTableGetData(tree->pvTable, tree->stones, depth, &hashCode);
+            hashData = HashTableGetData(tree->pvTable, hashCode, depth, hashEntry);
             if (hashData != NULL && IsHashCut(hashData, depth, &alpha, &beta, &score))
                 return score;
         }
@@ -265,7 +266,7 @@ score_t MidAlphaBetaDeep(SearchTree *tree, score_t alpha, score_t beta, unsigned
     // ハッシュの記録
     if (tree->option.usePvHash == 1 && depth >= tree->pvHashDepth)
     {
-        HashTableRegist(tree->pvTable, hashCode, tree->stones, bestMove, cost, depth, alpha, beta, maxScore);
+        HashTableRegist(tree->pvTable, hashCode, bestMove, cost, depth, alpha, beta, maxScore);
     }
     return maxScore;
 }
@@ -285,9 +286,9 @@ score_t MidAlphaBeta(SearchTree *tree, score_t alpha, score_t beta, unsigned cha
     // 次の探索に利用する探索関数
     SearchFunc_t NextSearch;
     // 盤面に対応するハッシュデータ
-    HashData *hashData = NULL;
+    HashData hashEntry[1], *hashData = NULL;
     // 盤面に対応するハッシュコード
-    uint64_t hashCode;
+    const uint64_t hashCode = tree->hashCode[0];
     // 着手スコア
     MoveList moveList;
     // 着手情報
@@ -334,7 +335,7 @@ score_t MidAlphaBeta(SearchTree *tree, score_t alpha, score_t beta, unsigned cha
         // ハッシュを使って探索範囲を狭める・カットする
         if (tree->option.usePvHash == 1 && depth >= tree->pvHashDepth)
         {
-            hashData = HashTableGetData(tree->pvTable, tree->stones, depth, &hashCode);
+            hashData = HashTableGetData(tree->pvTable, hashCode, depth, hashEntry);
             if (hashData != NULL && IsHashCut(hashData, depth, &alpha, &beta, &score))
                 return score;
         }
@@ -386,7 +387,7 @@ score_t MidAlphaBeta(SearchTree *tree, score_t alpha, score_t beta, unsigned cha
     // ハッシュの記録
     if (tree->option.usePvHash == 1 && depth >= tree->pvHashDepth)
     {
-        HashTableRegist(tree->pvTable, hashCode, tree->stones, bestMove, cost, depth, alpha, beta, maxScore);
+        HashTableRegist(tree->pvTable, hashCode, bestMove, cost, depth, alpha, beta, maxScore);
     }
     return maxScore;
 }
@@ -413,9 +414,9 @@ score_t MidNullWindowDeep(SearchTree *tree, const score_t beta, unsigned char de
     // アルファ値
     const score_t alpha = beta - 1;
     // 盤面に対応するハッシュデータ
-    HashData *hashData = NULL;
+    HashData hashEntry[1], *hashData = NULL;
     // 盤面に対応するハッシュコード
-    uint64_t hashCode;
+    const uint64_t hashCode = tree->hashCode[0];
     // 盤面更新用のビット列
     uint64_t mob, pos, flip;
     // 一時スコア
@@ -459,7 +460,7 @@ score_t MidNullWindowDeep(SearchTree *tree, const score_t beta, unsigned char de
         // ハッシュを使って探索範囲を狭める・カットする
         if (tree->option.useHash == 1 && depth >= tree->hashDepth DONT_USE_MPC_HASH(&&tree->nbMpcNested == 0))
         {
-            hashData = HashTableGetData(tree->nwsTable, tree->stones, depth, &hashCode);
+            hashData = HashTableGetData(tree->nwsTable, hashCode, depth, hashEntry);
             if (hashData != NULL && IsHashCutNullWindow(hashData, depth, alpha, &score) DONT_CUT_MPC_HASH(&&tree->nbMpcNested == 0))
                 return score;
         }
@@ -497,7 +498,7 @@ score_t MidNullWindowDeep(SearchTree *tree, const score_t beta, unsigned char de
     // ハッシュに記録
     if (tree->option.useHash == 1 && depth >= tree->hashDepth DONT_REGIST_MPC_HASH(&&tree->nbMpcNested == 0))
     {
-        HashTableRegist(tree->nwsTable, hashCode, tree->stones, bestMove, cost, depth, alpha, beta, maxScore);
+        HashTableRegist(tree->nwsTable, hashCode, bestMove, cost, depth, alpha, beta, maxScore);
     }
     return maxScore;
 }
@@ -526,9 +527,9 @@ score_t MidNullWindow(SearchTree *tree, const score_t beta, unsigned char depth,
     // 次の探索に利用する探索関数
     SearchFuncNullWindow_t NextNullSearch;
     // 盤面に対応するハッシュデータ
-    HashData *hashData = NULL;
+    HashData hashEntry[1], *hashData = NULL;
     // 盤面に対応するハッシュコード
-    uint64_t hashCode;
+    const uint64_t hashCode = tree->hashCode[0];
     // 着手リスト
     MoveList moveList;
     // 着手情報
@@ -559,7 +560,7 @@ score_t MidNullWindow(SearchTree *tree, const score_t beta, unsigned char depth,
     // ハッシュを使って過去に探索した枝は省略
     if (tree->option.useHash == 1 && depth >= tree->hashDepth DONT_USE_MPC_HASH(&&tree->nbMpcNested == 0))
     {
-        hashData = HashTableGetData(tree->nwsTable, tree->stones, depth, &hashCode);
+        hashData = HashTableGetData(tree->nwsTable, hashCode, depth, hashEntry);
         if (hashData != NULL && IsHashCutNullWindow(hashData, depth, alpha, &score) DONT_CUT_MPC_HASH(&&tree->nbMpcNested == 0))
             return score;
     }
@@ -593,6 +594,13 @@ score_t MidNullWindow(SearchTree *tree, const score_t beta, unsigned char depth,
     }
     else
     { // 着手できる場所がある時
+        // 子ノードの置換表でカット
+        if (tree->option.useHash == 1 && depth >= tree->option.midEtcDepth DONT_CUT_MPC_HASH(&&tree->nbMpcNested == 0) &&
+            SearchEnhancedTransCut(tree, &moveList, depth, beta, &score))
+        {
+            return score;
+        }
+
         // Multi Prob Cut
         if (tree->option.useMPC && NullWindowMultiProbCut(tree, alpha, depth, &score))
         {
@@ -606,6 +614,7 @@ score_t MidNullWindow(SearchTree *tree, const score_t beta, unsigned char depth,
         maxScore = -MAX_VALUE;
         for (move = NextBestMoveWithSwap(moveList.moves); move != NULL; move = NextBestMoveWithSwap(move))
         {
+            SearchPrefetchChild(tree, move, depth - 1, false);
             SearchUpdateMid(tree, move);
             { // 子ノードを探索
                 score = -NextNullSearch(tree, -alpha, depth - 1, false);
@@ -630,7 +639,7 @@ score_t MidNullWindow(SearchTree *tree, const score_t beta, unsigned char depth,
     // ハッシュ表に登録
     if (tree->option.useHash == 1 && depth >= tree->hashDepth DONT_REGIST_MPC_HASH(&&tree->nbMpcNested == 0))
     {
-        HashTableRegist(tree->nwsTable, hashCode, tree->stones, bestMove, cost, depth, alpha, beta, maxScore);
+        HashTableRegist(tree->nwsTable, hashCode, bestMove, cost, depth, alpha, beta, maxScore);
     }
     return maxScore;
 }
@@ -659,9 +668,9 @@ score_t MidPVS(SearchTree *tree, const score_t in_alpha, const score_t in_beta,
     // 次に使用する探索関数
     SearchFunc_t NextSearch;
     // 盤面に対応するハッシュデータ
-    HashData *hashData = NULL;
+    HashData hashEntry[1], *hashData = NULL;
     // 盤面に対応するハッシュコード
-    uint64_t hashCode;
+    const uint64_t hashCode = tree->hashCode[0];
     // 着手リスト
     MoveList moveList;
     // 探索中の着手
@@ -690,7 +699,7 @@ score_t MidPVS(SearchTree *tree, const score_t in_alpha, const score_t in_beta,
     beta = in_beta;
     if (tree->option.usePvHash == 1 && depth >= tree->hashDepth)
     { // ハッシュの記録をもとにカット/探索範囲の縮小
-        hashData = HashTableGetData(tree->pvTable, tree->stones, depth, &hashCode);
+        hashData = HashTableGetData(tree->pvTable, hashCode, depth, hashEntry);
         if (hashData != NULL && IsHashCut(hashData, depth, &alpha, &beta, &score))
             return score;
     }
@@ -733,6 +742,7 @@ score_t MidPVS(SearchTree *tree, const score_t in_alpha, const score_t in_beta,
         // すべての着手について探索
         for (move = NextBestMoveWithSwap(moveList.moves); move != NULL; move = NextBestMoveWithSwap(move))
         {
+            SearchPrefetchChild(tree, move, depth - 1, bestScore == -MAX_VALUE);
             SearchUpdateMid(tree, move);
             if (bestScore == -MAX_VALUE)
             {                                                               // PVが見つかっていないとき
@@ -763,8 +773,8 @@ score_t MidPVS(SearchTree *tree, const score_t in_alpha, const score_t in_beta,
                 }
             }
 
-            // 時間切れ・探索の中断
-            if (tree->killFlag || (tree->option.useTimeLimit && depth >= TIME_LIMIT_CHECK_MIN_DEPTH && SearchIsTimeup(tree)))
+            // 時間切れ・探索の中断（分割点の下では，分割点が中断されたときも）
+            if (AtomicLoad32(&tree->killFlag) || SplitIsAborted(tree) || (tree->option.useTimeLimit && depth >= TIME_LIMIT_CHECK_MIN_DEPTH && SearchIsTimeup(tree)))
             {
                 tree->isIntrrupted = true;
                 return bestScore;
@@ -778,13 +788,95 @@ score_t MidPVS(SearchTree *tree, const score_t in_alpha, const score_t in_beta,
     // ハッシュ表に登録
     if (tree->option.usePvHash == 1)
     {
-        HashTableRegist(tree->pvTable, hashCode, tree->stones, bestMove, cost, depth, in_alpha, in_beta, bestScore);
+        HashTableRegist(tree->pvTable, hashCode, bestMove, cost, depth, in_alpha, in_beta, bestScore);
     }
 
     assert(tree->nbMpcNested == 0);
     return bestScore;
 }
 
+/**
+ * @brief ルートノードの分割点の残りの着手を検証する
+ * 
+ * 分割したスレッド・補助スレッドが，空いたら次の着手を取り出してNWSで検証し，
+ * 予想が外れた着手は通常の窓で再探索する。スコアマップと最善手は分割点のロック内で更新する。
+ * 
+ * @param tree 探索木（分割点の盤面に設定済み）
+ * @param sp 分割点
+ */
+void MidSplitPointSearch(SearchTree *tree, SplitPoint *sp)
+{
+    const unsigned char depth = sp->depth - 1;
+    SearchFunc_t NextSearch;
+    Move *move;
+    score_t score, alpha, beta;
+    bool isResearched;
+
+    if (depth >= tree->pvsDepth)
+    {
+        NextSearch = MidPVS;
+    }
+    else
+    {
+        NextSearch = MidAlphaBeta;
+    }
+
+    while (true)
+    {
+        // 次の着手と現在の探索窓を取得
+        SpinLockAcquire(&sp->lock);
+        if (SplitIsAborted(tree))
+        {
+            SpinLockRelease(&sp->lock);
+            break;
+        }
+        move = NextBestMoveWithSwap(sp->cursor);
+        if (move == NULL)
+        {
+            SpinLockRelease(&sp->lock);
+            break;
+        }
+        sp->cursor = move;
+        alpha = sp->alpha;
+        beta = sp->beta;
+        SpinLockRelease(&sp->lock);
+
+        SearchUpdateMid(tree, move);
+        score = -MidNullWindow(tree, -alpha, depth, false); // 最善かどうかチェック 子ノードをNull Window探索
+        isResearched = score > alpha && score < beta;
+        if (isResearched) // 予想が外れていたら
+        {
+            score = -NextSearch(tree, -beta, -alpha, depth, false); // 通常のWindowで再探索
+        }
+        SearchRestoreMid(tree, move);
+
+        // 時間切れ・探索の中断
+        if (tree->isIntrrupted || AtomicLoad32(&sp->master->killFlag) || (tree->option.useTimeLimit && depth >= TIME_LIMIT_CHECK_MIN_DEPTH && SearchIsTimeup(tree)))
+        {
+            AtomicStore32(&sp->isAborted, true);
+        }
+        if (SplitIsAborted(tree))
+        {
+            break;
+        }
+
+        // 結果を分割点に反映
+        SpinLockAcquire(&sp->lock);
+        sp->scoreMap[move->posIdx] = isResearched ? score : score - 1;
+        if (score > sp->bestScore)
+        {
+            sp->bestScore = score;
+            sp->secondMove = sp->bestMove;
+            sp->bestMove = move->posIdx;
+            if (score > sp->alpha)
+            {
+                sp->alpha = score;
+            }
+        }
+        SpinLockRelease(&sp->lock);
+    }
+}
+
 /**
  * @brief 中盤探索PVSのルートノード処理
  * 
@@ -803,8 +895,8 @@ uint8 MidPVSRoot(SearchTree *tree, MoveList *moveList, uint8 depth, score_t *sco
     // 現状予想される最善手
     uint8 bestMove = NOMOVE_INDEX;
     // 盤面に対応するハッシュデータ
-    HashData *hashData = NULL;
-    uint64_t hashCode;
+    HashData hashEntry[1], *hashData = NULL;
+    const uint64_t hashCode = tree->hashCode[0];
     // 着手情報
     Move *move;
     // 一時探索スコア
@@ -834,7 +926,7 @@ uint8 MidPVSRoot(SearchTree *tree, MoveList *moveList, uint8 depth, score_t *sco
 
     if (tree->option.usePvHash)
     {
-        hashData = HashTableGetData(tree->pvTable, tree->stones, tree->depth, &hashCode);
+        hashData = HashTableGetData(tree->pvTable, hashCode, tree->depth, hashEntry);
         if (hashData != NULL)
         {
             IsHashCut(hashData, depth, &alpha, &beta, &score);
@@ -877,11 +969,40 @@ uint8 MidPVSRoot(SearchTree *tree, MoveList *moveList, uint8 depth, score_t *sco
         }
 
         // 時間切れ・探索の中断
-        if (tree->killFlag || (tree->option.useTimeLimit && depth >= TIME_LIMIT_CHECK_MIN_DEPTH && SearchIsTimeup(tree)))
+        if (AtomicLoad32(&tree->killFlag) || (tree->option.useTimeLimit && depth >= TIME_LIMIT_CHECK_MIN_DEPTH && SearchIsTimeup(tree)))
         {
             tree->isIntrrupted = true;
             return bestMove;
         }
+
+        // 最善手の探索後，残りの着手の検証を待機中のスレッドと分担
+        if (tree->pool && tree->option.useRootSplit && depth >= MID_ROOT_SPLIT_MIN_DEPTH && HasNextMove(move))
+        {
+            SplitPoint sp[1];
+            sp->Search = MidSplitPointSearch;
+            sp->cursor = move;
+            // 分割点の深度はルートノード自身の深度
+            sp->depth = depth + 1;
+            sp->isPv = true;
+            sp->scoreMap = scoreMap;
+            sp->alpha = alpha;
+            sp->beta = beta;
+            sp->bestScore = bestScore;
+            sp->bestMove = bestMove;
+            sp->secondMove = *secondMoveOut;
+            if (SearchPoolSplit(tree, sp))
+            {
+                if (AtomicLoad32(&sp->isAborted))
+                {
+                    tree->isIntrrupted = true;
+                    return sp->bestMove;
+                }
+                bestScore = sp->bestScore;
+                bestMove = sp->bestMove;
+                *secondMoveOut = sp->secondMove;
+                break;
+            }
+        }
     } // end of moves loop
 
     // 「現在のノード数」と「スタート時点でのノード数」の差分＝子ノード数
@@ -893,7 +1014,7 @@ uint8 MidPVSRoot(SearchTree *tree, MoveList *moveList, uint8 depth, score_t *sco
     // ハッシュ表に登録
     if (tree->option.usePvHash == 1)
     {
-        HashTableRegist(tree->pvTable, hashCode, tree->stones, bestMove, cost, depth, SCORE_MIN - 1, SCORE_MAX + 1, bestScore);
+        HashTableRegist(tree->pvTable, hashCode, bestMove, cost, depth, SCORE_MIN - 1, SCORE_MAX + 1, bestScore);
     }
 
     return bestMove;
@@ -919,7 +1040,7 @@ uint8 MidRoot(SearchTree *tree, bool choiceSecond)
     // 一時記録用の深度情報
     uint8 tmpDepth;
     // 反復深化深度リスト
-    uint8 depths[10];
+    uint8 depths[64];
     // 深度リストの内容数
     uint8 nDepths;
 
@@ -936,11 +1057,17 @@ uint8 MidRoot(SearchTree *tree, bool choiceSecond)
     nDepths = 0;
     startDepth = 4;
     endDepth = tree->depth;
+    if (tree->helperId & 1)
+    {
+        // 奇数番の補助探索は主探索より1手深い深度を探索し，深い置換表データを先に作る
+        startDepth++;
+        endDepth++;
+    }
     // 反復深化
     if (tree->option.useIDDS)
     {
         if (tree->option.useTimeLimit)
-            tree->timeLimit = clock() + CLOCKS_PER_SEC * tree->option.oneMoveTime;
+            AtomicStore64(&tree->timeLimit, TimeNowMs() + 1000 * (int64_t)tree->option.oneMoveTime);
 
         // sqrtのほうが早いが，探索中断ができなくなるので1ずつ増やす
         for (tmpDepth = endDepth; tmpDepth >= startDepth; tmpDepth -= 1 /*(int)sqrt(tmpDepth)*/)
@@ -966,12 +1093,15 @@ uint8 MidRoot(SearchTree *tree, bool choiceSecond)
             {
                 if (i <= 0)
                 {
-                    printf("Search Interrupted!!! スペック不足・・・探索できませんでした\n");
+                    if (!tree->helperId)
+                        printf("Search Interrupted!!! スペック不足・・・探索できませんでした\n");
                 }
                 else
                 {
                     tree->completeDepth = depths[i - 1];
-                    printf("Search Interrupted!!! Complete Depth: %d\n", tree->completeDepth);
+                    // 補助探索は主探索の終了時に必ず中断されるので表示しない
+                    if (!tree->helperId)
+                        printf("Search Interrupted!!! Complete Depth: %d\n", tree->completeDepth);
                 }
                 break;
             }
@@ -6,11 +6,14 @@
 
 struct SearchTree;
 typedef struct SearchTree SearchTree;
+struct SplitPoint;
+typedef struct SplitPoint SplitPoint;
 
 score_t MidAlphaBetaDeep(SearchTree *tree, score_t alpha, score_t beta, unsigned char depth, bool passed);
 score_t MidAlphaBeta(SearchTree *tree, score_t alpha, score_t beta, unsigned char depth, bool passed);
 score_t MidPVS(SearchTree *tree, const score_t alpha, const score_t beta, const unsigned char depth, const bool passed);
 uint8 MidRoot(SearchTree *tree, bool choiceSecond);
+void MidSplitPointSearch(SearchTree *tree, SplitPoint *sp);
 uint8 MidRootWithMpcLog(SearchTree *deepTree, SearchTree *shallowTree, FILE *logFile, int matchIdx, uint8 shallow, uint8 deep, uint8 minimumDepth);
 
 #endif // MID_H_
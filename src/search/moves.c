@@ -28,6 +28,30 @@
 #include "../ai/eval.h"
 #include "../bit_operation.h"
 
+// 補助探索で着手スコアに加えるゆらぎの範囲（角ボーナス1つ分未満）
+#define HELPER_ORDER_NOISE_MASK ((1 << 10) - 1)
+
+// 終盤でも浅い探索で着手を評価する最小の空きマス数（これ未満は速さ優先）
+#define END_SHALLOW_ORDER_EMPTY 14
+// 終盤の着手評価での浅い探索の深度
+#define END_SHALLOW_ORDER_DEPTH 2
+
+/**
+ * @brief 補助探索用の着手順序のゆらぎを生成(xorshift64)
+ * 
+ * @param tree 探索木
+ * @return uint32_t ゆらぎ
+ */
+inline uint32_t OrderNoise(SearchTree *tree)
+{
+    uint64_t x = tree->orderNoise;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    tree->orderNoise = x;
+    return (uint32_t)x & HELPER_ORDER_NOISE_MASK;
+}
+
 /**
  * @brief 盤面石情報から着手リストMoveListを作成
  * 
@@ -36,29 +60,25 @@
  */
 void CreateMoveList(MoveList *moveList, Stones *stones)
 {
-    Move *prev = moveList->moves;
     Move *move = moveList->moves + 1;
-    uint8 posIdx;
-    uint64_t pos, rev;
-    uint64_t mob = CalcMobility(stones);
+    uint8 posIdx[MAX_MOVES];
+    uint64_t flips[MAX_MOVES];
+    int i;
 
-    while (mob != 0)
-    {
-        // 着手位置・反転位置を取得
-        pos = GetLSB(mob);
-        posIdx = PosIndexFromBit(pos);
-        mob ^= pos;
-        rev = CalcFlip(stones, posIdx);
+    // 全合法手の反転位置をまとめて計算
+    const uint64_t mob = CalcFlipBatch(stones->own, stones->opp, posIdx, flips);
+    const uint8 nbMoves = CountBits(mob);
 
-        move->flip = rev;
-        move->posIdx = posIdx;
+    for (i = 0; i < nbMoves; i++, move++)
+    {
+        move->posIdx = posIdx[i];
+        move->flip = flips[i];
         move->score = 0;
-        prev = prev->next = move;
-        move++;
     }
-    // 12, 21, 22, 30, 37, 45, 47, 55, 62
-    prev->next = NULL;
-    moveList->nbMoves = (uint8)(move - moveList->moves - 1);
+    // 終端の番兵
+    move->posIdx = NOMOVE_INDEX;
+    moveList->moves->posIdx = NOMOVE_INDEX;
+    moveList->nbMoves = nbMoves;
 
     assert(moveList->nbMoves == CountBits(CalcMobility(stones)));
 }
@@ -92,18 +112,6 @@ void EvaluateMove(SearchTree *tree, Move *move, Stones *stones, score_t alpha, c
         move->score = (1 << 29);
         return;
     }
-
-    if (hashData && move->posIdx == hashData->bestMoves[2])
-    {
-        move->score = (1 << 28);
-        return;
-    }
-
-    if (hashData && move->posIdx == hashData->bestMoves[3])
-    {
-        move->score = (1 << 27);
-        return;
-    }
     else
     {
 
@@ -127,7 +135,7 @@ void EvaluateMove(SearchTree *tree, Move *move, Stones *stones, score_t alpha, c
         {
             score = -Evaluate(tree->eval, tree->nbEmpty - 1);
         }
-        EvalUndo(tree->eval, move->posIdx, move->flip);
+        EvalUndo(tree->eval);
 
         assert(SCORE_MAX + score >= 0);
         mScore = (uint16_t)((SCORE_MAX + score) / STONE_VALUE);
@@ -141,6 +149,165 @@ void EvaluateMove(SearchTree *tree, Move *move, Stones *stones, score_t alpha, c
         mobCnt -= CountBits(next_mob & 0x8100000000000081);
         // 相手の着手位置が多いとマイナス，少ないとプラス(14~8bit目)
         move->score += mobCnt * (1 << 10);
+
+        // 補助探索は主探索と異なる順序で探索する
+        if (tree->helperId)
+        {
+            move->score += OrderNoise(tree);
+        }
+    }
+}
+
+/**
+ * @brief 着手評価用の浅いαβ探索（置換表を使わない）
+ * 
+ * @param tree 探索木
+ * @param alpha アルファ値
+ * @param beta ベータ値
+ * @param depth 探索深度
+ * @param passed パスされたか
+ * @return score_t 評価関数によるスコア
+ */
+static score_t ShallowSearch(SearchTree *tree, score_t alpha, const score_t beta, const uint8 depth, const bool passed)
+{
+    uint64_t mob, pos, flip;
+    score_t score, maxScore;
+
+    if (depth == 0)
+    {
+        return Evaluate(tree->eval, tree->nbEmpty);
+    }
+
+    mob = CalcMobility(tree->stones);
+    if (mob == 0)
+    {
+        if (passed)
+        {
+            return (score_t)(CountBits(tree->stones->own) - CountBits(tree->stones->opp)) * STONE_VALUE;
+        }
+        SearchPassMid(tree);
+        score = -ShallowSearch(tree, -beta, -alpha, depth, true);
+        SearchPassMid(tree);
+        return score;
+    }
+
+    maxScore = -MAX_VALUE;
+    while (mob != 0)
+    {
+        pos = GetLSB(mob);
+        mob ^= pos;
+        flip = CalcFlip(tree->stones, PosIndexFromBit(pos));
+
+        SearchUpdateMidDeep(tree, pos, flip);
+        {
+            score = -ShallowSearch(tree, -beta, -alpha, depth - 1, false);
+        }
+        SearchRestoreMidDeep(tree, pos, flip);
+
+        if (score > maxScore)
+        {
+            maxScore = score;
+            if (score >= beta)
+                break;
+            if (score > alpha)
+                alpha = score;
+        }
+    }
+    return maxScore;
+}
+
+/**
+ * @brief 終盤探索用の着手の評価をする
+ * 
+ * 空きマスが少ないときは，評価関数を使わずに速さ優先（Fastest First）で並べる。
+ * 相手の着手可能数（角は2倍に数える）が少ない手ほど部分木が小さいので先に探索し，
+ * 同じなら偶数理論（空きマスが奇数個の象限に打つ）で優先する。
+ * 空きマスが多いときは，速さ優先に加えて浅い探索のスコアで並べる。
+ * 
+ * @param tree 探索木
+ * @param move 着手オブジェクト
+ * @param stones 盤面石情報
+ * @param parity 空きマスが奇数個の象限のビット
+ * @param hashData 盤面に対応するハッシュデータ
+ */
+void EvaluateMoveEnd(SearchTree *tree, Move *move, Stones *stones, uint8 parity, const HashData *hashData)
+{
+    uint64_t posBit, nextMob;
+    score_t score;
+    int8_t mobCnt;
+
+    if (move->flip == stones->opp)
+    {
+        // 完全勝利で最高得点
+        move->score = (1 << 31);
+        return;
+    }
+
+    if (hashData && move->posIdx == hashData->bestMoves[0])
+    {
+        move->score = (1 << 30);
+        return;
+    }
+
+    if (hashData && move->posIdx == hashData->bestMoves[1])
+    {
+        move->score = (1 << 29);
+        return;
+    }
+
+    posBit = CalcPosBit(move->posIdx);
+    nextMob = CalcMobility64(stones->opp ^ move->flip, stones->own ^ move->flip ^ posBit);
+
+    // 着手位置でスコア付け(8~0bit)
+    move->score = (uint8)VALUE_TABLE[move->posIdx];
+
+    // 偶数理論（着手位置より優先）
+    if (parity & QuadrantBit(move->posIdx))
+    {
+        move->score += 1 << 8;
+    }
+
+    // 正の値にするためのバイアス
+    mobCnt = MAX_MOVES + 4;
+    // 相手の着手可能数（角は2倍）が少ないほどプラス(14~10bit目)
+    mobCnt -= CountBits(nextMob);
+    mobCnt -= CountBits(nextMob & 0x8100000000000081);
+    move->score += mobCnt * (1 << 10);
+
+    if (tree->nbEmpty >= END_SHALLOW_ORDER_EMPTY)
+    {
+        // 浅い探索のスコア（1石あたり偶数理論1つ分，着手可能数1つの1/4の重み）
+        SearchUpdateMidDeep(tree, posBit, move->flip);
+        {
+            score = -ShallowSearch(tree, -MAX_VALUE, MAX_VALUE, END_SHALLOW_ORDER_DEPTH - 1, false);
+        }
+        SearchRestoreMidDeep(tree, posBit, move->flip);
+
+        score = MAX(MIN(score, SCORE_MAX), SCORE_MIN);
+        move->score += (uint32_t)((SCORE_MAX + score) / STONE_VALUE) * (1 << 8);
+    }
+
+    // 補助探索は主探索と異なる順序で探索する
+    if (tree->helperId)
+    {
+        move->score += OrderNoise(tree);
+    }
+}
+
+/**
+ * @brief 終盤探索用に着手リストのすべての着手について評価
+ * 
+ * @param tree 探索木
+ * @param movelist 着手可能位置リスト
+ * @param hashData 盤面に対応するハッシュデータ
+ */
+void EvaluateMoveListEnd(SearchTree *tree, MoveList *movelist, const HashData *hashData)
+{
+    const uint8 parity = QuadrantParity(~(tree->stones->own | tree->stones->opp));
+    Move *move;
+    for (move = movelist->moves + 1; move->posIdx != NOMOVE_INDEX; move++)
+    {
+        EvaluateMoveEnd(tree, move, tree->stones, parity, hashData);
     }
 }
 
@@ -156,43 +323,44 @@ void EvaluateMove(SearchTree *tree, Move *move, Stones *stones, score_t alpha, c
 void EvaluateMoveList(SearchTree *tree, MoveList *movelist, Stones *stones, score_t alpha, const HashData *hashData)
 {
     Move *move;
-    for (move = movelist->moves->next; move != NULL; move = move->next)
+    for (move = movelist->moves + 1; move->posIdx != NOMOVE_INDEX; move++)
     {
-        EvaluateMove(tree, move, tree->stones, alpha, hashData);
+        EvaluateMove(tree, move, stones, alpha, hashData);
     }
 }
 
 /**
  * @brief prevの次に評価の高いMoveを入れ替えつつ取得
  * 
+ * prevより後ろの着手から最大スコアの手を探し，prevの直後と入れ替える（選択ソート）
+ * 
  * @param prev 検索の起点となる着手
- * @return Move* prevの次に評価の高い着手
+ * @return Move* prevの次に評価の高い着手（残りがなければNULL）
  */
 Move *NextBestMoveWithSwap(Move *prev)
 {
-    if (prev->next)
+    Move *next = prev + 1;
+    Move *move, *best;
+    Move tmp;
+
+    if (next->posIdx == NOMOVE_INDEX)
+        return NULL;
+
+    best = next;
+    for (move = next + 1; move->posIdx != NOMOVE_INDEX; move++)
     {
-        Move *move, *best;
-        best = prev;
-        for (move = best->next; move->next != NULL; move = move->next)
+        if (move->score > best->score)
         {
-            if (move->next->score > best->next->score)
-            {
-                best = move;
-            }
-        }
-        if (best != prev)
-        {
-            // 最大スコアの手を
-            move = best->next;
-            // 切り離して
-            best->next = best->next->next;
-            // 次の手として挿入
-            move->next = prev->next;
-            prev->next = move;
+            best = move;
         }
     }
-    return prev->next;
+    if (best != next)
+    {
+        tmp = *next;
+        *next = *best;
+        *best = tmp;
+    }
+    return next;
 }
 
 /**
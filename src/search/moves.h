@@ -8,15 +8,31 @@ typedef struct Move
     uint8 posIdx;
     uint32_t score;
     uint64_t flip;
-    struct Move *next;
 } Move;
 
+/**
+ * @brief 着手リスト
+ * 
+ * moves[1]~moves[nbMoves]に着手を連続して格納する。
+ * moves[0]は探索開始位置（先頭の番兵），moves[nbMoves + 1]は終端の番兵（posIdx = NOMOVE_INDEX）。
+ */
 typedef struct MoveList
 {
-    Move moves[MAX_MOVES + 1];
+    Move moves[MAX_MOVES + 2];
     uint8 nbMoves;
 } MoveList;
 
+/**
+ * @brief moveの後ろに未探索の着手が残っているか
+ * 
+ * @param move 着手
+ * @return bool 残っているか
+ */
+inline bool HasNextMove(const Move *move)
+{
+    return (move + 1)->posIdx != NOMOVE_INDEX;
+}
+
 struct SearchTree;
 struct Stones;
 struct HashData;
@@ -35,4 +51,8 @@ void EvaluateMove(SearchTree *tree, Move *move, Stones *stones, score_t alpha, c
 
 void EvaluateMoveList(SearchTree *tree, MoveList *movelist, Stones *stones, score_t alpha, const HashData *hashData);
 
+void EvaluateMoveEnd(SearchTree *tree, Move *move, Stones *stones, uint8 parity, const HashData *hashData);
+
+void EvaluateMoveListEnd(SearchTree *tree, MoveList *movelist, const HashData *hashData);
+
 #endif
\ No newline at end of file
@@ -12,13 +12,14 @@
  * 
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
-#include <time.h>
 
 #include "search.h"
 #include "mid.h"
 #include "end.h"
+#include "search_pool.h"
 #include "../ai/nnet.h"
 #include "../bit_operation.h"
 #include "../debug_util.h"
@@ -43,16 +44,19 @@ void UpdateScoreMap(score_t latest[64], score_t complete[64])
 }
 
 /**
- * @brief 探索木の生成
+ * @brief 探索木の生成（ハッシュ表以外）
  * 
  * @param tree 生成した探索木
- * @param isShallow 浅い探索用の木か
  */
-void TreeInit(SearchTree *tree, bool isShallow)
+static void TreeInitWithoutHash(SearchTree *tree)
 {
     tree->option = DEFAULT_OPTION;
 
     tree->killFlag = false;
+    tree->isEndSearch = false;
+    TreeConfigHelper(tree, 0);
+    tree->pool = NULL;
+    tree->splitPoint = NULL;
     if (tree->option.useIDDS)
     {
         tree->option.useTimeLimit = tree->option.useTimeLimit;
@@ -65,7 +69,19 @@ void TreeInit(SearchTree *tree, bool isShallow)
     }
 
     EvalInit(tree->eval);
+}
+
+/**
+ * @brief 探索木の生成
+ * 
+ * @param tree 生成した探索木
+ * @param isShallow 浅い探索用の木か
+ */
+void TreeInit(SearchTree *tree, bool isShallow)
+{
+    TreeInitWithoutHash(tree);
 
+    tree->isHashShared = false;
     if (tree->option.useHash)
     {
         tree->nwsTable = (HashTable *)malloc(sizeof(HashTable));
@@ -83,12 +99,31 @@ void TreeInit(SearchTree *tree, bool isShallow)
         }
         else
         {
-            HashTableInit(tree->nwsTable, NWS_TABLE_SIZE);
+            HashTableInit(tree->nwsTable, HashTableSizeFromMB(tree->option.hashSizeMB));
             HashTableInit(tree->pvTable, PV_TABLE_SIZE);
         }
     }
 }
 
+/**
+ * @brief 他の探索木と置換表を共有する探索木の生成
+ * 
+ * 置換表は全スレッドから参照・登録される。
+ * 確保・解放・リセット・バージョン管理は置換表の所有者が探索停止中に行う。
+ * 
+ * @param tree 生成した探索木
+ * @param nwsTable 共有するNullWindowSearch用ハッシュ表
+ * @param pvTable 共有するPVノード用ハッシュ表
+ */
+void TreeInitShared(SearchTree *tree, HashTable *nwsTable, HashTable *pvTable)
+{
+    TreeInitWithoutHash(tree);
+
+    tree->isHashShared = true;
+    tree->nwsTable = nwsTable;
+    tree->pvTable = pvTable;
+}
+
 /**
  * @brief 探索木の解放
  * 
@@ -97,7 +132,7 @@ void TreeInit(SearchTree *tree, bool isShallow)
 void TreeDelete(SearchTree *tree)
 {
     EvalDelete(tree->eval);
-    if (tree->option.useHash)
+    if (tree->option.useHash && !tree->isHashShared)
     {
         HashTableFree(tree->nwsTable);
         HashTableFree(tree->pvTable);
@@ -157,6 +192,60 @@ void TreeConfigDepth(SearchTree *tree, unsigned char midDepth, unsigned char end
     tree->option.endDepth = endDepth;
 }
 
+/**
+ * @brief 探索木のハッシュ表サイズ設定
+ * 
+ * サイズが変わる場合はハッシュ表を確保し直す（記録済みのデータは消える）。
+ * 確保できなければ元のハッシュ表をそのまま使う。
+ * 共有ハッシュ表を使う探索木では，サイズの変更は所有者が行う。
+ * 
+ * @param tree 探索木
+ * @param hashSizeMB NWS用ハッシュ表のサイズ[MB]
+ * @return bool サイズを変更できたか
+ */
+bool TreeConfigHashSize(SearchTree *tree, unsigned int hashSizeMB)
+{
+    if (!tree->option.useHash || tree->isHashShared)
+    {
+        tree->option.hashSizeMB = hashSizeMB;
+        return true;
+    }
+
+    if (!HashTableResize(tree->nwsTable, HashTableSizeFromMB(hashSizeMB)))
+    {
+        return false;
+    }
+    tree->option.hashSizeMB = hashSizeMB;
+    return true;
+}
+
+/**
+ * @brief Lazy SMPの補助探索の設定
+ * 
+ * 補助探索は主探索と同じ盤面を探索し，共有置換表に結果を残すことで主探索を助ける。
+ * 主探索と異なる順序で探索するよう，反復深化の深度と着手順序をずらす。
+ * 
+ * @param tree 探索木
+ * @param helperId 補助探索番号（0なら主探索）
+ */
+void TreeConfigHelper(SearchTree *tree, uint8 helperId)
+{
+    tree->helperId = helperId;
+    // xorshiftの状態は0以外で初期化
+    tree->orderNoise = 0x9E3779B97F4A7C15ULL * (helperId + 1);
+}
+
+/**
+ * @brief 終盤探索で分割探索に使うスレッド群の設定
+ * 
+ * @param tree 探索木
+ * @param pool スレッド群（NULLなら分割しない）
+ */
+void TreeConfigPool(SearchTree *tree, SearchPool *pool)
+{
+    tree->pool = pool;
+}
+
 /**
  * @brief 探索木の複製
  * 
@@ -166,6 +255,8 @@ void TreeConfigDepth(SearchTree *tree, unsigned char midDepth, unsigned char end
 void TreeClone(SearchTree *src, SearchTree *dst)
 {
     *(dst->stones) = *(src->stones);
+    dst->hashCode[0] = src->hashCode[0];
+    dst->hashCode[1] = src->hashCode[1];
     dst->option = src->option;
 
     dst->nbEmpty = src->nbEmpty;
@@ -178,8 +269,7 @@ void TreeClone(SearchTree *src, SearchTree *dst)
 
     dst->nbMpcNested = src->nbMpcNested;
 
-    HashTableClone(src->nwsTable, dst->nwsTable);
-    HashTableClone(src->pvTable, dst->pvTable);
+    // ハッシュ表は共有置換表を使うので複製しない
     EvalClone(src->eval, dst->eval);
 }
 
@@ -190,13 +280,58 @@ void TreeClone(SearchTree *src, SearchTree *dst)
  */
 void TreeReset(SearchTree *tree)
 {
-    if (tree->option.useHash)
+    if (tree->option.useHash && !tree->isHashShared)
     {
         HashTableReset(tree->nwsTable);
         HashTableReset(tree->pvTable);
     }
 }
 
+/**
+ * @brief 置換表キャッシュファイルを読み込む
+ * 
+ * TreeInit・TreeResetの後に呼び出すことで，過去に保存した探索結果から探索を始められる。
+ * 評価モデルが異なるファイル，置換表が保存時より大きい場合は読み込まない。
+ * 
+ * @param tree 探索木
+ * @param file キャッシュファイル名
+ * @return bool 読み込めたか
+ */
+bool TreeLoadHashCache(SearchTree *tree, const char *file)
+{
+    bool isEndScore;
+    if (tree->isHashShared)
+    {
+        return false;
+    }
+    if (!HashTableLoadFile(file,
+                           tree->option.useHash ? tree->nwsTable : NULL,
+                           tree->option.usePvHash ? tree->pvTable : NULL,
+                           EvalModelChecksum(tree->eval), &isEndScore))
+    {
+        return false;
+    }
+    // 保存時と中盤・終盤が異なれば，探索開始時にスコアがリセットされる
+    tree->isEndSearch = isEndScore;
+    return true;
+}
+
+/**
+ * @brief 置換表の内容をキャッシュファイルへ保存する
+ * 
+ * @param tree 探索木
+ * @param file キャッシュファイル名
+ * @param minDepth 保存するデータの最小探索深度
+ * @return bool 保存できたか
+ */
+bool TreeSaveHashCache(SearchTree *tree, const char *file, uint8 minDepth)
+{
+    return HashTableSaveFile(file,
+                             tree->option.useHash ? tree->nwsTable : NULL,
+                             tree->option.usePvHash ? tree->pvTable : NULL,
+                             EvalModelChecksum(tree->eval), tree->isEndSearch, minDepth);
+}
+
 /**
  * @brief 探索の初期化
  * 
@@ -209,31 +344,30 @@ void SearchSetup(SearchTree *tree, uint64_t own, uint64_t opp)
     //TreeReset(tree);
     // 評価パターンの初期化
     EvalReload(tree->eval, own, opp, OWN);
-    if (tree->option.usePvHash)
+    if (!tree->isHashShared)
     {
-        HashTableVersionUp(tree->pvTable);
-    }
-    if (tree->option.useHash)
-    {
-        HashTableVersionUp(tree->nwsTable);
+        if (tree->option.usePvHash)
+        {
+            HashTableVersionUp(tree->pvTable);
+        }
+        if (tree->option.useHash)
+        {
+            HashTableVersionUp(tree->nwsTable);
+        }
     }
 
     tree->nbEmpty = CountBits(~(own | opp));
     tree->nodeCount = 0;
     tree->nbCut = 0;
+    tree->nbEtcProbe = 0;
+    tree->nbEtcCut = 0;
     tree->nbMpcNested = 0;
 
     tree->stones->own = own;
     tree->stones->opp = opp;
+    HashCodeInit(tree->hashCode, tree->stones);
 }
 
-/*
-void SearchMutexSetup(SearchTree *tree, HANDLE timerMutex)
-{
-    tree->timerMutex = timerMutex;
-}
-*/
-
 /**
  * @brief 時間切れかどうか判別
  * 
@@ -242,11 +376,44 @@ void SearchMutexSetup(SearchTree *tree, HANDLE timerMutex)
  */
 bool SearchIsTimeup(SearchTree *tree)
 {
-    bool isTimeup;
-    WaitForSingleObject(tree->timerMutex, INFINITE);
-    isTimeup = clock() > tree->timeLimit;
-    ReleaseMutex(tree->timerMutex);
-    return isTimeup;
+    return TimeNowMs() > AtomicLoad64(&tree->timeLimit);
+}
+
+/**
+ * @brief Enhanced Transposition Cutoff(ETC)
+ * 
+ * 子ノードを探索する前に，すべての子ノードの置換表を引く。
+ * ある子ノードのスコア上限が子ノード側のα(-β)以下なら，このノードはβ以上が確定するので探索を省略できる。
+ * 置換表を引くだけで部分木の探索を省略できる可能性がある。
+ * 
+ * @param tree 探索木
+ * @param moveList 着手リスト（反転位置を計算済み）
+ * @param depth このノードの探索深度
+ * @param beta ベータ値
+ * @param score 出力：カットされた場合のスコア
+ * @return bool カットできるか
+ */
+bool SearchEnhancedTransCut(SearchTree *tree, const MoveList *moveList, unsigned char depth, score_t beta, score_t *score)
+{
+    HashData hashEntry[1], *hashData;
+    const unsigned char childDepth = depth - 1;
+    const Move *move;
+
+    if (childDepth < tree->hashDepth)
+        return false;
+
+    tree->nbEtcProbe++;
+    for (move = moveList->moves + 1; move->posIdx != NOMOVE_INDEX; move++)
+    {
+        hashData = HashTableGetData(tree->nwsTable, HashCodeChild(tree->hashCode, move->posIdx, move->flip), childDepth, hashEntry);
+        if (hashData != NULL && hashData->depth >= childDepth && hashData->upper <= -beta)
+        {
+            tree->nbEtcCut++;
+            *score = -hashData->upper;
+            return true;
+        }
+    }
+    return false;
 }
 
 /**
@@ -258,6 +425,7 @@ void SearchPassMid(SearchTree *tree)
 {
     EvalUpdatePass(tree->eval);
     StonesSwap(tree->stones);
+    HashCodeSwap(tree->hashCode);
 }
 
 /**
@@ -271,6 +439,7 @@ void SearchUpdateMid(SearchTree *tree, Move *move)
     uint64_t posBit = CalcPosBit(move->posIdx);
     EvalUpdate(tree->eval, move->posIdx, move->flip);
     StonesUpdate(tree->stones, posBit, move->flip);
+    HashCodeUpdate(tree->hashCode, move->posIdx, move->flip);
     tree->nbEmpty--;
 }
 
@@ -283,14 +452,17 @@ void SearchUpdateMid(SearchTree *tree, Move *move)
 void SearchRestoreMid(SearchTree *tree, Move *move)
 {
     uint64_t posBit = CalcPosBit(move->posIdx);
-    EvalUndo(tree->eval, move->posIdx, move->flip);
+    EvalUndo(tree->eval);
     StonesRestore(tree->stones, posBit, move->flip);
+    HashCodeRestore(tree->hashCode, move->posIdx, move->flip);
     tree->nbEmpty++;
 }
 
 /**
  * @brief 深い深度での中盤更新処理
  * 
+ * 子ノード以降ではハッシュ表を参照しないので，ハッシュコードは更新しない
+ * 
  * @param tree 探索木
  * @param pos bit着手位置
  * @param flip bit反転位置
@@ -312,8 +484,7 @@ void SearchUpdateMidDeep(SearchTree *tree, uint64_t pos, uint64_t flip)
  */
 void SearchRestoreMidDeep(SearchTree *tree, uint64_t pos, uint64_t flip)
 {
-    uint8 posIdx = PosIndexFromBit(pos);
-    EvalUndo(tree->eval, posIdx, flip);
+    EvalUndo(tree->eval);
     StonesRestore(tree->stones, pos, flip);
     tree->nbEmpty++;
 }
@@ -326,6 +497,7 @@ void SearchRestoreMidDeep(SearchTree *tree, uint64_t pos, uint64_t flip)
 void SearchPassEnd(SearchTree *tree)
 {
     StonesSwap(tree->stones);
+    HashCodeSwap(tree->hashCode);
     EvalUpdatePass(tree->eval);
 }
 
@@ -339,6 +511,7 @@ void SearchUpdateEnd(SearchTree *tree, Move *move)
 {
     EvalUpdate(tree->eval, move->posIdx, move->flip);
     StonesUpdate(tree->stones, CalcPosBit(move->posIdx), move->flip);
+    HashCodeUpdate(tree->hashCode, move->posIdx, move->flip);
     tree->nbEmpty--;
 }
 
@@ -350,14 +523,17 @@ void SearchUpdateEnd(SearchTree *tree, Move *move)
  */
 void SearchRestoreEnd(SearchTree *tree, Move *move)
 {
-    EvalUndo(tree->eval, move->posIdx, move->flip);
+    EvalUndo(tree->eval);
     StonesRestore(tree->stones, CalcPosBit(move->posIdx), move->flip);
+    HashCodeRestore(tree->hashCode, move->posIdx, move->flip);
     tree->nbEmpty++;
 }
 
 /**
  * @brief 深い深度での終盤更新処理
  * 
+ * 子ノード以降ではハッシュ表を参照しないので，ハッシュコードは更新しない
+ * 
  * @param tree 探索木
  * @param pos bit着手位置
  * @param flip bit反転位置
@@ -394,8 +570,8 @@ uint8 SearchWithoutSetup(SearchTree *tree)
     uint8 pos = NOMOVE_INDEX;
     tree->isIntrrupted = false;
 
-    clock_t start, finish;
-    start = clock();
+    int64_t start, finish;
+    start = TimeNowMs();
     ResetScoreMap(tree->scoreMap);
 
     if (tree->nbEmpty == 60)
@@ -415,9 +591,10 @@ uint8 SearchWithoutSetup(SearchTree *tree)
         {
             tree->isEndSearch = true;
             // 中盤 ⇔ 終盤切り替え時，スコアが切り替わるので置換表内のスコアをリセット
-            if (tree->option.usePvHash)
+            // 共有置換表の場合は所有者が探索開始前にリセットする
+            if (tree->option.usePvHash && !tree->isHashShared)
                 HashTableResetScoreWindows(tree->pvTable);
-            if (tree->option.useHash)
+            if (tree->option.useHash && !tree->isHashShared)
                 HashTableResetScoreWindows(tree->nwsTable);
         }
         tree->depth = tree->nbEmpty;
@@ -425,22 +602,38 @@ uint8 SearchWithoutSetup(SearchTree *tree)
         tree->orderDepth = tree->pvsDepth;
         tree->hashDepth = tree->pvsDepth;
         tree->pvHashDepth = tree->pvsDepth - 1;
+        if (tree->pool)
+            SearchPoolActivate(tree->pool);
         pos = EndRoot(tree, tree->option.choiceSecond);
+        if (tree->pool)
+            SearchPoolDeactivate(tree->pool);
     }
     else
     {
         DEBUG_PRINTF("\tSearchWithoutSetup Mid:%d\n", tree->option.midDepth);
+        if (tree->isEndSearch)
+        {
+            // 終盤のスコアが残っている場合（終盤の置換表キャッシュを読み込んだ時など）は中盤用にリセット
+            if (tree->option.usePvHash && !tree->isHashShared)
+                HashTableResetScoreWindows(tree->pvTable);
+            if (tree->option.useHash && !tree->isHashShared)
+                HashTableResetScoreWindows(tree->nwsTable);
+        }
         tree->isEndSearch = 0;
         tree->depth = tree->option.midDepth;
         tree->pvsDepth = tree->option.midPvsDepth;
         tree->orderDepth = tree->pvsDepth;
         tree->hashDepth = tree->pvsDepth;
         tree->pvHashDepth = tree->pvsDepth - 1;
+        if (tree->pool && tree->option.useRootSplit)
+            SearchPoolActivate(tree->pool);
         pos = MidRoot(tree, tree->option.choiceSecond);
+        if (tree->pool && tree->option.useRootSplit)
+            SearchPoolDeactivate(tree->pool);
     }
 
-    finish = clock();
-    tree->usedTime = (finish - start) / (double)CLOCKS_PER_SEC;
+    finish = TimeNowMs();
+    tree->usedTime = (finish - start) / 1000.0;
 
     float outScore;
     if (tree->isEndSearch)
@@ -452,7 +645,7 @@ uint8 SearchWithoutSetup(SearchTree *tree)
         outScore = tree->score / (float)(STONE_VALUE);
     }
 
-    sprintf_s(tree->msg, sizeof(tree->msg),
+    snprintf(tree->msg, sizeof(tree->msg),
               "探索深度: %d  思考時間：%.2f[s]  推定CPU側スコア：%.1f",
               tree->completeDepth,
               tree->usedTime,
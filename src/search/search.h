@@ -3,16 +3,16 @@
 
 #define WIN_VALUE (1000000)
 
-#undef D8
-#include <time.h>
-#include <Windows.h>
-#include <process.h>
-
 #include "../const.h"
 #include "../stones.h"
 #include "../ai/eval.h"
 #include "hash.h"
+#include "stability.h"
 #include "moves.h"
+#include "thread_util.h"
+
+struct SearchPool;
+struct SplitPoint;
 
 typedef struct SearchOption
 {
@@ -24,8 +24,14 @@ typedef struct SearchOption
     unsigned char midPvsDepth;
     // 終盤探索PVS限界
     unsigned char endPvsDepth;
+    // 中盤探索でETCを行う最小の探索深度
+    unsigned char midEtcDepth;
+    // 終盤探索でETCを行う最小の探索深度
+    unsigned char endEtcDepth;
     // 1手にかける時間
     int oneMoveTime;
+    // NWS用ハッシュ表のサイズ[MB]
+    unsigned int hashSizeMB;
 
     // ハッシュ表を利用するかどうか
     bool useHash;
@@ -43,6 +49,9 @@ typedef struct SearchOption
     // 次善手を選ぶか
     bool choiceSecond;
 
+    // 中盤探索でルートの着手をスレッド群で分担して検証するか（スレッド群の設定時のみ）
+    bool useRootSplit;
+
 } SearchOption;
 
 static const SearchOption DEFAULT_OPTION = {
@@ -50,7 +59,10 @@ static const SearchOption DEFAULT_OPTION = {
     20,    // 終盤探索深度
     4,     // 中盤PVS限界
     8,     // 終盤PVS限界
+    6,     // 中盤ETC限界
+    10,    // 終盤ETC限界
     1,     // 一手にかける時間
+    32,    // ハッシュ表のサイズ[MB]
     true,  // ハッシュ表の利用
     true,  // PVハッシュの利用
     true,  // 反復深化の利用
@@ -58,6 +70,7 @@ static const SearchOption DEFAULT_OPTION = {
     false, // MPCのネスト可否
     true,  // タイムリミットの有効・無効
     false, // 次善手を選ぶかどうか
+    true,  // ルートの着手を分担して検証するか
 };
 
 /**
@@ -72,11 +85,17 @@ typedef struct SearchTree
     HashTable *nwsTable;
     // PVノード用ハッシュ表
     HashTable *pvTable;
+    // ハッシュ表を他の探索木と共有しているか
+    // 共有時はハッシュ表の確保・解放・リセット・バージョン管理を所有者が行う
+    bool isHashShared;
 
     // 評価オブジェクト
     Evaluator eval[1];
     // 石情報
     Stones stones[1];
+    // 石情報のハッシュコード（[0]:現在の盤面，[1]:手番を入れ替えた盤面）
+    // 着手・パスに合わせて差分更新する（Deep系の更新処理では更新しない）
+    uint64_t hashCode[2];
     // 残り空きマス数
     uint8 nbEmpty;
     // 探索深度
@@ -93,11 +112,24 @@ typedef struct SearchTree
     // MPCの重複回数
     uint8 nbMpcNested;
 
+    // Lazy SMPの補助探索番号（0:主探索）
+    uint8 helperId;
+    // 補助探索で着手順序をゆらがせるための乱数状態
+    uint64_t orderNoise;
+
+    // 終盤探索で残りの着手を分担させるスレッド群（NULLなら分割しない）
+    struct SearchPool *pool;
+    // 探索中のノードが属する分割点（分割点の下でなければNULL）
+    struct SplitPoint *splitPoint;
+
     /* For Stats */
     // 探索ノード数
     size_t nodeCount;
     // ベータカット数
     size_t nbCut;
+    // ETC(子ノードの置換表によるカット)の試行数・カット数
+    size_t nbEtcProbe;
+    size_t nbEtcCut;
     // 探索時間
     double usedTime;
     // 終盤探索だったかどうか
@@ -110,16 +142,15 @@ typedef struct SearchTree
     // スコアマップ
     score_t scoreMap[64];
 
-    HANDLE timerMutex;
-    // 探索終了時刻
-    clock_t timeLimit;
+    // 探索終了時刻[ms]（TimeNowMsの時刻）
+    atomic64_t timeLimit;
     // 中断されたか
     bool isIntrrupted;
     // 探索完了した深度
     int completeDepth;
 
-    // 探索の中断
-    bool killFlag;
+    // 探索の中断（他スレッドから立てられる）
+    atomic32_t killFlag;
 
     // CUIメッセージ利用時のバッファ
     char msg[1024];
@@ -132,17 +163,24 @@ void ResetScoreMap(score_t scoreMap[64]);
 void UpdateScoreMap(score_t latest[64], score_t complete[64]);
 
 void TreeInit(SearchTree *tree, bool isShallow);
+void TreeInitShared(SearchTree *tree, HashTable *nwsTable, HashTable *pvTable);
 void TreeDelete(SearchTree *tree);
 void TreeConfig(SearchTree *tree, unsigned char midDepth, unsigned char endDepth, int oneMoveTime, bool useIDD, bool useTimer, bool useMPC);
 void TreeConfigClone(SearchTree *tree, SearchOption newOption);
 void TreeConfigDepth(SearchTree *tree, unsigned char midDepth, unsigned char endDepth);
+bool TreeConfigHashSize(SearchTree *tree, unsigned int hashSizeMB);
+void TreeConfigHelper(SearchTree *tree, uint8 helperId);
+void TreeConfigPool(SearchTree *tree, struct SearchPool *pool);
 void TreeClone(SearchTree *src, SearchTree *dst);
 void TreeReset(SearchTree *tree);
+bool TreeLoadHashCache(SearchTree *tree, const char *file);
+bool TreeSaveHashCache(SearchTree *tree, const char *file, uint8 minDepth);
 
 void SearchSetup(SearchTree *tree, uint64_t own, uint64_t opp);
-void SearchMutexSetup(SearchTree *tree, HANDLE timerMutex);
 bool SearchIsTimeup(SearchTree *tree);
 
+bool SearchEnhancedTransCut(SearchTree *tree, const MoveList *moveList, unsigned char depth, score_t beta, score_t *score);
+
 void SearchPassMid(SearchTree *tree);
 void SearchUpdateMid(SearchTree *tree, Move *move);
 void SearchRestoreMid(SearchTree *tree, Move *move);
@@ -155,6 +193,30 @@ void SearchRestoreEnd(SearchTree *tree, Move *move);
 void SearchUpdateEndDeep(SearchTree *tree, uint64_t pos, uint64_t flip);
 void SearchRestoreEndDeep(SearchTree *tree, uint64_t pos, uint64_t flip);
 
+/**
+ * @brief 子ノードで参照するハッシュデータを先読みする
+ * 
+ * @param tree 探索木
+ * @param move 子ノードへの着手
+ * @param childDepth 子ノードの探索深度
+ * @param isPvChild 子ノードをPVノードとして探索するか（PV用ハッシュ表を参照するか）
+ */
+inline void SearchPrefetchChild(SearchTree *tree, Move *move, unsigned char childDepth, bool isPvChild)
+{
+    if (childDepth < tree->hashDepth)
+        return;
+
+    if (isPvChild)
+    {
+        if (tree->option.usePvHash)
+            HashTablePrefetch(tree->pvTable, HashCodeChild(tree->hashCode, move->posIdx, move->flip));
+    }
+    else if (tree->option.useHash)
+    {
+        HashTablePrefetch(tree->nwsTable, HashCodeChild(tree->hashCode, move->posIdx, move->flip));
+    }
+}
+
 void SearchLaunchAsync(SearchTree *tree);
 uint8 SearchWithoutSetup(SearchTree *tree);
 uint8 SearchWithSetup(SearchTree *tree, uint64_t own, uint64_t opp, bool choiceSecond);
@@ -12,6 +12,15 @@
  * 非同期探索を行う。相手が着手したとき，着手位置に該当する
  * Branchは探索を続行，それ以外のプロセスの探索を終了する。
  * 
+ * 置換表はマネージャーが1つだけ持ち，全Branchで共有する。
+ * バージョン管理やスコアのリセットは，Branchの探索が停止している間にマネージャーが行う。
+ * 
+ * 相手の着手後のメインルート探索は，スレッド群で並列化する。
+ * 中盤ではルートの着手の検証を，終盤の完全読みではノード内の着手を分担する（YBWC）。
+ * Lazy SMPを有効にした中盤では，代わりに空いているBranchを補助探索として
+ * 同じ盤面を並列に探索させる。補助探索は反復深化の深度と着手順序をずらし，
+ * 共有置換表を通して主探索を助ける。結果を返すのは主探索のBranchのみ。
+ * 
  */
 #define _CRT_SECURE_NO_WARNINGS
 #include <assert.h>
@@ -107,12 +116,13 @@ uint8 BestMoveFromMap(score_t map[64])
  * 
  * @param branch 初期化するbranch
  * @param id ブランチID
+ * @param nwsTable 共有するNullWindowSearch用ハッシュ表
+ * @param pvTable 共有するPVノード用ハッシュ表
  */
-void BranchInit(BranchProcess *branch, int id)
+void BranchInit(BranchProcess *branch, int id, HashTable *nwsTable, HashTable *pvTable)
 {
-    TreeInit(branch->tree, false);
-    branch->processHandle = NULL;
-    branch->scoreMapMutex = NULL;
+    TreeInitShared(branch->tree, nwsTable, pvTable);
+    ThreadInit(branch->thread);
     branch->enemyMove = NOMOVE_INDEX;
     branch->state = BRANCH_WAIT;
     branch->id = id;
@@ -136,7 +146,6 @@ void BranchDelete(BranchProcess *branch)
 void StartSearchAsync(void *tree)
 {
     SearchWithoutSetup((SearchTree *)tree);
-    _endthread();
 }
 
 /**
@@ -149,13 +158,85 @@ void StartSearchAsync(void *tree)
 void BranchLaunch(BranchProcess *branch, Stones *beforeEnemyStones, int depth, int endDepth)
 {
     Stones stones = ApplyEnemyPut(beforeEnemyStones, branch->enemyMove);
-    branch->tree->killFlag = false;
+    AtomicStore32(&branch->tree->killFlag, false);
 
     // 事前探索をするときはタイマーOFF
     TreeConfig(branch->tree, depth, endDepth, 10000, true, false, false);
     SearchSetup(branch->tree, stones.own, stones.opp);
 
-    branch->processHandle = (HANDLE)_beginthread(StartSearchAsync, 0, branch->tree);
+    ThreadCreate(branch->thread, StartSearchAsync, branch->tree);
+}
+
+/**
+ * @brief 空いているBranchで，主探索と同じ盤面の補助探索を開始する
+ * 
+ * 共有置換表の準備が済んでから呼び出すこと
+ * 
+ * @param sManager 探索マネージャー
+ * @param primary 主探索のBranch
+ * @param stones 探索する盤面
+ */
+void HelpersLaunch(SearchManager *sManager, BranchProcess *primary, Stones *stones)
+{
+    int helperId = 0;
+    sManager->helperNodeCount = 0;
+
+    // Lazy SMPを使わない中盤，終盤はスレッド群で分割探索するので補助探索は使わない
+    if (!sManager->useLazySmp)
+    {
+        return;
+    }
+    if (primary->tree->pool != NULL && CountBits(~(stones->own | stones->opp)) <= primary->tree->option.endDepth)
+    {
+        return;
+    }
+
+    for (int i = 0; i < sManager->numMaxBranches && helperId < sManager->numHelpers; i++)
+    {
+        BranchProcess *branch = &sManager->branches[i];
+        if (branch == primary || branch->state != BRANCH_WAIT)
+            continue;
+
+        helperId++;
+        DEBUG_PRINTF("\t HelperSearch Processing @Branch:%d\n", branch->id);
+        branch->state = BRANCH_HELPER_SEARCH;
+        AtomicStore32(&branch->tree->killFlag, false);
+        TreeConfigClone(branch->tree, primary->tree->option);
+        TreeConfigHelper(branch->tree, (uint8)helperId);
+        SearchSetup(branch->tree, stones->own, stones->opp);
+
+        ThreadCreate(branch->thread, StartSearchAsync, branch->tree);
+    }
+}
+
+/**
+ * @brief 補助探索をすべて終了する
+ * 
+ * @param sManager 探索マネージャー
+ */
+void HelpersKill(SearchManager *sManager)
+{
+    for (int i = 0; i < sManager->numMaxBranches; i++)
+    {
+        BranchProcess *branch = &sManager->branches[i];
+        if (branch->state == BRANCH_HELPER_SEARCH)
+        {
+            AtomicStore32(&branch->tree->killFlag, true);
+        }
+    }
+
+    for (int i = 0; i < sManager->numMaxBranches; i++)
+    {
+        BranchProcess *branch = &sManager->branches[i];
+        if (branch->state == BRANCH_HELPER_SEARCH)
+        {
+            ThreadJoin(branch->thread);
+            sManager->helperNodeCount += branch->tree->nodeCount;
+            TreeConfigHelper(branch->tree, 0);
+            branch->state = BRANCH_WAIT;
+            AtomicStore32(&branch->tree->killFlag, false);
+        }
+    }
 }
 
 /**
@@ -220,22 +301,32 @@ void InsertBestBranch(SearchManager *sManager, uint8 pos, score_t score)
 }
 
 /**
- * @brief 探索木の情報をすべてのBranchへ共有する
+ * @brief 共有置換表を次の探索用に準備する
+ * 
+ * Branchの探索が停止している間に呼び出すこと
  * 
  * @param sManager 探索マネージャー
- * @param originBranch 情報元のBranch
+ * @param nbEmpty 探索される盤面の空きマス数
  */
-void BroadcastTreeToAllBranch(SearchManager *sManager, BranchProcess *originBranch)
+void PrepareSharedHash(SearchManager *sManager, int nbEmpty)
 {
-    BranchProcess *branch;
-    for (int i = 0; i < sManager->numMaxBranches; i++)
+    HashTableVersionUp(sManager->nwsTable);
+    HashTableVersionUp(sManager->pvTable);
+
+    if (nbEmpty <= sManager->masterOption.endDepth)
     {
-        branch = &sManager->branches[i];
-        if (branch != originBranch)
+        if (!sManager->isEndSearch)
         {
-            TreeClone(originBranch->tree, branch->tree);
+            sManager->isEndSearch = true;
+            // 中盤 ⇔ 終盤切り替え時，スコアが切り替わるので置換表内のスコアをリセット
+            HashTableResetScoreWindows(sManager->nwsTable);
+            HashTableResetScoreWindows(sManager->pvTable);
         }
     }
+    else
+    {
+        sManager->isEndSearch = false;
+    }
 }
 
 /**
@@ -255,12 +346,23 @@ void SearchManagerInit(SearchManager *sManager, int maxSubProcess, bool enableAs
     sManager->enableAsyncPreSearching = enableAsyncPreSearch;
     sManager->masterOption = DEFAULT_OPTION;
     sManager->primaryBranch = NULL;
+    sManager->numHelpers = maxSubProcess - 1;
+    sManager->useLazySmp = false;
+    sManager->helperNodeCount = 0;
 
     TreeInit(sManager->shallowTree, true);
 
+    HashTableInit(sManager->nwsTable, HashTableSizeFromMB(sManager->masterOption.hashSizeMB));
+    HashTableInit(sManager->pvTable, PV_TABLE_SIZE);
+    HashTableReset(sManager->nwsTable);
+    HashTableReset(sManager->pvTable);
+    sManager->isEndSearch = false;
+
+    SearchPoolInit(sManager->pool, maxSubProcess - 1, sManager->nwsTable, sManager->pvTable);
     for (int i = 0; i < maxSubProcess; i++)
     {
-        BranchInit(&sManager->branches[i], i);
+        BranchInit(&sManager->branches[i], i, sManager->nwsTable, sManager->pvTable);
+        TreeConfigPool(sManager->branches[i].tree, sManager->pool);
     }
 }
 
@@ -307,6 +409,68 @@ void SearchManagerConfigure(SearchManager *sManager, int mid, int end, int oneMo
     option->useMPC = useMPC;
 }
 
+/**
+ * @brief 共有ハッシュ表のサイズ設定
+ * 
+ * 実行中の探索はすべて終了させ，ハッシュ表を確保し直す（記録済みのデータは消える）。
+ * 確保できなければ元のハッシュ表とサイズ設定のまま探索を続けられる。
+ * 
+ * @param sManager 探索マネージャー
+ * @param hashSizeMB NWS用ハッシュ表のサイズ[MB]
+ * @return bool サイズを変更できたか
+ */
+bool SearchManagerConfigureHashSize(SearchManager *sManager, unsigned int hashSizeMB)
+{
+    DEBUG_PUTS("SearchManagerConfigureHashSize\n");
+    DEBUG_PRINTF("\thash:%u[MB]\n", hashSizeMB);
+    SearchManagerKillAll(sManager);
+
+    uint64_t size = HashTableSizeFromMB(hashSizeMB);
+    if (size != sManager->nwsTable->size)
+    {
+        if (!HashTableResize(sManager->nwsTable, size))
+        {
+            return false;
+        }
+        sManager->isEndSearch = false;
+    }
+    sManager->masterOption.hashSizeMB = hashSizeMB;
+    return true;
+}
+
+/**
+ * @brief メインルート探索の並列化の設定
+ * 
+ * 主探索以外のBranchが補助探索に使われるので，最大プロセス数-1が上限
+ * 0のときはスレッド群による分割探索も行わない
+ * 
+ * @param sManager 探索マネージャー
+ * @param numHelpers 補助探索数（0で並列探索を無効化）
+ * @param useLazySmp 中盤でルートの分割探索の代わりにLazy SMPを使うか
+ */
+void SearchManagerConfigureHelpers(SearchManager *sManager, int numHelpers, bool useLazySmp)
+{
+    DEBUG_PUTS("SearchManagerConfigureHelpers\n");
+    DEBUG_PRINTF("\thelpers:%d lazySmp:%d\n", numHelpers, useLazySmp);
+    SearchManagerKillAll(sManager);
+
+    if (numHelpers < 0)
+    {
+        numHelpers = 0;
+    }
+    if (numHelpers > sManager->numMaxBranches - 1)
+    {
+        numHelpers = sManager->numMaxBranches - 1;
+    }
+    sManager->numHelpers = numHelpers;
+    sManager->useLazySmp = useLazySmp;
+    sManager->masterOption.useRootSplit = !useLazySmp;
+    for (int i = 0; i < sManager->numMaxBranches; i++)
+    {
+        TreeConfigPool(sManager->branches[i].tree, numHelpers > 0 ? sManager->pool : NULL);
+    }
+}
+
 /**
  * @brief 探索マネージャーの解放
  * 
@@ -320,6 +484,10 @@ void SearchManagerDelete(SearchManager *sManager)
         BranchDelete(&sManager->branches[i]);
     }
     free(sManager->branches);
+    SearchPoolDelete(sManager->pool);
+    TreeDelete(sManager->shallowTree);
+    HashTableFree(sManager->nwsTable);
+    HashTableFree(sManager->pvTable);
 }
 
 /**
@@ -349,10 +517,9 @@ void SearchManagerReset(SearchManager *sManager, uint64_t own, uint64_t opp)
 {
     DEBUG_PUTS("SearchManagerReset\n");
     SearchManagerSetup(sManager, own, opp);
-    for (int i = 0; i < sManager->numMaxBranches; i++)
-    {
-        TreeReset(sManager->branches[i].tree);
-    }
+    HashTableReset(sManager->nwsTable);
+    HashTableReset(sManager->pvTable);
+    sManager->isEndSearch = false;
 }
 
 /**
@@ -384,7 +551,7 @@ BranchProcess *SearchManagerKillWithoutEnemyPut(SearchManager *sManager, uint8 e
         }
         else
         {
-            branch->tree->killFlag = true;
+            AtomicStore32(&branch->tree->killFlag, true);
         }
     }
 
@@ -394,7 +561,9 @@ BranchProcess *SearchManagerKillWithoutEnemyPut(SearchManager *sManager, uint8 e
         branch = &sManager->branches[i];
         if (branch->state != BRANCH_WAIT && branch->enemyMove != enemyPos)
         {
-            WaitForSingleObject(branch->processHandle, INFINITE);
+            ThreadJoin(branch->thread);
+            branch->state = BRANCH_WAIT;
+            AtomicStore32(&branch->tree->killFlag, false);
         }
     }
 
@@ -403,6 +572,11 @@ BranchProcess *SearchManagerKillWithoutEnemyPut(SearchManager *sManager, uint8 e
     {
         sManager->state = SM_WAIT;
     }
+    else
+    {
+        // 空いたBranchでメインルートの探索を手伝う
+        HelpersLaunch(sManager, primary, sManager->stones);
+    }
 
     return primary;
 }
@@ -424,13 +598,16 @@ void SearchManagerStartPrimeSearch(SearchManager *sManager)
     DEBUG_PRINTF("\t PrimeSearch Processing @Branch:%d\n", branch->id);
     DEBUG_PRINTF("\t own:%llu opp:%llu\n", sManager->stones->own, sManager->stones->opp);
 
-    branch->tree->killFlag = false;
-    branch->processHandle = NULL;
+    AtomicStore32(&branch->tree->killFlag, false);
+    ThreadJoin(branch->thread);
 
     branch->state = BRANCH_PRIME_SEARCH;
     {
+        PrepareSharedHash(sManager, CountBits(~(sManager->stones->own | sManager->stones->opp)));
         TreeConfigClone(branch->tree, sManager->masterOption);
+        HelpersLaunch(sManager, branch, sManager->stones);
         SearchWithSetup(branch->tree, sManager->stones->own, sManager->stones->opp, false);
+        HelpersKill(sManager);
     }
     branch->state = BRANCH_WAIT;
 
@@ -476,6 +653,8 @@ void SearchManagerStartPreSearch(SearchManager *sManager)
     // 各Branchで非同期探索開始
     sManager->state = SM_PRE_SEARCH;
     sManager->primaryBranch = NULL;
+    // Branchの盤面は相手の着手後なので空きマスが1つ少ない
+    PrepareSharedHash(sManager, CountBits(~(sManager->stones->own | sManager->stones->opp)) - 1);
     for (int i = 0; i < sManager->numMaxBranches; i++)
     {
         assert(sManager->branches[i].state == BRANCH_WAIT);
@@ -601,33 +780,33 @@ uint8 SearchManagerGetMove(SearchManager *sManager, score_t map[64])
     BranchProcess *primaryBranch = sManager->primaryBranch;
 
     // 探索中なら待機
-    if (sManager->state == SM_PRIMARY_SEARCH && primaryBranch->processHandle)
+    if (sManager->state == SM_PRIMARY_SEARCH && primaryBranch->thread->isJoinable)
     {
         if (sManager->masterOption.useTimeLimit)
         {
-            DWORD primeThreadState;
             DEBUG_PUTS("\tUse Timer\n");
-            GetExitCodeThread(primaryBranch->processHandle, &primeThreadState);
-            if (primeThreadState == STILL_ACTIVE)
+            if (ThreadIsRunning(primaryBranch->thread))
             {
                 DEBUG_PUTS("\tSleep\n");
-                Sleep(1000 * sManager->masterOption.oneMoveTime);
+                ThreadSleep(1000 * sManager->masterOption.oneMoveTime);
             }
         }
         else
         {
-            DEBUG_PUTS("\tWaitForSingleObject(primaryBranch->processHandle)\n");
-            WaitForSingleObject(primaryBranch->processHandle, INFINITE);
+            DEBUG_PUTS("\tThreadJoin(primaryBranch->thread)\n");
+            ThreadJoin(primaryBranch->thread);
         }
     }
 
     SearchManagerKillAll(sManager);
 
     SearchTree *tree = primaryBranch->tree;
+    // 補助探索のノード数も含める
+    size_t nodeCount = tree->nodeCount + sManager->helperNodeCount;
     CopyScoreMap(tree->scoreMap, map);
     strcpy(sManager->msg, tree->msg);
     printf("探索深度:%d 思考時間：%.2f[s]  探索ノード数：%.2f[MNode]  探索速度：%.2f[MNode/s]  ",
-           tree->completeDepth, tree->usedTime, tree->nodeCount / 1000000.0f, tree->nodeCount / tree->usedTime / 1000000.0f);
+           tree->completeDepth, tree->usedTime, nodeCount / 1000000.0f, nodeCount / tree->usedTime / 1000000.0f);
     if (tree->isEndSearch)
     {
         printf("推定CPUスコア：%.1f(完)", tree->score);
@@ -640,8 +819,6 @@ uint8 SearchManagerGetMove(SearchManager *sManager, score_t map[64])
 
     sManager->state = SM_WAIT;
 
-    // メイン探索のハッシュ情報など，ツリー情報まるごとクローン
-    //BroadcastTreeToAllBranch(sManager, primaryBranch);
     return BestMoveFromMap(map);
 }
 
@@ -657,7 +834,7 @@ void SearchManagerKillAll(SearchManager *sManager)
     for (int i = 0; i < sManager->numMaxBranches; i++)
     {
         BranchProcess *branch = &sManager->branches[i];
-        branch->tree->killFlag = true;
+        AtomicStore32(&branch->tree->killFlag, true);
     }
 
     // 終了待ち
@@ -666,9 +843,14 @@ void SearchManagerKillAll(SearchManager *sManager)
         BranchProcess *branch = &sManager->branches[i];
         if (branch->state != BRANCH_WAIT)
         {
-            WaitForSingleObject(branch->processHandle, INFINITE);
+            ThreadJoin(branch->thread);
+            if (branch->state == BRANCH_HELPER_SEARCH)
+            {
+                sManager->helperNodeCount += branch->tree->nodeCount;
+                TreeConfigHelper(branch->tree, 0);
+            }
             branch->state = BRANCH_WAIT;
-            branch->tree->killFlag = false;
+            AtomicStore32(&branch->tree->killFlag, false);
         }
     }
 
@@ -1,12 +1,10 @@
 #if !defined(_SEARCH_MANAGER_H_)
 #define _SEARCH_MANAGER_H_
 
-#undef D8
-#include <process.h>
-#include <windows.h>
-
 #include "../const.h"
 #include "search.h"
+#include "search_pool.h"
+#include "thread_util.h"
 
 #define DEFAULT_PROCESS_NUM 4
 
@@ -15,6 +13,7 @@ typedef enum BranchState
     BRANCH_WAIT,
     BRANCH_PRE_SEARCH,
     BRANCH_PRIME_SEARCH,
+    BRANCH_HELPER_SEARCH,
 } BranchState;
 
 typedef enum SearchMangerState
@@ -30,8 +29,7 @@ typedef struct BranchProcess
 {
     int id;
     SearchTree tree[1];
-    HANDLE processHandle;
-    HANDLE scoreMapMutex;
+    Thread thread[1];
     BranchState state;
 
     uint8 enemyMove;
@@ -47,10 +45,24 @@ typedef struct SearchManager
     SearchMangerState state;
     SearchOption masterOption;
 
+    // 全Branchで共有する置換表
+    HashTable nwsTable[1];
+    HashTable pvTable[1];
+    // 共有置換表内のスコアが終盤探索のものか
+    bool isEndSearch;
+    // 終盤探索で残りの着手を分担するスレッド群
+    SearchPool pool[1];
+
     score_t scoreMap[64];
 
     int numMaxBranches;
     int numBranches;
+    // メインルート探索を手伝うLazy SMPの補助探索数
+    int numHelpers;
+    // 中盤でルートの分割探索の代わりにLazy SMPを使うか
+    bool useLazySmp;
+    // 補助探索の探索ノード数
+    size_t helperNodeCount;
 
     bool enableAsyncPreSearching;
 
@@ -61,6 +73,8 @@ typedef struct SearchManager
 void SearchManagerInit(SearchManager *sManager, int maxSubProcess, bool enableAsyncPreSearch);
 void SearchManagerConfigureDepth(SearchManager *sManager, int mid, int end);
 void SearchManagerConfigure(SearchManager *sManager, int mid, int end, int oneMoveTime, bool useIDD, bool useTimer, bool useMPC);
+bool SearchManagerConfigureHashSize(SearchManager *sManager, unsigned int hashSizeMB);
+void SearchManagerConfigureHelpers(SearchManager *sManager, int numHelpers, bool useLazySmp);
 void SearchManagerDelete(SearchManager *sManager);
 void SearchManagerSetup(SearchManager *sManager, uint64_t own, uint64_t opp);
 void SearchManagerReset(SearchManager *sManager, uint64_t own, uint64_t opp);
@@ -0,0 +1,235 @@
+/**
+ * @file search_pool.c
+ * @author Daichi Sato
+ * @brief 分割点の探索を手伝うスレッド群（YBWC）
+ * @version 1.0
+ * @date 2021-03-01
+ *
+ * @copyright Copyright (c) 2021 Daichi Sato
+ *
+ * Young Brothers Wait Concept:
+ * ノードの最初の子ノード（長男）を探索し終えてから，残りの子ノード（弟）を
+ * 待機中のスレッドに分担させる。長男の探索で探索窓が決まるので，無駄な探索が少ない。
+ *
+ * 分割した探索木（マスター）も弟の探索に参加し，すべての弟の探索が終わるまで待機する。
+ * 補助スレッド側でさらに分割することもできる。
+ * βカットが起きた分割点の下の探索は打ち切られ，そのスコアは置換表に登録しない。
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "search_pool.h"
+
+/**
+ * @brief 割り当てられた分割点を探索する
+ *
+ * @param worker 補助スレッド
+ * @param sp 分割点
+ */
+static void WorkerSearch(SearchWorker *worker, SplitPoint *sp)
+{
+    SearchTree *tree = worker->tree;
+    SearchTree *master = sp->master;
+
+    // 分割したノードの盤面・探索設定を再現
+    tree->option = master->option;
+    tree->orderDepth = master->orderDepth;
+    tree->hashDepth = master->hashDepth;
+    tree->pvHashDepth = master->pvHashDepth;
+    tree->pvsDepth = master->pvsDepth;
+    tree->depth = master->depth;
+    tree->isEndSearch = master->isEndSearch;
+    tree->isIntrrupted = false;
+    AtomicStore64(&tree->timeLimit, AtomicLoad64(&master->timeLimit));
+    *tree->stones = *sp->stones;
+    tree->hashCode[0] = sp->hashCode[0];
+    tree->hashCode[1] = sp->hashCode[1];
+    tree->nbEmpty = sp->nbEmpty;
+    tree->nbMpcNested = 0;
+    tree->nodeCount = 0;
+    EvalLoadState(tree->eval, sp->featureStates, sp->evalPlayer, sp->nbEmpty);
+
+    tree->splitPoint = sp;
+    sp->Search(tree, sp);
+    tree->splitPoint = NULL;
+
+    SpinLockAcquire(&sp->lock);
+    sp->nodeCount += tree->nodeCount;
+    SpinLockRelease(&sp->lock);
+
+    // これ以降spはマスター側で破棄されうる
+    AtomicDecrement32(&sp->nbSlaves);
+}
+
+/**
+ * @brief 補助スレッドのメインループ
+ *
+ * @param arg 補助スレッド
+ */
+static void WorkerLoop(void *arg)
+{
+    SearchWorker *worker = (SearchWorker *)arg;
+    int32_t state;
+
+    while ((state = AtomicLoad32(&worker->state)) != WORKER_QUIT)
+    {
+        if (state == WORKER_SEARCHING)
+        {
+            WorkerSearch(worker, worker->splitPoint);
+            AtomicStore32(&worker->state, WORKER_IDLE);
+        }
+        else if (AtomicLoad32(&worker->pool->nbActive) > 0)
+        {
+            // 分割の依頼にすぐ応えられるよう待機
+            ThreadYield();
+        }
+        else
+        {
+            ThreadSleep(1);
+        }
+    }
+}
+
+/**
+ * @brief スレッド群の初期化
+ *
+ * 各スレッドの探索木は置換表を共有する
+ *
+ * @param pool スレッド群
+ * @param nbWorkers スレッド数
+ * @param nwsTable 共有するNullWindowSearch用ハッシュ表
+ * @param pvTable 共有するPVノード用ハッシュ表
+ */
+void SearchPoolInit(SearchPool *pool, int nbWorkers, HashTable *nwsTable, HashTable *pvTable)
+{
+    pool->nbWorkers = nbWorkers;
+    pool->nbActive = 0;
+    pool->workers = NULL;
+    if (nbWorkers <= 0)
+    {
+        pool->nbWorkers = 0;
+        return;
+    }
+
+    pool->workers = (SearchWorker *)malloc(nbWorkers * sizeof(SearchWorker));
+    for (int i = 0; i < nbWorkers; i++)
+    {
+        SearchWorker *worker = &pool->workers[i];
+        TreeInitShared(worker->tree, nwsTable, pvTable);
+        // 補助スレッド側でもさらに分割できる
+        TreeConfigPool(worker->tree, pool);
+        ThreadInit(worker->thread);
+        worker->pool = pool;
+        worker->splitPoint = NULL;
+        worker->state = WORKER_IDLE;
+        ThreadCreate(worker->thread, WorkerLoop, worker);
+    }
+}
+
+/**
+ * @brief スレッド群の解放
+ *
+ * 分割探索を利用中の探索がないときに呼び出すこと
+ *
+ * @param pool スレッド群
+ */
+void SearchPoolDelete(SearchPool *pool)
+{
+    for (int i = 0; i < pool->nbWorkers; i++)
+    {
+        AtomicStore32(&pool->workers[i].state, WORKER_QUIT);
+    }
+    for (int i = 0; i < pool->nbWorkers; i++)
+    {
+        ThreadJoin(pool->workers[i].thread);
+        TreeDelete(pool->workers[i].tree);
+    }
+    free(pool->workers);
+    pool->workers = NULL;
+    pool->nbWorkers = 0;
+}
+
+/**
+ * @brief 分割探索の利用を開始する（待機中のスレッドを起こす）
+ *
+ * @param pool スレッド群
+ */
+void SearchPoolActivate(SearchPool *pool)
+{
+    AtomicIncrement32(&pool->nbActive);
+}
+
+/**
+ * @brief 分割探索の利用を終了する
+ *
+ * @param pool スレッド群
+ */
+void SearchPoolDeactivate(SearchPool *pool)
+{
+    AtomicDecrement32(&pool->nbActive);
+}
+
+/**
+ * @brief 残りの着手を待機中のスレッドと分担して探索する
+ *
+ * spには呼び出し側で，探索関数・最後に探索した着手(cursor)・深度・探索窓・それまでの最善手
+ * （ルートノードではスコアマップと次善手も）を設定しておく。
+ * 分担できるスレッドがなければ何もせずfalseを返すので，呼び出し側でそのまま探索を続ける。
+ * trueを返したときは，spに全着手の探索結果が入っている。
+ *
+ * @param tree 分割する探索木
+ * @param sp 分割点（呼び出し側で確保）
+ * @return bool 分割探索したか
+ */
+bool SearchPoolSplit(SearchTree *tree, SplitPoint *sp)
+{
+    SearchPool *pool = tree->pool;
+
+    SpinLockInit(&sp->lock);
+    sp->parent = tree->splitPoint;
+    *sp->stones = *tree->stones;
+    sp->hashCode[0] = tree->hashCode[0];
+    sp->hashCode[1] = tree->hashCode[1];
+    sp->nbEmpty = tree->nbEmpty;
+    memcpy(sp->featureStates, tree->eval->FeatureStates, sizeof(sp->featureStates));
+    sp->evalPlayer = tree->eval->player;
+    sp->master = tree;
+    sp->isAborted = false;
+    sp->nbSlaves = 0;
+    sp->nodeCount = 0;
+
+    // 待機中のスレッドを確保して割り当てる
+    for (int i = 0; i < pool->nbWorkers; i++)
+    {
+        SearchWorker *worker = &pool->workers[i];
+        if (AtomicLoad32(&worker->state) != WORKER_IDLE)
+            continue;
+        if (AtomicCompareExchange32(&worker->state, WORKER_RESERVED, WORKER_IDLE) != WORKER_IDLE)
+            continue;
+
+        worker->splitPoint = sp;
+        AtomicIncrement32(&sp->nbSlaves);
+        AtomicStore32(&worker->state, WORKER_SEARCHING);
+    }
+
+    if (AtomicLoad32(&sp->nbSlaves) == 0)
+    {
+        return false;
+    }
+
+    // マスターも探索に参加
+    tree->splitPoint = sp;
+    sp->Search(tree, sp);
+
+    // 補助スレッドの探索終了を待機
+    while (AtomicLoad32(&sp->nbSlaves) > 0)
+    {
+        ThreadYield();
+    }
+    tree->splitPoint = sp->parent;
+    tree->nodeCount += sp->nodeCount;
+
+    return true;
+}
@@ -0,0 +1,124 @@
+#if !defined(_SEARCH_POOL_H_)
+#define _SEARCH_POOL_H_
+
+#include "../const.h"
+#include "../stones.h"
+#include "search.h"
+#include "moves.h"
+#include "thread_util.h"
+
+// 分割探索を行う最小の残り深度（これより浅いノードは分割のコストに見合わない）
+#define SPLIT_MIN_DEPTH 12
+// 中盤探索でルートの着手を分担する最小の探索深度
+#define MID_ROOT_SPLIT_MIN_DEPTH 6
+
+struct SplitPoint;
+// 分割点の残りの着手を探索する関数
+typedef void (*SplitSearchFunc_t)(SearchTree *tree, struct SplitPoint *sp);
+
+typedef enum WorkerState
+{
+    WORKER_IDLE,
+    // 分割点に割り当て中
+    WORKER_RESERVED,
+    WORKER_SEARCHING,
+    WORKER_QUIT,
+} WorkerState;
+
+/**
+ * @brief 分割点（YBWC）
+ *
+ * 最初の子ノードを探索し終えたノードの，残りの着手を複数スレッドで分担して探索する。
+ * 着手リストと探索窓はロックで保護し，βカットが起きたらisAbortedで分担中の探索を打ち切る。
+ * ルートノードの分割点では，各スレッドが空いたら次の着手を取り出す（ワークスティーリング）ので，
+ * スコアマップも分割点のロックで保護して更新する。
+ */
+typedef struct SplitPoint
+{
+    SpinLock lock;
+    // 親ノード側の分割点（打ち切りの伝搬用）
+    struct SplitPoint *parent;
+
+    // 分割したノードの盤面
+    Stones stones[1];
+    uint64_t hashCode[2];
+    uint8 nbEmpty;
+    // 分割したノードの評価器の状態（補助スレッドはこれを写して探索を始める）
+    unsigned short featureStates[FEAT_NUM_PADDED];
+    uint8 evalPlayer;
+    // 分割した探索木（探索設定・中断フラグの参照元）
+    SearchTree *master;
+    // 残りの着手を探索する関数
+    SplitSearchFunc_t Search;
+
+    // 最後に取り出した着手（次の着手は入れ替えソートで取り出す）
+    Move *cursor;
+    unsigned char depth;
+    // PVノードか（PVノードではNWSで外れた着手を通常の窓で再探索する）
+    bool isPv;
+
+    score_t alpha;
+    score_t beta;
+    score_t bestScore;
+    uint8 bestMove;
+    // 次善手（ルートノードのみ）
+    uint8 secondMove;
+    // 着手ごとのスコアの出力先（ルートノードのみ，それ以外はNULL）
+    score_t *scoreMap;
+    // βカット・探索の中断で打ち切られたか
+    atomic32_t isAborted;
+
+    // 探索中の補助スレッド数
+    atomic32_t nbSlaves;
+    // 補助スレッドの探索ノード数
+    size_t nodeCount;
+} SplitPoint;
+
+typedef struct SearchWorker
+{
+    SearchTree tree[1];
+    Thread thread[1];
+    struct SearchPool *pool;
+    atomic32_t state;
+    // 割り当てられた分割点
+    SplitPoint *splitPoint;
+} SearchWorker;
+
+/**
+ * @brief 分割点の探索を手伝うスレッド群
+ *
+ * 複数の探索木から同時に利用できる。
+ */
+typedef struct SearchPool
+{
+    SearchWorker *workers;
+    int nbWorkers;
+    // 分割探索を利用中の探索木の数（0の間はスレッドを休ませる）
+    atomic32_t nbActive;
+} SearchPool;
+
+void SearchPoolInit(SearchPool *pool, int nbWorkers, HashTable *nwsTable, HashTable *pvTable);
+void SearchPoolDelete(SearchPool *pool);
+void SearchPoolActivate(SearchPool *pool);
+void SearchPoolDeactivate(SearchPool *pool);
+bool SearchPoolSplit(SearchTree *tree, SplitPoint *sp);
+
+/**
+ * @brief 探索中のノードが，βカットにより打ち切られた分割点の下にあるか
+ *
+ * 打ち切られた探索のスコアは不正確なので，置換表に登録してはいけない
+ *
+ * @param tree 探索木
+ * @return bool 打ち切られたか
+ */
+inline bool SplitIsAborted(const SearchTree *tree)
+{
+    for (const SplitPoint *sp = tree->splitPoint; sp != NULL; sp = sp->parent)
+    {
+        if (AtomicLoad32(&sp->isAborted))
+            return true;
+    }
+    return false;
+}
+
+#endif // _SEARCH_POOL_H_
@@ -0,0 +1,229 @@
+/**
+ * @file stability.c
+ * @author Daichi Sato
+ * @brief 確定石の推定
+ * @version 1.0
+ * @date 2021-03-01
+ *
+ * @copyright Copyright (c) 2021 Daichi Sato
+ *
+ * 終盤探索の枝刈り（確定石カット）に使う，確定石数の下限を高速に計算する。
+ * ・辺の確定石：辺の8マスだけで起こりうる全進行を事前に調べた表から求める
+ * ・内側の確定石：4方向すべての列が埋まっている石
+ * ・伝搬：4方向それぞれで，列が埋まっているか隣が確定石である石
+ * 求まるのは確定石の一部（下限）だが，確定石と判定した石は必ず確定石である。
+ *
+ */
+
+#include "stability.h"
+#include "../bit_operation.h"
+
+// 辺の確定石[自分の石の配置][相手の石の配置] = 自分の確定石の配置
+static uint8 EdgeStability[256][256];
+// 列方向に詰めた8bitを，A列(各行の最下位bit)の配置に戻す表
+static uint64_t ColumnFromByte[256];
+
+/**
+ * @brief 辺上で着手したときに挟まれる石を返す
+ *
+ * @param own 着手する側の石の配置（8bit）
+ * @param opp 相手の石の配置（8bit）
+ * @param x 着手位置（0~7）
+ * @return int 反転する石の配置（8bit）
+ */
+static int FlipEdge(const int own, const int opp, const int x)
+{
+    int flip = 0;
+    int y, line;
+
+    // 下位bit側
+    line = 0;
+    for (y = x - 1; y >= 0 && (opp & (1 << y)); y--)
+        line |= 1 << y;
+    if (y >= 0 && (own & (1 << y)))
+        flip |= line;
+
+    // 上位bit側
+    line = 0;
+    for (y = x + 1; y < 8 && (opp & (1 << y)); y++)
+        line |= 1 << y;
+    if (y < 8 && (own & (1 << y)))
+        flip |= line;
+
+    return flip;
+}
+
+/**
+ * @brief 辺の確定石を探す
+ *
+ * 空きマスにどちらが打っても（合法手かどうかに関わらず）返らない石を確定石とする
+ *
+ * @param own 自分の石の配置（8bit）
+ * @param opp 相手の石の配置（8bit）
+ * @param stable 確定石の候補
+ * @return int 確定石の配置（8bit）
+ */
+static int FindEdgeStable(const int own, const int opp, int stable)
+{
+    const int empty = ~(own | opp) & 0xff;
+    int x, bit, flip;
+
+    stable &= own;
+    if (stable == 0 || empty == 0)
+        return stable;
+
+    for (x = 0; x < 8; x++)
+    {
+        bit = 1 << x;
+        if (!(empty & bit))
+            continue;
+
+        // 自分が打つ
+        flip = FlipEdge(own, opp, x);
+        stable = FindEdgeStable(own | bit | flip, opp ^ flip, stable);
+        if (stable == 0)
+            return stable;
+
+        // 相手が打つ
+        flip = FlipEdge(opp, own, x);
+        stable = FindEdgeStable(own ^ flip, opp | bit | flip, stable);
+        if (stable == 0)
+            return stable;
+    }
+    return stable;
+}
+
+/**
+ * @brief 確定石計算用の表を初期化
+ */
+void StabilityInit()
+{
+    for (int own = 0; own < 256; own++)
+    {
+        for (int opp = 0; opp < 256; opp++)
+        {
+            if (own & opp)
+                EdgeStability[own][opp] = 0;
+            else
+                EdgeStability[own][opp] = (uint8)FindEdgeStable(own, opp, own);
+        }
+    }
+
+    for (int b = 0; b < 256; b++)
+    {
+        ColumnFromByte[b] = 0;
+        for (int row = 0; row < 8; row++)
+        {
+            if (b & (1 << row))
+                ColumnFromByte[b] |= (uint64_t)1 << (row * 8);
+        }
+    }
+}
+
+/**
+ * @brief A列(各行の最下位bit)の配置を8bitに詰める
+ *
+ * @param bits 盤面（A列以外は無視）
+ * @return int 行番号のビット列
+ */
+static inline int PackColumn(const uint64_t bits)
+{
+    return (int)(((bits & 0x0101010101010101ULL) * 0x0102040810204080ULL) >> 56);
+}
+
+/**
+ * @brief 4辺の確定石を計算
+ *
+ * @param own 自分の石
+ * @param opp 相手の石
+ * @return uint64_t 自分の辺の確定石
+ */
+static inline uint64_t GetStableEdge(const uint64_t own, const uint64_t opp)
+{
+    uint64_t stable;
+
+    stable = EdgeStability[own & 0xff][opp & 0xff];
+    stable |= (uint64_t)EdgeStability[own >> 56][opp >> 56] << 56;
+    stable |= ColumnFromByte[EdgeStability[PackColumn(own)][PackColumn(opp)]];
+    stable |= ColumnFromByte[EdgeStability[PackColumn(own >> 7)][PackColumn(opp >> 7)]] << 7;
+    return stable;
+}
+
+/**
+ * @brief 埋まっている列を計算
+ *
+ * ナナメは，各マスから端までが埋まっているかを1,2,4マス先へと倍々に調べる
+ * （端から一定距離以内のマスは，そこで調べ終わっているのでマスクで通す）
+ *
+ * @param disc 石のあるマス
+ * @param full 出力：ヨコ・タテ・ナナメ(9方向)・ナナメ(7方向)の列がすべて埋まっているマス
+ */
+static inline void GetFullLines(const uint64_t disc, uint64_t full[4])
+{
+    uint64_t t, l, r;
+
+    // ヨコ
+    t = disc & (disc >> 1);
+    t &= t >> 2;
+    t &= t >> 4;
+    full[0] = (t & 0x0101010101010101ULL) * 0xff;
+
+    // タテ
+    t = disc & (disc >> 8);
+    t &= t >> 16;
+    t &= t >> 32;
+    full[1] = (t & 0xff) * 0x0101010101010101ULL;
+
+    // ナナメ(+9/-9)
+    l = r = disc;
+    l &= 0xff80808080808080ULL | (l >> 9);
+    r &= 0x01010101010101ffULL | (r << 9);
+    l &= 0xffffc0c0c0c0c0c0ULL | (l >> 18);
+    r &= 0x030303030303ffffULL | (r << 18);
+    l &= 0xfffffffff0f0f0f0ULL | (l >> 36);
+    r &= 0x0f0f0f0fffffffffULL | (r << 36);
+    full[2] = l & r;
+
+    // ナナメ(+7/-7)
+    l = r = disc;
+    l &= 0xff01010101010101ULL | (l >> 7);
+    r &= 0x80808080808080ffULL | (r << 7);
+    l &= 0xffff030303030303ULL | (l >> 14);
+    r &= 0xc0c0c0c0c0c0ffffULL | (r << 14);
+    l &= 0xffffffff0f0f0f0fULL | (l >> 28);
+    r &= 0xf0f0f0f0ffffffffULL | (r << 28);
+    full[3] = l & r;
+}
+
+/**
+ * @brief 確定石の数（下限）を数える
+ *
+ * @param own 確定石を数える側の石
+ * @param opp 相手の石
+ * @return uint8 確定石の数
+ */
+uint8 CountStableDiscs(const uint64_t own, const uint64_t opp)
+{
+    const uint64_t ownCentral = own & 0x007e7e7e7e7e7e00ULL;
+    uint64_t full[4];
+    uint64_t stable, prevStable;
+    uint64_t stableH, stableV, stableD9, stableD7;
+
+    GetFullLines(own | opp, full);
+
+    stable = GetStableEdge(own, opp);
+    stable |= full[0] & full[1] & full[2] & full[3] & ownCentral;
+
+    // 4方向すべてで，列が埋まっているか隣の石が確定石なら確定石
+    do
+    {
+        prevStable = stable;
+        stableH = (stable >> 1) | (stable << 1) | full[0];
+        stableV = (stable >> 8) | (stable << 8) | full[1];
+        stableD9 = (stable >> 9) | (stable << 9) | full[2];
+        stableD7 = (stable >> 7) | (stable << 7) | full[3];
+        stable |= stableH & stableV & stableD9 & stableD7 & ownCentral;
+    } while (stable != prevStable);
+
+    return CountBits(stable);
+}
@@ -0,0 +1,10 @@
+#if !defined(_STABILITY_H_)
+#define _STABILITY_H_
+
+#include <stdint.h>
+#include "../const.h"
+
+void StabilityInit();
+uint8 CountStableDiscs(const uint64_t own, const uint64_t opp);
+
+#endif // _STABILITY_H_
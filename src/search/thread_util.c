@@ -0,0 +1,165 @@
+/**
+ * @file thread_util.c
+ * @author Daichi Sato
+ * @brief スレッド・時計のプラットフォーム差の吸収
+ * @version 1.0
+ * @date 2021-03-01
+ *
+ * @copyright Copyright (c) 2021 Daichi Sato
+ *
+ * WindowsではWin32 API，それ以外ではpthreadを使ってスレッドを起動・待機する。
+ * 探索の時間制限には，CPU時間ではなく単調増加する実時間を使う。
+ *
+ */
+
+#include <time.h>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <sched.h>
+#include <unistd.h>
+#endif
+#include "thread_util.h"
+
+/**
+ * @brief スレッドの入り口
+ *
+ * @param arg 起動したスレッド
+ */
+#ifdef _WIN32
+static unsigned __stdcall ThreadEntry(void *arg)
+#else
+static void *ThreadEntry(void *arg)
+#endif
+{
+    Thread *thread = (Thread *)arg;
+    thread->func(thread->arg);
+    AtomicStore32(&thread->isFinished, true);
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+/**
+ * @brief 未起動状態で初期化
+ *
+ * @param thread スレッド
+ */
+void ThreadInit(Thread *thread)
+{
+    thread->func = NULL;
+    thread->arg = NULL;
+    thread->isJoinable = false;
+    thread->isFinished = true;
+}
+
+/**
+ * @brief スレッドを起動する
+ *
+ * threadは終了を待機するまで同じアドレスに置いておくこと
+ *
+ * @param thread スレッド
+ * @param func 実行する関数
+ * @param arg 関数の引数
+ * @return bool 起動できたか
+ */
+bool ThreadCreate(Thread *thread, ThreadFunc_t func, void *arg)
+{
+    ThreadJoin(thread);
+    thread->func = func;
+    thread->arg = arg;
+    thread->isFinished = false;
+#ifdef _WIN32
+    thread->handle = (HANDLE)_beginthreadex(NULL, 0, ThreadEntry, thread, 0, NULL);
+    thread->isJoinable = thread->handle != 0;
+#else
+    thread->isJoinable = pthread_create(&thread->handle, NULL, ThreadEntry, thread) == 0;
+#endif
+    if (!thread->isJoinable)
+    {
+        thread->isFinished = true;
+    }
+    return thread->isJoinable;
+}
+
+/**
+ * @brief スレッドの終了を待機する（起動していなければ何もしない）
+ *
+ * @param thread スレッド
+ */
+void ThreadJoin(Thread *thread)
+{
+    if (!thread->isJoinable)
+    {
+        return;
+    }
+#ifdef _WIN32
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+#else
+    pthread_join(thread->handle, NULL);
+#endif
+    thread->isJoinable = false;
+}
+
+/**
+ * @brief スレッドが実行中か
+ *
+ * @param thread スレッド
+ * @return bool 実行中か
+ */
+bool ThreadIsRunning(Thread *thread)
+{
+    return thread->isJoinable && !AtomicLoad32(&thread->isFinished);
+}
+
+/**
+ * @brief 呼び出したスレッドを停止する
+ *
+ * @param ms 停止時間[ms]
+ */
+void ThreadSleep(unsigned int ms)
+{
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    usleep((useconds_t)ms * 1000);
+#endif
+}
+
+/**
+ * @brief 呼び出したスレッドの残りのタイムスライスを他のスレッドに譲る
+ */
+void ThreadYield()
+{
+#ifdef _WIN32
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
+/**
+ * @brief 単調増加する現在時刻を取得
+ *
+ * @return int64_t 現在時刻[ms]（起点は環境依存，差分のみ意味を持つ）
+ */
+int64_t TimeNowMs()
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency = {0};
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0)
+    {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart * 1000 / frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+#endif
+}
@@ -0,0 +1,152 @@
+#if !defined(_THREAD_UTIL_H_)
+#define _THREAD_UTIL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef _WIN32
+#undef D8
+#include <windows.h>
+#include <intrin.h>
+#else
+#include <pthread.h>
+#endif
+
+// 複数スレッドから読み書きされる値
+typedef volatile int32_t atomic32_t;
+typedef volatile int64_t atomic64_t;
+
+// スレッドで実行する関数
+typedef void (*ThreadFunc_t)(void *arg);
+
+// スレッド
+typedef struct Thread
+{
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+    ThreadFunc_t func;
+    void *arg;
+    // 起動済みでまだ終了を待機していないか
+    bool isJoinable;
+    // 関数の実行を終えたか
+    atomic32_t isFinished;
+} Thread;
+
+void ThreadInit(Thread *thread);
+bool ThreadCreate(Thread *thread, ThreadFunc_t func, void *arg);
+void ThreadJoin(Thread *thread);
+bool ThreadIsRunning(Thread *thread);
+void ThreadSleep(unsigned int ms);
+void ThreadYield();
+
+int64_t TimeNowMs();
+
+#ifdef _WIN32
+// x86/x64ではvolatileの読み書きにacquire/releaseの順序保証があるので，コンパイラの並び替えだけ防ぐ
+#define AtomicFenceAcquire() _ReadWriteBarrier()
+
+inline int32_t AtomicLoad32(const atomic32_t *target)
+{
+    int32_t value = *target;
+    _ReadWriteBarrier();
+    return value;
+}
+
+inline void AtomicStore32(atomic32_t *target, int32_t value)
+{
+    InterlockedExchange((volatile LONG *)target, value);
+}
+
+inline int32_t AtomicCompareExchange32(atomic32_t *target, int32_t exchange, int32_t comparand)
+{
+    return InterlockedCompareExchange((volatile LONG *)target, exchange, comparand);
+}
+
+inline int32_t AtomicIncrement32(atomic32_t *target)
+{
+    return InterlockedIncrement((volatile LONG *)target);
+}
+
+inline int32_t AtomicDecrement32(atomic32_t *target)
+{
+    return InterlockedDecrement((volatile LONG *)target);
+}
+
+inline int64_t AtomicLoad64(const atomic64_t *target)
+{
+    int64_t value = *target;
+    _ReadWriteBarrier();
+    return value;
+}
+
+inline void AtomicStore64(atomic64_t *target, int64_t value)
+{
+    InterlockedExchange64((volatile LONG64 *)target, value);
+}
+#else
+#define AtomicFenceAcquire() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+
+inline int32_t AtomicLoad32(const atomic32_t *target)
+{
+    return __atomic_load_n(target, __ATOMIC_ACQUIRE);
+}
+
+inline void AtomicStore32(atomic32_t *target, int32_t value)
+{
+    __atomic_store_n(target, value, __ATOMIC_SEQ_CST);
+}
+
+inline int32_t AtomicCompareExchange32(atomic32_t *target, int32_t exchange, int32_t comparand)
+{
+    __atomic_compare_exchange_n(target, &comparand, exchange, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return comparand;
+}
+
+inline int32_t AtomicIncrement32(atomic32_t *target)
+{
+    return __atomic_add_fetch(target, 1, __ATOMIC_SEQ_CST);
+}
+
+inline int32_t AtomicDecrement32(atomic32_t *target)
+{
+    return __atomic_sub_fetch(target, 1, __ATOMIC_SEQ_CST);
+}
+
+inline int64_t AtomicLoad64(const atomic64_t *target)
+{
+    return __atomic_load_n(target, __ATOMIC_ACQUIRE);
+}
+
+inline void AtomicStore64(atomic64_t *target, int64_t value)
+{
+    __atomic_store_n(target, value, __ATOMIC_SEQ_CST);
+}
+#endif
+
+// 短い区間を保護するスピンロック
+typedef atomic32_t SpinLock;
+
+inline void SpinLockInit(SpinLock *lock)
+{
+    AtomicStore32(lock, 0);
+}
+
+inline void SpinLockAcquire(SpinLock *lock)
+{
+    while (AtomicCompareExchange32(lock, 1, 0) != 0)
+    {
+        // 解放されるまで読み込みだけで待つ
+        while (AtomicLoad32(lock) != 0)
+            ;
+    }
+}
+
+inline void SpinLockRelease(SpinLock *lock)
+{
+    AtomicStore32(lock, 0);
+}
+
+#endif // _THREAD_UTIL_H_
@@ -18,6 +18,10 @@
 #include "bit_operation.h"
 
 #define LOG_FILE "./resources/tester/accurate_hashPriority_WithCost.txt"
+// 置換表キャッシュファイル（定義すると対局開始時に読み込み，全対局後に保存する）
+//#define HASH_CACHE_FILE "./resources/tester/hash_cache"
+// 置換表キャッシュに保存するデータの最小探索深度
+#define HASH_CACHE_MIN_DEPTH 5
 
 #define NB_RECORDS 19
 #define NB_RANDOM_TURN 40
@@ -168,9 +172,16 @@ int main()
     SearchTree tree[2];
     FILE *fp = fopen(LOG_FILE, "w");
     int i = 0;
+#ifdef HASH_CACHE_FILE
+    // 手番ごとに置換表が異なるので，キャッシュファイルも分ける
+    char hashCacheFile[2][128];
+    sprintf(hashCacheFile[0], "%s%d", HASH_CACHE_FILE, 0);
+    sprintf(hashCacheFile[1], "%s%d", HASH_CACHE_FILE, 1);
+#endif
 
     srand(GLOBAL_SEED);
     HashInit();
+    StabilityInit();
 
     TreeInit(&tree[0], false);
     TreeInit(&tree[1], false);
@@ -183,6 +194,10 @@ int main()
     {
         TreeReset(&tree[0]);
         TreeReset(&tree[1]);
+#ifdef HASH_CACHE_FILE
+        TreeLoadHashCache(&tree[0], hashCacheFile[0]);
+        TreeLoadHashCache(&tree[1], hashCacheFile[1]);
+#endif
 
         printf("match %d\n", i);
         if (i < NB_RECORDS)
@@ -201,6 +216,10 @@ int main()
         }
     }
 
+#ifdef HASH_CACHE_FILE
+    TreeSaveHashCache(&tree[0], hashCacheFile[0], HASH_CACHE_MIN_DEPTH);
+    TreeSaveHashCache(&tree[1], hashCacheFile[1], HASH_CACHE_MIN_DEPTH);
+#endif
     fclose(fp);
 
     getchar();